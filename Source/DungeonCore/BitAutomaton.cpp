@@ -0,0 +1,201 @@
+#include "BitAutomaton.h"
+#include "WorkerPool.h"
+
+#include <utility>
+
+
+BitGrid::BitGrid()
+{
+	m_width = 0;
+	m_height = 0;
+	m_words = 0;
+}
+
+bool BitGrid::Initialize(int width, int height)
+{
+	if (width < 3 || height < 3)
+	{
+		return false;
+	}
+
+	m_width = width;
+	m_height = height;
+	m_words = (width + 63) / 64;
+	m_bits.assign((size_t)m_words * m_height, 0);
+
+	return true;
+}
+
+void BitGrid::Clear()
+{
+	m_bits.assign(m_bits.size(), 0);
+}
+
+bool BitGrid::Get(int i, int j) const
+{
+	return (Row(j)[i >> 6] >> (i & 63)) & 1;
+}
+
+void BitGrid::Set(int i, int j, bool floor)
+{
+	uint64_t bit = (uint64_t)1 << (i & 63);
+
+	if (floor)
+		Row(j)[i >> 6] |= bit;
+	else
+		Row(j)[i >> 6] &= ~bit;
+}
+
+void BitGrid::Swap(BitGrid& other)
+{
+	std::swap(m_width, other.m_width);
+	std::swap(m_height, other.m_height);
+	std::swap(m_words, other.m_words);
+	m_bits.swap(other.m_bits);
+}
+
+// Sum three one-bit inputs into (sum, carry)
+static inline void FullAdd(uint64_t a, uint64_t b, uint64_t c, uint64_t& sum, uint64_t& carry)
+{
+	uint64_t t = a ^ b;
+	sum = t ^ c;
+	carry = (a & b) | (t & c);
+}
+
+static inline void HalfAdd(uint64_t a, uint64_t b, uint64_t& sum, uint64_t& carry)
+{
+	sum = a ^ b;
+	carry = a & b;
+}
+
+// Bit-sliced (b3 b2 b1 b0) >= threshold, evaluated for 64 cells at once
+static inline uint64_t AtLeast(uint64_t b0, uint64_t b1, uint64_t b2, uint64_t b3, int threshold)
+{
+	if (threshold <= 0)
+		return ~(uint64_t)0;
+	if (threshold > 8)
+		return 0;
+
+	const uint64_t bits[4] = { b0, b1, b2, b3 };
+	uint64_t greater = 0;
+	uint64_t equal = ~(uint64_t)0;
+
+	for (int k = 3; k >= 0; k--)
+	{
+		if ((threshold >> k) & 1)
+		{
+			equal &= bits[k];
+		}
+		else
+		{
+			greater |= equal & bits[k];
+			equal &= ~bits[k];
+		}
+	}
+
+	return greater | equal;
+}
+
+bool BitCaveAutomaton::Prepare(const BitGrid& grid)
+{
+	if (m_back.GetWidth() != grid.GetWidth() || m_back.GetHeight() != grid.GetHeight())
+	{
+		if (!m_back.Initialize(grid.GetWidth(), grid.GetHeight()))
+		{
+			return false;
+		}
+	}
+
+	int width = grid.GetWidth();
+	int words = grid.GetWords();
+
+	m_interiorMask.assign(words, 0);
+
+	// Columns 0 and (width - 1) are border walls and bits past the end of the row do not exist
+	for (int i = 1; i < width - 1; i++)
+	{
+		m_interiorMask[i >> 6] |= (uint64_t)1 << (i & 63);
+	}
+
+	return true;
+}
+
+void BitCaveAutomaton::Step(const BitGrid& src, BitGrid& dst, int threshold, int rowBegin, int rowEnd) const
+{
+	int words = src.GetWords();
+
+	for (int j = rowBegin; j < rowEnd; j++)
+	{
+		const uint64_t* rows[3] = { src.Row(j - 1), src.Row(j), src.Row(j + 1) };
+		uint64_t* out = dst.Row(j);
+
+		for (int k = 0; k < words; k++)
+		{
+			uint64_t left[3], centre[3], right[3];
+
+			for (int r = 0; r < 3; r++)
+			{
+				uint64_t prev = (k > 0) ? rows[r][k - 1] : 0;
+				uint64_t next = (k < words - 1) ? rows[r][k + 1] : 0;
+
+				centre[r] = rows[r][k];
+
+				// Bit i holds cell i, so the left neighbour (i - 1) arrives by shifting up
+				left[r] = (centre[r] << 1) | (prev >> 63);
+				right[r] = (centre[r] >> 1) | (next << 63);
+			}
+
+			// Adder tree over the eight neighbours: three rows of weight 1, carries of weight 2 and 4
+			uint64_t s0, c0, s1, c1, s2, c2;
+			FullAdd(left[0], centre[0], right[0], s0, c0);
+			FullAdd(left[2], centre[2], right[2], s1, c1);
+			HalfAdd(left[1], right[1], s2, c2);
+
+			uint64_t b0, c3;
+			FullAdd(s0, s1, s2, b0, c3);
+
+			uint64_t t0, t1, b1, t2;
+			FullAdd(c0, c1, c2, t0, t1);
+			HalfAdd(t0, c3, b1, t2);
+
+			uint64_t b2, b3;
+			HalfAdd(t1, t2, b2, b3);
+
+			uint64_t grow = AtLeast(b0, b1, b2, b3, threshold) & m_interiorMask[k];
+			out[k] = centre[1] | grow;
+		}
+	}
+}
+
+bool BitCaveAutomaton::Run(BitGrid& grid, int threshold, int iterations, WorkerPool* pool)
+{
+	if (!Prepare(grid))
+	{
+		return false;
+	}
+
+	int rowBegin = 1;
+	int rowEnd = grid.GetHeight() - 1;
+
+	for (int iter = 0; iter < iterations; iter++)
+	{
+		if (pool)
+		{
+			int bands = pool->BandCount(rowBegin, rowEnd, 32);
+			pool->ParallelFor(bands, [&](int band)
+			{
+				int bandBegin, bandEnd;
+				WorkerPool::BandRange(band, bands, rowBegin, rowEnd, bandBegin, bandEnd);
+				Step(grid, m_back, threshold, bandBegin, bandEnd);
+			});
+		}
+		else
+		{
+			Step(grid, m_back, threshold, rowBegin, rowEnd);
+		}
+
+		grid.Swap(m_back);
+	}
+
+	return true;
+}
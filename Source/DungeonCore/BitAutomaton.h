@@ -0,0 +1,57 @@
+#pragma once
+
+// Bit-parallel cellular automaton. Each row of the occupancy grid is packed into
+// 64-bit words (bit set = floor) and the eight neighbour counts for a whole word
+// are produced at once by a bit-sliced adder tree. Gives exactly the same result
+// as CaveAutomaton for any threshold and iteration count.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+class WorkerPool;
+
+class BitGrid
+{
+public:
+	BitGrid();
+
+	bool Initialize(int width, int height);
+	void Clear();
+
+	bool Get(int i, int j) const;
+	void Set(int i, int j, bool floor);
+
+	uint64_t*		Row(int j)			{ return &m_bits[m_words * j]; }
+	const uint64_t*	Row(int j) const	{ return &m_bits[m_words * j]; }
+
+	int GetWidth() const	{ return m_width; }
+	int GetHeight() const	{ return m_height; }
+	int GetWords() const	{ return m_words; }
+
+	void Swap(BitGrid& other);
+
+private:
+	int						m_width, m_height;
+	int						m_words;			// 64-bit words per row
+	std::vector<uint64_t>	m_bits;
+};
+
+class BitCaveAutomaton
+{
+public:
+	// Updates rows [rowBegin, rowEnd) of (dst), which must lie inside the border
+	void Step(const BitGrid& src, BitGrid& dst, int threshold, int rowBegin, int rowEnd) const;
+
+	// Optional pool splits each generation into row bands, same output for any thread count
+	bool Run(BitGrid& grid, int threshold, int iterations, WorkerPool* pool = nullptr);
+
+private:
+	bool Prepare(const BitGrid& grid);
+
+private:
+	BitGrid					m_back;
+
+	// Per word mask of the cells an update may touch (excludes the border columns and row tail)
+	std::vector<uint64_t>	m_interiorMask;
+};
@@ -0,0 +1,258 @@
+#include "BodyGrid.h"
+
+#include <algorithm>
+
+#include <math.h>
+#include <string.h>
+
+
+// Bits sorted per radix pass
+#define BODY_GRID_RADIX_BITS 8
+#define BODY_GRID_RADIX (1 << BODY_GRID_RADIX_BITS)
+
+BodyGrid::BodyGrid()
+{
+	m_width = 0;
+	m_height = 0;
+	m_cellBits = 0;
+	m_reach = 1;
+	m_largest = 0.0f;
+}
+
+bool BodyGrid::Initialize(int width, int height)
+{
+	if (width < 1 || height < 1)
+	{
+		return false;
+	}
+
+	m_width = width;
+	m_height = height;
+
+	m_cellBits = 0;
+	while (m_cellBits < 32 && ((uint32_t)(m_width * m_height) - 1) >> m_cellBits)
+	{
+		m_cellBits++;
+	}
+
+	Clear();
+	return true;
+}
+
+void BodyGrid::Clear()
+{
+	m_cells.clear();
+	m_bodies.clear();
+	m_largest = 0.0f;
+}
+
+void BodyGrid::Reserve(int bodies)
+{
+	m_cells.reserve(bodies);
+	m_bodies.reserve(bodies);
+	m_sortCells.reserve(bodies);
+	m_sortBodies.reserve(bodies);
+}
+
+// Centres off the map land in the edge cells
+int BodyGrid::CellCoordinate(float value, int cells) const
+{
+	float cell = floorf(value + 0.5f);
+	return cell < 0.0f ? 0 : (cell >= (float)cells ? cells - 1 : (int)cell);
+}
+
+void BodyGrid::Build(const float* x, const float* z, const float* radius, int count, const int* bodies)
+{
+	if (m_width < 1)
+	{
+		return;
+	}
+
+	m_cells.resize(count);
+	m_bodies.resize(count);
+	m_sortCells.resize(count);
+	m_sortBodies.resize(count);
+
+	float largest = 0.0f;
+	for (int slot = 0; slot < count; slot++)
+	{
+		int body = bodies ? bodies[slot] : slot;
+		m_cells[slot] = (uint32_t)((m_width * CellCoordinate(z[body], m_height)) + CellCoordinate(x[body], m_width));
+		m_bodies[slot] = body;
+
+		largest = radius[body] > largest ? radius[body] : largest;
+	}
+
+	// Least significant digit first, each pass stable, so bodies sharing a cell stay in list order
+	for (int shift = 0; shift < m_cellBits; shift += BODY_GRID_RADIX_BITS)
+	{
+		int offsets[BODY_GRID_RADIX];
+		memset(offsets, 0, sizeof(offsets));
+
+		for (int slot = 0; slot < count; slot++)
+		{
+			offsets[(m_cells[slot] >> shift) & (BODY_GRID_RADIX - 1)]++;
+		}
+
+		int total = 0;
+		for (int digit = 0; digit < BODY_GRID_RADIX; digit++)
+		{
+			int digitCount = offsets[digit];
+			offsets[digit] = total;
+			total += digitCount;
+		}
+
+		for (int slot = 0; slot < count; slot++)
+		{
+			int target = offsets[(m_cells[slot] >> shift) & (BODY_GRID_RADIX - 1)]++;
+			m_sortCells[target] = m_cells[slot];
+			m_sortBodies[target] = m_bodies[slot];
+		}
+
+		m_cells.swap(m_sortCells);
+		m_bodies.swap(m_sortBodies);
+	}
+
+	// Two squares overlapping on an axis have centres under (2 * largest) apart
+	m_largest = largest;
+	m_reach = (int)ceilf(2.0f * largest);
+	m_reach = m_reach < 1 ? 1 : m_reach;
+}
+
+int BodyGrid::FindPairs(const float* x, const float* z, const float* radius, std::vector<int>& pairs)
+{
+	return FindPairs(0, (int)m_bodies.size(), x, z, radius, pairs, m_cursors);
+}
+
+int BodyGrid::FindPairs(int slotBegin, int slotEnd, const float* x, const float* z, const float* radius, std::vector<int>& pairs, std::vector<int>& cursors) const
+{
+	int found = 0;
+	int count = (int)m_bodies.size();
+	slotEnd = slotEnd < count ? slotEnd : count;
+	if (slotBegin >= slotEnd)
+	{
+		return 0;
+	}
+
+	// Each row's cursor starts at the first slot the range's first body could pair with there
+	cursors.resize(m_reach + 1);
+	int firstCell = (int)m_cells[slotBegin];
+	int firstI0 = (firstCell % m_width) - m_reach < 0 ? 0 : (firstCell % m_width) - m_reach;
+	for (int row = 0; row <= m_reach; row++)
+	{
+		uint32_t target = (uint32_t)(firstCell - (firstCell % m_width) + (m_width * row) + firstI0);
+		cursors[row] = (int)(std::lower_bound(m_cells.begin(), m_cells.end(), target) - m_cells.begin());
+	}
+
+	for (int slot = slotBegin; slot < slotEnd; slot++)
+	{
+		int body = m_bodies[slot];
+		int cell = (int)m_cells[slot];
+		int ci = cell % m_width;
+		int cj = cell / m_width;
+		int i0 = ci - m_reach < 0 ? 0 : ci - m_reach;
+		int i1 = ci + m_reach < m_width - 1 ? ci + m_reach : m_width - 1;
+
+		// The rest of its own cell and the row ahead, then the same span of each row below.
+		// Each span's first cell only grows as the slots do, so its cursor never goes back
+		for (int dj = 0; dj <= m_reach && cj + dj < m_height; dj++)
+		{
+			uint32_t first = (uint32_t)((m_width * (cj + dj)) + (dj == 0 ? ci : i0));
+			uint32_t last = (uint32_t)((m_width * (cj + dj)) + i1);
+
+			int s = slot + 1;
+			if (dj > 0)
+			{
+				int& cursor = cursors[dj];
+				while (cursor < count && m_cells[cursor] < first)
+				{
+					cursor++;
+				}
+				s = cursor;
+			}
+
+			for (; s < count && m_cells[s] <= last; s++)
+			{
+				int other = m_bodies[s];
+				float reach = radius[body] + radius[other];
+
+				if (fabsf(x[other] - x[body]) <= reach && fabsf(z[other] - z[body]) <= reach)
+				{
+					pairs.push_back(body < other ? body : other);
+					pairs.push_back(body < other ? other : body);
+					found++;
+				}
+			}
+		}
+	}
+
+	return found;
+}
+
+// As FindPairs, but every cell within reach on both sides, as the two grids share nothing
+int BodyGrid::FindPairsWith(const BodyGrid& other, int slotBegin, int slotEnd, const float* x, const float* z, const float* radius, std::vector<int>& pairs, std::vector<int>& cursors) const
+{
+	int found = 0;
+	int count = (int)other.m_bodies.size();
+	slotEnd = slotEnd < (int)m_bodies.size() ? slotEnd : (int)m_bodies.size();
+	if (slotBegin >= slotEnd || count == 0 || other.m_width != m_width || other.m_height != m_height)
+	{
+		return 0;
+	}
+
+	int reach = (int)ceilf(m_largest + other.m_largest);
+	reach = reach < 1 ? 1 : reach;
+
+	// One cursor per row offset from -reach to reach, starting as FindPairs' do
+	cursors.resize((2 * reach) + 1);
+	int firstCell = (int)m_cells[slotBegin];
+	int firstI0 = (firstCell % m_width) - reach < 0 ? 0 : (firstCell % m_width) - reach;
+	for (int row = 0; row <= 2 * reach; row++)
+	{
+		int64_t target = (int64_t)firstCell - (firstCell % m_width) + ((int64_t)m_width * (row - reach)) + firstI0;
+		target = target < 0 ? 0 : target;
+		cursors[row] = (int)(std::lower_bound(other.m_cells.begin(), other.m_cells.end(), (uint32_t)target) - other.m_cells.begin());
+	}
+
+	for (int slot = slotBegin; slot < slotEnd; slot++)
+	{
+		int body = m_bodies[slot];
+		int cell = (int)m_cells[slot];
+		int ci = cell % m_width;
+		int cj = cell / m_width;
+		int i0 = ci - reach < 0 ? 0 : ci - reach;
+		int i1 = ci + reach < m_width - 1 ? ci + reach : m_width - 1;
+
+		for (int dj = -reach; dj <= reach; dj++)
+		{
+			if (cj + dj < 0 || cj + dj >= m_height)
+			{
+				continue;
+			}
+
+			uint32_t first = (uint32_t)((m_width * (cj + dj)) + i0);
+			uint32_t last = (uint32_t)((m_width * (cj + dj)) + i1);
+
+			int& cursor = cursors[dj + reach];
+			while (cursor < count && other.m_cells[cursor] < first)
+			{
+				cursor++;
+			}
+
+			for (int s = cursor; s < count && other.m_cells[s] <= last; s++)
+			{
+				int partner = other.m_bodies[s];
+				float pairReach = radius[body] + radius[partner];
+
+				if (fabsf(x[partner] - x[body]) <= pairReach && fabsf(z[partner] - z[body]) <= pairReach)
+				{
+					pairs.push_back(body < partner ? body : partner);
+					pairs.push_back(body < partner ? partner : body);
+					found++;
+				}
+			}
+		}
+	}
+
+	return found;
+}
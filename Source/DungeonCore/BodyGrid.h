@@ -0,0 +1,62 @@
+#pragma once
+
+// Broadphase for body against body contacts, using the map's own cells as a spatial
+// hash. Cell (i, j) holds the bodies whose centre lies in [i - 0.5, i + 0.5] x
+// [j - 0.5, j + 0.5], as WallGrid's squares do, and bodies off the map land in the
+// edge cells. Rather than keep a table over every cell, the bodies are radix sorted
+// by cell index, so a rebuild costs a few passes over the bodies whatever the map
+// size, and nothing is allocated once the arrays have grown. The pair search walks
+// the sorted bodies and only looks at the rest of the row ahead of each one and at the
+// rows below, keeping one cursor per row that only ever moves forward, so every
+// candidate pair comes out once, in a fixed order.
+
+#include <stdint.h>
+#include <vector>
+
+class BodyGrid
+{
+public:
+	BodyGrid();
+
+	// Cells of a (width) x (height) map, emptied
+	bool Initialize(int width, int height);
+	void Clear();
+	void Reserve(int bodies);
+
+	int GetWidth() const	{ return m_width; }
+	int GetHeight() const	{ return m_height; }
+
+	// Sorts (count) bodies by the cells of their centres, the bodies listed in (bodies)
+	// or else the first (count). The largest radius sets how many cells a pair may be apart
+	void Build(const float* x, const float* z, const float* radius, int count, const int* bodies = nullptr);
+
+	// Appends (first, second) body indices, first < second, of every pair whose squares
+	// of half side (radius) overlap on the ground plane. Returns the number of pairs
+	int FindPairs(const float* x, const float* z, const float* radius, std::vector<int>& pairs);
+
+	// The pairs led by sorted slots [slotBegin, slotEnd), which are FindPairs' pairs in
+	// the same order when the ranges are joined up. Ranges can run on separate threads,
+	// each with its own (cursors)
+	int FindPairs(int slotBegin, int slotEnd, const float* x, const float* z, const float* radius, std::vector<int>& pairs, std::vector<int>& cursors) const;
+
+	// Pairs of a body led by sorted slots [slotBegin, slotEnd) and a body of (other), a grid
+	// of the same map over other bodies of the same arrays
+	int FindPairsWith(const BodyGrid& other, int slotBegin, int slotEnd, const float* x, const float* z, const float* radius, std::vector<int>& pairs, std::vector<int>& cursors) const;
+
+	int GetCount() const	{ return (int)m_bodies.size(); }
+
+private:
+	int CellCoordinate(float value, int cells) const;
+
+private:
+	int						m_width, m_height;
+	int						m_cellBits;		// Bits of the largest cell index
+	int						m_reach;		// Cells a candidate pair may be apart on either axis
+	float					m_largest;		// Largest radius
+
+	std::vector<uint32_t>	m_cells;		// Cell of each sorted body, ascending
+	std::vector<int>		m_bodies;		// Body indices in cell order
+	std::vector<uint32_t>	m_sortCells;	// Radix sort scratch
+	std::vector<int>		m_sortBodies;
+	std::vector<int>		m_cursors;		// First candidate slot in each row below, for whole searches
+};
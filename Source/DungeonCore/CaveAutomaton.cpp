@@ -0,0 +1,93 @@
+#include "CaveAutomaton.h"
+#include "WorkerPool.h"
+
+#include <utility>
+
+
+OccupancyGrid::OccupancyGrid()
+{
+	m_width = 0;
+	m_height = 0;
+}
+
+bool OccupancyGrid::Initialize(int width, int height)
+{
+	if (width < 3 || height < 3)
+	{
+		return false;
+	}
+
+	m_width = width;
+	m_height = height;
+	m_cells.assign(m_width * m_height, 0);
+
+	return true;
+}
+
+void OccupancyGrid::Clear()
+{
+	m_cells.assign(m_cells.size(), 0);
+}
+
+void OccupancyGrid::Swap(OccupancyGrid& other)
+{
+	std::swap(m_width, other.m_width);
+	std::swap(m_height, other.m_height);
+	m_cells.swap(other.m_cells);
+}
+
+CaveAutomaton::CaveAutomaton()
+{
+	m_kernels = GetBestGridKernels();
+}
+
+void CaveAutomaton::SetKernels(const GridKernels* kernels)
+{
+	m_kernels = kernels;
+}
+
+void CaveAutomaton::Step(const OccupancyGrid& src, OccupancyGrid& dst, int threshold, int rowBegin, int rowEnd) const
+{
+	int width = src.GetWidth();
+
+	for (int j = rowBegin; j < rowEnd; j++)
+	{
+		m_kernels->automatonRow(src.Row(j - 1), src.Row(j), src.Row(j + 1), dst.Row(j), 1, width - 1, threshold);
+	}
+}
+
+bool CaveAutomaton::Run(OccupancyGrid& grid, int threshold, int iterations, WorkerPool* pool)
+{
+	if (m_back.GetWidth() != grid.GetWidth() || m_back.GetHeight() != grid.GetHeight())
+	{
+		if (!m_back.Initialize(grid.GetWidth(), grid.GetHeight()))
+		{
+			return false;
+		}
+	}
+
+	int rowBegin = 1;
+	int rowEnd = grid.GetHeight() - 1;
+
+	for (int iter = 0; iter < iterations; iter++)
+	{
+		if (pool)
+		{
+			int bands = pool->BandCount(rowBegin, rowEnd, 8);
+			pool->ParallelFor(bands, [&](int band)
+			{
+				int bandBegin, bandEnd;
+				WorkerPool::BandRange(band, bands, rowBegin, rowEnd, bandBegin, bandEnd);
+				Step(grid, m_back, threshold, bandBegin, bandEnd);
+			});
+		}
+		else
+		{
+			Step(grid, m_back, threshold, rowBegin, rowEnd);
+		}
+
+		grid.Swap(m_back);
+	}
+
+	return true;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+// Double-buffered cellular automaton over a packed occupancy grid.
+// One byte per cell (1 = floor, 0 = wall). The outer ring of the grid is the
+// map's enforced wall border and acts as padding, so the inner loop can read
+// all eight neighbours without bounds checks.
+
+#include <stdint.h>
+#include <vector>
+
+#include "GridKernels.h"
+
+class WorkerPool;
+
+class OccupancyGrid
+{
+public:
+	OccupancyGrid();
+
+	bool Initialize(int width, int height);
+
+	// Border cells are always stored as wall
+	void Clear();
+
+	uint8_t			Get(int i, int j) const		{ return m_cells[(m_width * j) + i]; }
+	void			Set(int i, int j, uint8_t v)	{ m_cells[(m_width * j) + i] = v; }
+	uint8_t*		Row(int j)					{ return &m_cells[m_width * j]; }
+	const uint8_t*	Row(int j) const			{ return &m_cells[m_width * j]; }
+
+	int GetWidth() const	{ return m_width; }
+	int GetHeight() const	{ return m_height; }
+
+	void Swap(OccupancyGrid& other);
+
+private:
+	int						m_width, m_height;
+	std::vector<uint8_t>	m_cells;
+};
+
+class CaveAutomaton
+{
+public:
+	CaveAutomaton();
+
+	// Row kernels used by Step, defaults to the best the CPU supports
+	void SetKernels(const GridKernels* kernels);
+
+	// A wall cell becomes floor once (threshold) of its eight neighbours are floor.
+	// Updates rows [rowBegin, rowEnd) of (dst), which must lie inside the border
+	void Step(const OccupancyGrid& src, OccupancyGrid& dst, int threshold, int rowBegin, int rowEnd) const;
+
+	// Runs (iterations) generations, the result is left in (grid).
+	// With a pool each generation is split into row bands; a band reads its one
+	// row halo from the previous generation, so the output does not depend on thread count
+	bool Run(OccupancyGrid& grid, int threshold, int iterations, WorkerPool* pool = nullptr);
+
+private:
+	OccupancyGrid		m_back;
+	const GridKernels*	m_kernels;
+};
@@ -0,0 +1,186 @@
+#include "CollectibleGrid.h"
+
+#include <math.h>
+
+
+CollectibleGrid::CollectibleGrid()
+{
+	m_bucketsX = 0;
+	m_bucketsZ = 0;
+	m_inverseBucketSize = 1.0f;
+}
+
+bool CollectibleGrid::Initialize(int width, int height, float bucketSize)
+{
+	if (width < 1 || height < 1 || bucketSize <= 0.0f)
+	{
+		return false;
+	}
+
+	m_inverseBucketSize = 1.0f / bucketSize;
+	m_bucketsX = (int)ceilf(width * m_inverseBucketSize);
+	m_bucketsZ = (int)ceilf(height * m_inverseBucketSize);
+	m_heads.assign(m_bucketsX * m_bucketsZ, -1);
+
+	m_points.clear();
+	m_buckets.clear();
+	m_next.clear();
+	m_prev.clear();
+
+	return true;
+}
+
+void CollectibleGrid::Clear()
+{
+	m_heads.assign(m_heads.size(), -1);
+	m_points.clear();
+	m_buckets.clear();
+	m_next.clear();
+	m_prev.clear();
+}
+
+void CollectibleGrid::Assign(const std::vector<DungeonPoint>& points)
+{
+	Clear();
+
+	m_points.reserve(points.size());
+	m_buckets.reserve(points.size());
+	m_next.reserve(points.size());
+	m_prev.reserve(points.size());
+
+	for (size_t i = 0; i < points.size(); i++)
+	{
+		Insert(points[i]);
+	}
+}
+
+// Points off the map land in the edge buckets
+int CollectibleGrid::BucketCoordinate(float value, int buckets) const
+{
+	int coordinate = (int)floorf(value * m_inverseBucketSize);
+	return coordinate < 0 ? 0 : (coordinate >= buckets ? buckets - 1 : coordinate);
+}
+
+int CollectibleGrid::BucketOf(float x, float z) const
+{
+	return (m_bucketsX * BucketCoordinate(z, m_bucketsZ)) + BucketCoordinate(x, m_bucketsX);
+}
+
+int CollectibleGrid::Insert(const DungeonPoint& point)
+{
+	if (m_heads.empty())
+	{
+		return -1;
+	}
+
+	int item = (int)m_points.size();
+	int bucket = BucketOf(point.x, point.z);
+
+	m_points.push_back(point);
+	m_buckets.push_back(bucket);
+	m_next.push_back(m_heads[bucket]);
+	m_prev.push_back(-1);
+
+	if (m_heads[bucket] >= 0)
+	{
+		m_prev[m_heads[bucket]] = item;
+	}
+	m_heads[bucket] = item;
+
+	return item;
+}
+
+int CollectibleGrid::FindNear(float x, float z, float radius) const
+{
+	if (m_heads.empty())
+	{
+		return -1;
+	}
+
+	int x0 = BucketCoordinate(x - radius, m_bucketsX);
+	int x1 = BucketCoordinate(x + radius, m_bucketsX);
+	int z0 = BucketCoordinate(z - radius, m_bucketsZ);
+	int z1 = BucketCoordinate(z + radius, m_bucketsZ);
+
+	for (int bz = z0; bz <= z1; bz++)
+	{
+		for (int bx = x0; bx <= x1; bx++)
+		{
+			for (int item = m_heads[(m_bucketsX * bz) + bx]; item >= 0; item = m_next[item])
+			{
+				if (fabsf(m_points[item].x - x) <= radius && fabsf(m_points[item].z - z) <= radius)
+				{
+					return item;
+				}
+			}
+		}
+	}
+
+	return -1;
+}
+
+void CollectibleGrid::Unlink(int item)
+{
+	if (m_prev[item] >= 0)
+	{
+		m_next[m_prev[item]] = m_next[item];
+	}
+	else
+	{
+		m_heads[m_buckets[item]] = m_next[item];
+	}
+
+	if (m_next[item] >= 0)
+	{
+		m_prev[m_next[item]] = m_prev[item];
+	}
+}
+
+void CollectibleGrid::Remove(int item)
+{
+	if (item < 0 || item >= (int)m_points.size())
+	{
+		return;
+	}
+
+	Unlink(item);
+
+	// Move the last item into the hole and point its neighbours at the new slot
+	int last = (int)m_points.size() - 1;
+	if (item != last)
+	{
+		m_points[item] = m_points[last];
+		m_buckets[item] = m_buckets[last];
+		m_next[item] = m_next[last];
+		m_prev[item] = m_prev[last];
+
+		if (m_prev[item] >= 0)
+		{
+			m_next[m_prev[item]] = item;
+		}
+		else
+		{
+			m_heads[m_buckets[item]] = item;
+		}
+
+		if (m_next[item] >= 0)
+		{
+			m_prev[m_next[item]] = item;
+		}
+	}
+
+	m_points.pop_back();
+	m_buckets.pop_back();
+	m_next.pop_back();
+	m_prev.pop_back();
+}
+
+int CollectibleGrid::GetCount() const
+{
+	return (int)m_points.size();
+}
+
+const DungeonPoint& CollectibleGrid::GetPoint(int item) const
+{
+	return m_points[item];
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+// Uniform grid of pickups keyed on map cell coordinates. Items are packed in one
+// array, so drawing walks only live items, and each bucket is an intrusive linked
+// list through that array. Removal unlinks the item and moves the last one into
+// its slot, both O(1). A proximity query only visits the buckets its box overlaps,
+// so its cost depends on the local density, not on how many items the level holds.
+
+#include <vector>
+
+#include "DungeonMap.h"
+
+class CollectibleGrid
+{
+public:
+	CollectibleGrid();
+
+	// Square buckets of (bucketSize) cells over a (width) x (height) map, emptied.
+	// Queries are cheapest with buckets at least twice the query radius
+	bool Initialize(int width, int height, float bucketSize);
+	void Clear();
+
+	// Replaces the contents with (points)
+	void Assign(const std::vector<DungeonPoint>& points);
+	int Insert(const DungeonPoint& point);
+
+	// An item with |dx| <= radius and |dz| <= radius of (x, z), -1 if none
+	int FindNear(float x, float z, float radius) const;
+
+	// The last item takes the index of the removed one
+	void Remove(int item);
+
+	int					GetCount() const;
+	const DungeonPoint&	GetPoint(int item) const;
+
+private:
+	int BucketOf(float x, float z) const;
+	int BucketCoordinate(float value, int buckets) const;
+	void Unlink(int item);
+
+private:
+	int							m_bucketsX, m_bucketsZ;
+	float						m_inverseBucketSize;
+	std::vector<int>			m_heads;	// First item of each bucket, -1 if empty
+
+	std::vector<DungeonPoint>	m_points;
+	std::vector<int>			m_buckets;	// Bucket of each item
+	std::vector<int>			m_next;
+	std::vector<int>			m_prev;
+};
@@ -0,0 +1,1904 @@
+//
+// DungeonGenMain.cpp
+// Command line driver for offline dungeon generation.
+//
+
+#include "BodyGrid.h"
+#include "CollectibleGrid.h"
+#include "DungeonMap.h"
+#include "DungeonMesher.h"
+#include "DungeonRandom.h"
+#include "HeightField.h"
+#include "PhysicsInputLog.h"
+#include "PhysicsWorld.h"
+#include "QuantizedVertex.h"
+#include "TerrainLod.h"
+#include "TerrainRegenerator.h"
+#include "WallDistanceField.h"
+#include "WallGrid.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <random>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Every operator new and new[] in the program, so --bodies can check that stepping allocates nothing
+static std::atomic<long long> s_allocations(0);
+
+void* operator new(size_t size)
+{
+	s_allocations++;
+
+	void* memory = malloc(size > 0 ? size : 1);
+	if (!memory)
+	{
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* memory) noexcept
+{
+	free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept
+{
+	free(memory);
+}
+
+static const char* s_modeNames[AUTOMATON_MODE_COUNT] = { "inplace", "buffered", "bitboard" };
+static const char* s_kernelNames[KERNEL_LEVEL_COUNT] = { "scalar", "sse2", "avx2" };
+static const char* s_normalNames[2] = { "central", "faces" };
+
+// Pickup box half-width and grid bucket size, matching the game's COLLECTIBLE_LEEWAY
+#define PICKUP_RADIUS 2.0f
+#define PICKUP_BUCKET (PICKUP_RADIUS * 2.0f)
+
+static void PrintUsage(const char* program)
+{
+	fprintf(stderr, "usage: %s [options] <width> <height> <seed> <seedChance> <threshold> <iterations> <output.pgm>\n", program);
+	fprintf(stderr, "options:\n");
+	fprintf(stderr, "  --mode=<inplace|buffered|bitboard>\n                              cellular automaton update (default inplace)\n");
+	fprintf(stderr, "  --kernel=<scalar|sse2|avx2> highest instruction set for the row kernels (default best)\n");
+	fprintf(stderr, "  --kernels                   check every row kernel level against scalar, bit for bit\n");
+	fprintf(stderr, "  --smooth=<passes>           height smoothing passes after generation (default 0)\n");
+	fprintf(stderr, "  --threads=<count>           worker threads for the buffered modes (default all)\n");
+	fprintf(stderr, "  --async                     generate on the regeneration job and report the terrain buffers\n");
+	fprintf(stderr, "  --normals=<central|faces>   vertex normals for --async (default central)\n");
+	fprintf(stderr, "  --quantize                  16-byte vertices for --async, and check the quantization round trip\n");
+	fprintf(stderr, "                              and the quantized normals HeightField stores through edits\n");
+	fprintf(stderr, "  --lod=<distance>            fly a camera across the map and report LOD triangle counts per frame\n");
+	fprintf(stderr, "  --isolated                  leave sealed floor pockets instead of carving corridors to them\n");
+	fprintf(stderr, "  --regions                   report floor region statistics, checked against a flood fill\n");
+	fprintf(stderr, "  --collectibles=<count>      collectibles to place and check (default %d)\n", COLLECTIBLE_DEFAULT_COUNT);
+	fprintf(stderr, "  --spacing=<cells>           minimum distance between collectibles (default 0)\n");
+	fprintf(stderr, "  --pickups=<count>           time pickup checks over every cell with <count> collectibles, grid against a linear scan\n");
+	fprintf(stderr, "  --sweeps=<count>            check swept circles against sampling and time substep-sized sweeps\n");
+	fprintf(stderr, "  --field                     bake the wall distance field, check it against brute force and time lookups\n");
+	fprintf(stderr, "  --bodies=<count>            drop balls and boxes on the floor, time 600 physics steps and count their allocations\n");
+	fprintf(stderr, "  --contacts                  time 1k to 50k colliding balls, broadphase pairs against every pair\n");
+	fprintf(stderr, "  --replay=<frames>           record random inputs over uneven frames, then replay them at the fixed step and compare\n");
+	fprintf(stderr, "  --scaling=<count>           step <count> bodies on 1 to N threads, every thread count must agree,\n");
+	fprintf(stderr, "                              then again on a 256x256 map\n");
+	fprintf(stderr, "  --sleep=<count>             step <count> bodies until they rest, with sleeping on and off, then kick a sleeper\n");
+	fprintf(stderr, "  --walls                     compare the greedy block mesh against the heightfield mesh\n");
+}
+
+static bool ParseName(const char* name, const char* const* names, int count, int* value)
+{
+	for (int i = 0; i < count; i++)
+	{
+		if (strcmp(name, names[i]) == 0)
+		{
+			*value = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Same path as the in-game Generate button, with buffers recorded instead of uploaded
+static bool GenerateAsync(DungeonMap& map, int startX, int startZ, TerrainNormalMode normalMode, TerrainVertexFormat vertexFormat)
+{
+	RecordingMeshBufferDevice device;
+	TerrainRegenerator regenerator;
+	std::vector<DungeonPoint> collectibles;
+	TerrainBuffers buffers = {};
+	IndexedTerrainMesh mesh;
+
+	regenerator.SetDevice(&device);
+	regenerator.SetNormalMode(normalMode);
+	regenerator.SetVertexFormat(vertexFormat);
+	regenerator.SetBakeWallField(true);
+	if (!regenerator.Request(map, startX, startZ))
+	{
+		return false;
+	}
+
+	WallDistanceField field, expectedField;
+	regenerator.Wait();
+	if (!regenerator.Swap(map, collectibles, buffers, mesh, &field))
+	{
+		return false;
+	}
+
+	// The job's field must be the one baking the swapped heights gives
+	int fieldWrong = 0;
+	expectedField.Build(map.GetHeights(), map.GetWidth(), map.GetHeight());
+	for (int cell = 0; cell < map.GetWidth() * map.GetHeight(); cell++)
+	{
+		float x = (float)(cell % map.GetWidth()), z = (float)(cell / map.GetWidth());
+		fieldWrong += !field.IsBuilt() || field.Distance(x, z) != expectedField.Distance(x, z);
+	}
+
+	printf("terrain: %d vertices, %d indices in %d chunks, %d buffers created, %zu bytes\n",
+		buffers.vertexCount, buffers.indexCount, (int)buffers.chunks.size(), device.GetCreatedCount(), device.GetLiveBytes());
+	printf("  wall field baked on the job, %d cells differ from baking the swapped heights\n", fieldWrong);
+	if (fieldWrong > 0)
+	{
+		regenerator.ReleaseBuffers(buffers);
+		return false;
+	}
+
+	// Patch one edited cell the way Terrain::Update does
+	TerrainChunkCache chunks;
+	std::vector<TerrainVertexRange> ranges;
+	DungeonRect rect;
+
+	chunks.SetNormalMode(normalMode);
+	chunks.Adopt(mesh, map.GetWidth(), map.GetHeight());
+	map.TakeDirtyRect(rect);
+
+	map.ParticleDepositionAtPoint((map.GetWidth() * (map.GetHeight() / 2)) + (map.GetWidth() / 2), 1.5f);
+	if (map.TakeDirtyRect(rect))
+	{
+		chunks.MarkDirty(rect.x0, rect.z0, rect.x1, rect.z1);
+	}
+	chunks.Update(map.GetHeights(), ranges);
+
+	if (!regenerator.UpdateVertices(chunks.GetMesh(), ranges, buffers))
+	{
+		return false;
+	}
+
+	printf("edit: %d ranges, %zu bytes uploaded\n", (int)ranges.size(), device.GetUpdatedBytes());
+
+	// Then rounds of single cell edits, each on a random cell, a chunk seam or the map border.
+	// They go to a copy, so the checks after generation still see a dungeon
+	DungeonMap edited = map;
+	std::mt19937 random(*edited.GetPCGSeed());
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	const int rounds = 32, editsPerRound = 8;
+	int patches = 0;
+
+	for (int round = 0; round < rounds; round++)
+	{
+		for (int e = 0; e < editsPerRound; e++)
+		{
+			int coordinates[2] = { (int)(unit(random) * edited.GetWidth()), (int)(unit(random) * edited.GetHeight()) };
+			int sizes[2] = { edited.GetWidth(), edited.GetHeight() };
+
+			for (int axis = 0; axis < 2; axis++)
+			{
+				int seams = (sizes[axis] - 1) / TERRAIN_DEFAULT_CHUNK_QUADS;
+				float kind = unit(random);
+
+				if (kind < 0.3f && seams > 0)
+				{
+					// Either side of the seam or on it
+					int seam = (1 + (int)(unit(random) * seams)) * TERRAIN_DEFAULT_CHUNK_QUADS;
+					coordinates[axis] = seam - 1 + (int)(unit(random) * 3.0f);
+				}
+				else if (kind < 0.5f)
+				{
+					coordinates[axis] = unit(random) < 0.5f ? 0 : sizes[axis] - 1;
+				}
+				coordinates[axis] = coordinates[axis] < 0 ? 0 : (coordinates[axis] >= sizes[axis] ? sizes[axis] - 1 : coordinates[axis]);
+			}
+
+			edited.SetCellHeight((edited.GetWidth() * coordinates[1]) + coordinates[0], -1.0f + (unit(random) * 5.0f));
+			if (edited.TakeDirtyRect(rect))
+			{
+				chunks.MarkDirty(rect.x0, rect.z0, rect.x1, rect.z1);
+			}
+		}
+
+		ranges.clear();
+		chunks.Update(edited.GetHeights(), ranges);
+		patches += (int)ranges.size();
+
+		if (!regenerator.UpdateVertices(chunks.GetMesh(), ranges, buffers))
+		{
+			return false;
+		}
+	}
+
+	// The patched mesh and buffer against a full rebuild of the edited heights
+	IndexedTerrainMesh rebuilt;
+	TerrainBuffers rebuiltBuffers = {};
+	if (!BuildIndexedTerrainMesh(edited.GetHeights(), edited.GetWidth(), edited.GetHeight(), rebuilt, TERRAIN_DEFAULT_CHUNK_QUADS, normalMode)
+		|| !regenerator.CreateBuffers(rebuilt, rebuiltBuffers))
+	{
+		return false;
+	}
+
+	const IndexedTerrainMesh& patched = chunks.GetMesh();
+	int differing = patched.vertices.size() == rebuilt.vertices.size() ? 0 : 1;
+	for (size_t v = 0; v < rebuilt.vertices.size() && differing == 0; v++)
+	{
+		differing += memcmp(&patched.vertices[v], &rebuilt.vertices[v], sizeof(TerrainVertex)) != 0;
+	}
+
+	const std::vector<unsigned char>* uploaded = device.GetContents(buffers.vertexBuffer);
+	const std::vector<unsigned char>* expected = device.GetContents(rebuiltBuffers.vertexBuffer);
+	bool bufferMatches = uploaded && expected && *uploaded == *expected;
+
+	printf("edit: %d cells over %d rounds, %d ranges patched, %d of %d vertices differ from a full rebuild, vertex buffer %s\n",
+		rounds * editsPerRound, rounds, patches, differing, (int)rebuilt.vertices.size(), bufferMatches ? "matches" : "DIFFERS");
+
+	regenerator.ReleaseBuffers(rebuiltBuffers);
+
+	// A discarded job, and one finishing after a resize, must leave nothing to swap in or release
+	int liveBefore = device.GetLiveCount();
+	MeshBufferHandle vertexBefore = buffers.vertexBuffer;
+	bool dropped = regenerator.Request(map, startX, startZ);
+	regenerator.Discard();
+	dropped = dropped && !regenerator.Swap(map, collectibles, buffers, mesh) && device.GetLiveCount() == liveBefore;
+
+	DungeonMap resized;
+	dropped = dropped && resized.Initialize(map.GetWidth() / 2 + 1, map.GetHeight() / 2 + 1) && regenerator.Request(map, startX, startZ);
+	regenerator.Wait();
+	dropped = dropped && !regenerator.Swap(resized, collectibles, buffers, mesh) && device.GetLiveCount() == liveBefore;
+	dropped = dropped && buffers.vertexBuffer == vertexBefore;
+
+	printf("  discarded and resized jobs %s, %d buffers live\n", dropped ? "dropped" : "NOT DROPPED", device.GetLiveCount());
+
+	regenerator.ReleaseBuffers(buffers);
+	return differing == 0 && bufferMatches && dropped;
+}
+
+static bool ReportQuantization(const char* name, const std::vector<TerrainVertex>& vertices, const VertexQuantization& quantization,
+	float positionLimit, float textureLimit, float normalLimit)
+{
+	QuantizationError error;
+	MeasureQuantizationError(vertices.data(), vertices.size(), quantization, error);
+
+	bool passed = error.position <= positionLimit && error.texture <= textureLimit && error.normalDegrees <= normalLimit;
+
+	printf("quantize %s: %zu vertices, %zu -> %zu bytes, max error position %g texture %g normal %g deg%s\n",
+		name, vertices.size(), vertices.size() * sizeof(TerrainVertex), vertices.size() * sizeof(QuantizedVertex),
+		error.position, error.texture, error.normalDegrees, passed ? "" : " FAILED");
+
+	return passed;
+}
+
+// Round trip of the generated terrain and of random model-style vertices, fails on
+// errors above half a quantization step (position), half a half-float ulp (uv) or 0.05 degrees
+static bool CheckQuantization(DungeonMap& map, TerrainNormalMode normalMode)
+{
+	IndexedTerrainMesh mesh;
+	if (!BuildIndexedTerrainMesh(map.GetHeights(), map.GetWidth(), map.GetHeight(), mesh, TERRAIN_DEFAULT_CHUNK_QUADS, normalMode))
+	{
+		return false;
+	}
+
+	VertexQuantization terrain;
+	MakeTerrainQuantization(terrain);
+
+	// Texture coordinates reach 5, where a half float step is 1/256. Heights near 128 carry float rounding of ~1e-5
+	bool passed = ReportQuantization("terrain", mesh.vertices, terrain, TERRAIN_QUANTIZED_Y_STEP * 0.5f + 1e-5f, 1.0f / 512.0f, 0.05f);
+
+	const float min[3] = { -3.0f, -1.0f, -2.0f };
+	const float max[3] = { 3.0f, 5.0f, 2.0f };
+	VertexQuantization model;
+	MakeBoundsQuantization(min, max, model);
+
+	std::vector<TerrainVertex> random(100000);
+	for (size_t v = 0; v < random.size(); v++)
+	{
+		TerrainVertex& vertex = random[v];
+		float normal[3];
+		for (int axis = 0; axis < 3; axis++)
+		{
+			normal[axis] = (RandomUnit(7, (uint32_t)v, axis, RANDOM_PASS_HEIGHTS) * 2.0f) - 1.0f;
+		}
+
+		float length = sqrtf((normal[0] * normal[0]) + (normal[1] * normal[1]) + (normal[2] * normal[2]));
+		if (length < 0.01f)
+		{
+			normal[0] = 0.0f;
+			normal[1] = 1.0f;
+			normal[2] = 0.0f;
+			length = 1.0f;
+		}
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			vertex.position[axis] = min[axis] + (RandomUnit(7, (uint32_t)v, 3 + axis, RANDOM_PASS_HEIGHTS) * (max[axis] - min[axis]));
+			vertex.normal[axis] = normal[axis] / length;
+		}
+		vertex.texture[0] = RandomUnit(7, (uint32_t)v, 6, RANDOM_PASS_HEIGHTS);
+		vertex.texture[1] = RandomUnit(7, (uint32_t)v, 7, RANDOM_PASS_HEIGHTS);
+	}
+
+	// Largest model step is 6 / 65535, uv below 1 rounds to within 1/4096
+	passed &= ReportQuantization("model", random, model, (6.0f / 65535.0f) * 0.5f + 1e-6f, 1.0f / 4096.0f, 0.05f);
+
+	return passed;
+}
+
+// Edits rectangles of a HeightField that stores normals, some on the map border, updating
+// the normals of each. Every stored normal must then decode to within 0.05 degrees of the
+// mesh's normal for the edited heights, in both normal modes
+static bool CheckHeightFieldNormals(DungeonMap& map)
+{
+	int width = map.GetWidth();
+	int height = map.GetHeight();
+	const char* const normalNames[2] = { "central", "faces" };
+	bool passed = true;
+
+	for (int mode = 0; mode < 2; mode++)
+	{
+		HeightField field;
+		if (!field.Initialize(width, height, true, (TerrainNormalMode)mode))
+		{
+			return false;
+		}
+		memcpy(field.Heights(), map.GetHeights(), (size_t)width * height * sizeof(float));
+		field.UpdateNormals(0, 0, width - 1, height - 1);
+
+		std::mt19937 random(*map.GetPCGSeed() + mode);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		const int rects = 64;
+		int edited = 0;
+
+		for (int r = 0; r < rects; r++)
+		{
+			int sizeX = 1 + (int)(unit(random) * 8.0f);
+			int sizeZ = 1 + (int)(unit(random) * 8.0f);
+			int x0 = r % 4 == 0 ? 0 : (r % 4 == 1 ? width - sizeX : (int)(unit(random) * (width - sizeX)));
+			int z0 = r % 8 < 2 ? (int)(unit(random) * (height - sizeZ)) : (r % 2 == 0 ? height - sizeZ : 0);
+			x0 = x0 < 0 ? 0 : x0;
+			z0 = z0 < 0 ? 0 : z0;
+			int x1 = x0 + sizeX - 1 < width - 1 ? x0 + sizeX - 1 : width - 1;
+			int z1 = z0 + sizeZ - 1 < height - 1 ? z0 + sizeZ - 1 : height - 1;
+
+			for (int j = z0; j <= z1; j++)
+			{
+				for (int i = x0; i <= x1; i++)
+				{
+					field.SetY((width * j) + i, -1.0f + (unit(random) * 5.0f));
+					edited++;
+				}
+			}
+			field.UpdateNormals(x0, z0, x1, z1);
+		}
+
+		int wrong = 0;
+		float worst = 0.0f;
+		for (int j = 0; j < height; j++)
+		{
+			for (int i = 0; i < width; i++)
+			{
+				TerrainVertex vertex;
+				float normal[3];
+				BuildTerrainVertex(field.Heights(), width, height, i, j, vertex, (TerrainNormalMode)mode);
+				field.GetNormal((width * j) + i, normal);
+
+				float cosine = (normal[0] * vertex.normal[0]) + (normal[1] * vertex.normal[1]) + (normal[2] * vertex.normal[2]);
+				float degrees = acosf(cosine < 1.0f ? cosine : 1.0f) * (180.0f / 3.14159265f);
+				worst = degrees > worst ? degrees : worst;
+				wrong += degrees > 0.05f;
+			}
+		}
+
+		printf("heightfield %s: %d cells edited in %d rects, %d of %d stored normals off, max error %g deg, %zu bytes\n",
+			normalNames[mode], edited, rects, wrong, width * height, worst, field.GetMemoryBytes());
+		passed &= wrong == 0;
+	}
+
+	return passed;
+}
+
+// Every edge of the drawn triangles, in map cells, must be shared by two triangles
+// unless it lies on the map border, and the triangles must cover the map exactly once
+static bool IsWatertight(const DungeonMap& map, const std::vector<TerrainDrawItem>& items, int chunkQuads, long long& openEdges)
+{
+	int width = map.GetWidth();
+	int height = map.GetHeight();
+	int chunksX = (width - 1 + chunkQuads - 1) / chunkQuads;
+
+	std::vector<uint64_t> edges;
+	long long doubleArea = 0;
+
+	for (size_t d = 0; d < items.size(); d++)
+	{
+		const TerrainDrawItem& item = items[d];
+		int beginX = (item.chunk % chunksX) * chunkQuads;
+		int beginZ = (item.chunk / chunksX) * chunkQuads;
+		int stride = std::min(chunkQuads, width - 1 - beginX) + 1;
+
+		for (uint32_t t = 0; t < item.indexCount; t += 3)
+		{
+			int x[3], z[3];
+			uint64_t cell[3];
+			for (int v = 0; v < 3; v++)
+			{
+				x[v] = beginX + item.indices[t + v] % stride;
+				z[v] = beginZ + item.indices[t + v] / stride;
+				cell[v] = ((uint64_t)z[v] * width) + x[v];
+			}
+
+			doubleArea -= ((long long)(x[1] - x[0]) * (z[2] - z[0])) - ((long long)(z[1] - z[0]) * (x[2] - x[0]));
+
+			for (int v = 0; v < 3; v++)
+			{
+				uint64_t a = std::min(cell[v], cell[(v + 1) % 3]);
+				uint64_t b = std::max(cell[v], cell[(v + 1) % 3]);
+				edges.push_back((a << 32) | b);
+			}
+		}
+	}
+
+	std::sort(edges.begin(), edges.end());
+
+	openEdges = 0;
+	for (size_t e = 0; e < edges.size();)
+	{
+		size_t run = e;
+		while (run < edges.size() && edges[run] == edges[e])
+		{
+			run++;
+		}
+
+		if (run - e == 1)
+		{
+			int ax = (int)((edges[e] >> 32) % width), az = (int)((edges[e] >> 32) / width);
+			int bx = (int)((edges[e] & 0xFFFFFFFF) % width), bz = (int)((edges[e] & 0xFFFFFFFF) / width);
+			bool border = (ax == bx && (ax == 0 || ax == width - 1)) || (az == bz && (az == 0 || az == height - 1));
+			if (!border)
+			{
+				openEdges++;
+			}
+		}
+		e = run;
+	}
+
+	return openEdges == 0 && doubleArea == 2LL * (width - 1) * (height - 1);
+}
+
+// Camera 20 units up on the map diagonal, one frame per eighth of the way
+static bool ReportLod(DungeonMap& map, float baseDistance)
+{
+	IndexedTerrainMesh mesh;
+	if (!BuildIndexedTerrainMesh(map.GetHeights(), map.GetWidth(), map.GetHeight(), mesh))
+	{
+		return false;
+	}
+
+	TerrainLod lod;
+	std::vector<TerrainDrawItem> items;
+	bool passed = true;
+
+	lod.SetBaseDistance(baseDistance);
+	lod.Reset(mesh, map.GetWidth(), map.GetHeight());
+
+	for (int frame = 0; frame <= 8; frame++)
+	{
+		float camera[3] = { (map.GetWidth() - 1) * frame / 8.0f, 20.0f, (map.GetHeight() - 1) * frame / 8.0f };
+		int triangles = lod.Select(camera, items);
+
+		long long openEdges;
+		bool watertight = IsWatertight(map, items, TERRAIN_DEFAULT_CHUNK_QUADS, openEdges);
+		passed &= watertight;
+
+		printf("lod frame %d: camera (%.0f, %.0f), %d of %d triangles in %d draws, %d index lists%s\n",
+			frame, camera[0], camera[2], triangles, lod.GetFullTriangleCount(), (int)items.size(), lod.GetCachedListCount(),
+			watertight ? "" : " CRACKED");
+	}
+
+	return passed;
+}
+
+// Reference labels from a plain breadth-first flood fill, compared cell by cell
+static bool CheckRegions(DungeonMap& map)
+{
+	const RegionLabeler& regions = map.GetRegions();
+	const float* heights = map.GetHeights();
+	int width = map.GetWidth();
+	int height = map.GetHeight();
+
+	std::vector<int> labels(width * height, -1);
+	std::vector<int> queue;
+	int count = 0;
+
+	for (int start = 0; start < width * height; start++)
+	{
+		if (labels[start] >= 0 || IsDungeonWall(heights[start]))
+		{
+			continue;
+		}
+
+		// Scan order numbering, the same as RegionLabeler
+		labels[start] = count;
+		queue.assign(1, start);
+		for (size_t q = 0; q < queue.size(); q++)
+		{
+			int cell = queue[q];
+			int i = cell % width;
+			int j = cell / width;
+			int neighbours[4] = { i > 0 ? cell - 1 : -1, i < width - 1 ? cell + 1 : -1, j > 0 ? cell - width : -1, j < height - 1 ? cell + width : -1 };
+
+			for (int n = 0; n < 4; n++)
+			{
+				if (neighbours[n] >= 0 && labels[neighbours[n]] < 0 && !IsDungeonWall(heights[neighbours[n]]))
+				{
+					labels[neighbours[n]] = count;
+					queue.push_back(neighbours[n]);
+				}
+			}
+		}
+		count++;
+	}
+
+	if (count != regions.GetRegionCount())
+	{
+		return false;
+	}
+
+	for (int cell = 0; cell < width * height; cell++)
+	{
+		if (labels[cell] != regions.GetRegionAt(cell % width, cell / width))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Every kernel level this CPU has against scalar over random rows, widths 1 to 80 and a
+// long one so every vector body and remainder is hit, from a few start offsets. The
+// outputs must match byte for byte
+static bool ReportKernels(unsigned int seed)
+{
+	const GridKernels* scalar = GetGridKernels(KERNEL_SCALAR);
+	KernelLevel best = DetectKernelLevel();
+	std::mt19937 random(seed);
+	std::uniform_int_distribution<int> bit(0, 1);
+	std::uniform_real_distribution<float> height(-4.0f, 12.0f);
+
+	const int longWidth = 1031;
+	std::vector<uint8_t> cells[3], expectedCells, actualCells;
+	std::vector<float> heights[3], expectedHeights, actualHeights, expectedNormals, actualNormals;
+	int rows = 0, mismatches = 0;
+
+	for (int width = 1; width <= longWidth; width = width < 80 ? width + 1 : longWidth + 1)
+	{
+		// One cell of padding either side for the outer taps
+		for (int r = 0; r < 3; r++)
+		{
+			cells[r].resize(width + 2);
+			heights[r].resize(width + 2);
+			for (int i = 0; i < width + 2; i++)
+			{
+				cells[r][i] = (uint8_t)bit(random);
+				heights[r][i] = height(random);
+			}
+		}
+
+		for (int begin = 0; begin < 3 && begin < width; begin++)
+		{
+			int threshold = 1 + (int)(random() % 8);
+
+			expectedCells.assign(width + 2, 0);
+			expectedHeights.assign(width + 2, 0.0f);
+			expectedNormals.assign(3 * (width + 2), 0.0f);
+			scalar->automatonRow(&cells[0][1], &cells[1][1], &cells[2][1], &expectedCells[1], begin, width, threshold);
+			scalar->smoothRow(&heights[0][1], &heights[1][1], &heights[2][1], &expectedHeights[1], begin, width);
+			scalar->normalRow(&heights[0][1], &heights[1][1], &heights[2][1], &expectedNormals[3], begin, width);
+
+			for (int level = KERNEL_SSE2; level <= best; level++)
+			{
+				const GridKernels* kernels = GetGridKernels((KernelLevel)level);
+
+				actualCells.assign(width + 2, 0);
+				kernels->automatonRow(&cells[0][1], &cells[1][1], &cells[2][1], &actualCells[1], begin, width, threshold);
+				mismatches += memcmp(expectedCells.data(), actualCells.data(), expectedCells.size()) != 0;
+
+				actualHeights.assign(width + 2, 0.0f);
+				kernels->smoothRow(&heights[0][1], &heights[1][1], &heights[2][1], &actualHeights[1], begin, width);
+				mismatches += memcmp(expectedHeights.data(), actualHeights.data(), actualHeights.size() * sizeof(float)) != 0;
+
+				// Outside [begin, end) must be left alone too
+				actualNormals.assign(3 * (width + 2), 0.0f);
+				kernels->normalRow(&heights[0][1], &heights[1][1], &heights[2][1], &actualNormals[3], begin, width);
+				mismatches += memcmp(expectedNormals.data(), actualNormals.data(), actualNormals.size() * sizeof(float)) != 0;
+			}
+			rows++;
+		}
+	}
+
+	printf("kernels: %s and below against scalar over %d rows, %d mismatches\n", s_kernelNames[best], rows, mismatches);
+
+	return mismatches == 0;
+}
+
+static bool ReportRegions(DungeonMap& map, int startX, int startZ)
+{
+	const RegionLabeler& regions = map.GetRegions();
+	int largest = regions.GetLargestRegion();
+	int start = regions.GetRegionAt(startX, startZ);
+	int floorCells = regions.GetFloorCells();
+
+	printf("regions: %d, %d floor cells, largest %d cells, start region %d cells (%.1f%% of the floor), %d cells carved\n",
+		regions.GetRegionCount(), floorCells, largest >= 0 ? regions.GetRegion(largest).cells : 0,
+		start >= 0 ? regions.GetRegion(start).cells : 0,
+		floorCells > 0 && start >= 0 ? 100.0 * regions.GetRegion(start).cells / floorCells : 0.0, map.GetCarvedCells());
+
+	return CheckRegions(map);
+}
+
+// Every point on a distinct floor cell and no two closer than the spacing. Pairwise, so
+// only for the counts a level actually uses
+static bool ReportCollectibles(DungeonMap& map)
+{
+	std::vector<DungeonPoint> collectibles;
+	if (!map.PlaceCollectibles(collectibles))
+	{
+		return false;
+	}
+
+	float spacing = *map.GetCollectibleSpacing();
+	float closest = -1.0f;
+	bool valid = true;
+
+	for (size_t a = 0; a < collectibles.size(); a++)
+	{
+		int index = (map.GetWidth() * (int)collectibles[a].z) + (int)collectibles[a].x;
+		valid &= !IsDungeonWall(map.GetCellHeight(index));
+
+		for (size_t b = a + 1; b < collectibles.size(); b++)
+		{
+			float dx = collectibles[a].x - collectibles[b].x;
+			float dz = collectibles[a].z - collectibles[b].z;
+			float distance = sqrtf((dx * dx) + (dz * dz));
+
+			closest = closest < 0.0f || distance < closest ? distance : closest;
+		}
+	}
+	valid &= collectibles.size() < 2 || (closest > 0.0f && closest >= spacing);
+
+	printf("collectibles: %d of %d placed on %d floor cells", (int)collectibles.size(), *map.GetCollectibleCount(), map.GetRegions().GetFloorCells());
+	if (collectibles.size() > 1)
+	{
+		printf(", closest pair %.2f cells apart", closest);
+	}
+	printf("%s\n", valid ? "" : " INVALID");
+
+	return valid;
+}
+
+static double MillisecondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Index of the first point in the pickup box, the scan the game did before the grid
+static int FindNearLinear(const std::vector<DungeonPoint>& points, float x, float z)
+{
+	for (size_t p = 0; p < points.size(); p++)
+	{
+		if (fabsf(points[p].x - x) <= PICKUP_RADIUS && fabsf(points[p].z - z) <= PICKUP_RADIUS)
+		{
+			return (int)p;
+		}
+	}
+	return -1;
+}
+
+// A pickup check at every cell, then every item picked up from where it stands. Every
+// 64th check is repeated with a linear scan, both for timing and to compare the answers
+static bool ReportPickups(DungeonMap& map, int count)
+{
+	std::vector<DungeonPoint> points;
+	*map.GetCollectibleCount() = count;
+	if (!map.PlaceCollectibles(points))
+	{
+		return false;
+	}
+
+	CollectibleGrid grid;
+	if (!grid.Initialize(map.GetWidth(), map.GetHeight(), PICKUP_BUCKET))
+	{
+		return false;
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	grid.Assign(points);
+	double buildTime = MillisecondsSince(start);
+
+	int cells = map.GetWidth() * map.GetHeight();
+	int hits = 0;
+
+	start = std::chrono::steady_clock::now();
+	for (int cell = 0; cell < cells; cell++)
+	{
+		hits += grid.FindNear((float)(cell % map.GetWidth()), (float)(cell / map.GetWidth()), PICKUP_RADIUS) >= 0;
+	}
+	double gridTime = MillisecondsSince(start);
+
+	int sampled = 0;
+	int linearHits = 0;
+	bool agree = true;
+
+	start = std::chrono::steady_clock::now();
+	for (int cell = 0; cell < cells; cell += 64)
+	{
+		float x = (float)(cell % map.GetWidth());
+		float z = (float)(cell / map.GetWidth());
+		bool found = FindNearLinear(points, x, z) >= 0;
+
+		linearHits += found;
+		agree &= found == (grid.FindNear(x, z, PICKUP_RADIUS) >= 0);
+		sampled++;
+	}
+	double linearTime = MillisecondsSince(start);
+
+	// Emptying the pickup box around every item must remove each one exactly once, as the
+	// other items move into the slots of the removed ones
+	int removed = 0;
+	start = std::chrono::steady_clock::now();
+	for (size_t p = 0; p < points.size(); p++)
+	{
+		for (int found = grid.FindNear(points[p].x, points[p].z, PICKUP_RADIUS); found >= 0;
+			found = grid.FindNear(points[p].x, points[p].z, PICKUP_RADIUS))
+		{
+			grid.Remove(found);
+			removed++;
+		}
+	}
+	double removeTime = MillisecondsSince(start);
+	agree &= removed == (int)points.size() && grid.GetCount() == 0;
+
+	printf("pickups: %d of %d placed, grid built in %.2f ms\n", (int)points.size(), count, buildTime);
+	printf("  grid: %d checks in %.2f ms (%.1f ns each), %d hits\n", cells, gridTime, gridTime * 1e6 / cells, hits);
+	printf("  linear: %d checks in %.2f ms (%.1f ns each), %d hits\n", sampled, linearTime, linearTime * 1e6 / (sampled > 0 ? sampled : 1), linearHits);
+	printf("  picked up all %d in %.2f ms%s\n", (int)points.size(), removeTime, agree ? "" : " MISMATCH");
+
+	return agree;
+}
+
+// Samples every 1/50 of a cell along the movement, stopping short of the contact
+static bool SweepClearBefore(const WallGrid& walls, float x, float z, float radius, float dx, float dz, float time)
+{
+	int samples = (int)(sqrtf((dx * dx) + (dz * dz)) * time * 50.0f) + 1;
+
+	for (int s = 0; s <= samples; s++)
+	{
+		float t = time * 0.9999f * s / samples;
+		if (walls.Overlaps(x + (dx * t), z + (dz * t), radius * 0.999f))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// Random sweeps from floor cells: nothing may overlap a wall before the reported contact,
+// and the circle must touch the wall at it. Then long random walks with sliding, which
+// must never end inside a wall, and a timing run of substep-sized sweeps
+static bool ReportSweeps(DungeonMap& map, int count)
+{
+	WallGrid walls;
+	if (!walls.Build(map.GetHeights(), map.GetWidth(), map.GetHeight()))
+	{
+		return false;
+	}
+
+	const RegionLabeler& regions = map.GetRegions();
+	if (regions.GetFloorCells() == 0)
+	{
+		return false;
+	}
+
+	static const float radii[4] = { 0.0f, 0.3f, 0.5f, 1.2f };
+	std::mt19937 random(*map.GetPCGSeed());
+	std::uniform_int_distribution<int> floorCell(0, regions.GetFloorCells() - 1);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+	int hits = 0, tunnelled = 0, detached = 0, stuck = 0;
+
+	for (int s = 0; s < count; s++)
+	{
+		int cell = regions.GetFloorCell(floorCell(random));
+		float x = (float)(cell % map.GetWidth()) + (unit(random) * 0.25f);
+		float z = (float)(cell / map.GetWidth()) + (unit(random) * 0.25f);
+		float radius = radii[s % 4];
+		float dx = unit(random) * 20.0f;
+		float dz = unit(random) * 20.0f;
+
+		if (walls.Overlaps(x, z, radius))
+		{
+			continue;
+		}
+
+		WallHit hit;
+		bool found = walls.SweepCircle(x, z, radius, dx, dz, hit);
+		hits += found;
+
+		tunnelled += !SweepClearBefore(walls, x, z, radius, dx, dz, found ? hit.time : 1.0f);
+		detached += found && !walls.Overlaps(x + (dx * hit.time), z + (dz * hit.time), radius + 0.001f);
+	}
+
+	// Walks of 200 long steps, each step slid along whatever it meets
+	for (int w = 0; w < count / 100; w++)
+	{
+		int cell = regions.GetFloorCell(floorCell(random));
+		float x = (float)(cell % map.GetWidth());
+		float z = (float)(cell / map.GetWidth());
+		float radius = radii[2 + (w % 2)];
+
+		if (walls.Overlaps(x, z, radius))
+		{
+			continue;
+		}
+
+		for (int step = 0; step < 200; step++)
+		{
+			walls.Slide(x, z, radius, unit(random) * 5.0f, unit(random) * 5.0f);
+			stuck += walls.Overlaps(x, z, radius - WALL_SKIN);
+		}
+	}
+
+	// One substep of a fast ball, under a cell per sweep
+	const int timed = 1000000;
+	std::vector<float> moves(4096);
+	for (size_t m = 0; m < moves.size(); m++)
+	{
+		moves[m] = unit(random) * 0.7f;
+	}
+
+	int cell = regions.GetFloorCell(regions.GetRegion(regions.GetLargestRegion()).cells / 2);
+	float x = (float)(cell % map.GetWidth());
+	float z = (float)(cell / map.GetWidth());
+	int blocked = 0;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int t = 0; t < timed; t++)
+	{
+		blocked += !walls.Slide(x, z, 0.5f, moves[t & 4095], moves[(t + 1) & 4095]);
+	}
+	double time = MillisecondsSince(start);
+
+	printf("sweeps: %d random, %d hit a wall, %d tunnelled, %d stopped short of the wall\n", count, hits, tunnelled, detached);
+	printf("  slides: %d walks of 200 steps, %d ended inside a wall\n", count / 100, stuck);
+	printf("  %d substep slides in %.2f ms (%.1f ns each), %d blocked\n", timed, time, time * 1e6 / timed, blocked);
+
+	return tunnelled == 0 && detached == 0 && stuck == 0;
+}
+
+// Distance from cell (i, j)'s centre to the nearest cell centre of the other kind, the
+// map border standing in for walls all round
+static float BruteForceDistance(const WallGrid& walls, int width, int height, int i, int j)
+{
+	bool wall = walls.IsWall(i, j);
+	float best = 1e20f;
+
+	for (int z = -1; z <= height; z++)
+	{
+		for (int x = -1; x <= width; x++)
+		{
+			if (walls.IsWall(x, z) != wall)
+			{
+				float d2 = (float)(((x - i) * (x - i)) + ((z - j) * (z - j)));
+				best = d2 < best ? d2 : best;
+			}
+		}
+	}
+
+	return wall ? 0.5f - sqrtf(best) : sqrtf(best) - 0.5f;
+}
+
+static bool ReportField(DungeonMap& map)
+{
+	int width = map.GetWidth();
+	int height = map.GetHeight();
+
+	WallGrid walls;
+	WallDistanceField field;
+	walls.Build(map.GetHeights(), width, height);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	if (!field.Build(map.GetHeights(), width, height))
+	{
+		return false;
+	}
+	double buildTime = MillisecondsSince(start);
+
+	// Brute force scans the whole map per cell, so about 2^28 distances at most
+	int cells = width * height;
+	int samples = (1 << 28) / cells;
+	int stride = samples < cells ? cells / (samples > 0 ? samples : 1) : 1;
+	int checked = 0, wrong = 0;
+
+	for (int cell = 0; cell < cells; cell += stride)
+	{
+		int i = cell % width, j = cell / width;
+		float expected = BruteForceDistance(walls, width, height, i, j);
+		wrong += fabsf(field.Distance((float)i, (float)j) - expected) > 1e-3f;
+		checked++;
+	}
+
+	// Sweeps may not pass into a wall of the field before their contact
+	std::mt19937 random(*map.GetPCGSeed());
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	int sweeps = 0, hits = 0, tunnelled = 0;
+
+	for (int s = 0; s < 20000; s++)
+	{
+		float x = (unit(random) * 0.5f + 0.5f) * (width - 1);
+		float z = (unit(random) * 0.5f + 0.5f) * (height - 1);
+		float radius = 0.25f + (unit(random) * 0.5f + 0.5f) * 2.0f;
+		float dx = unit(random) * 10.0f, dz = unit(random) * 10.0f;
+
+		if (field.Overlaps(x, z, radius))
+		{
+			continue;
+		}
+
+		WallHit hit;
+		bool found = field.SweepCircle(x, z, radius, dx, dz, hit);
+		float time = found ? hit.time : 1.0f;
+		int samples = (int)(sqrtf((dx * dx) + (dz * dz)) * time * 50.0f) + 1;
+
+		for (int k = 0; k <= samples; k++)
+		{
+			float t = time * k / samples;
+			if (field.Distance(x + (dx * t), z + (dz * t)) < radius - 1e-3f)
+			{
+				tunnelled++;
+				break;
+			}
+		}
+
+		hits += found;
+		sweeps++;
+	}
+
+	// The same circle tests both ways, a small and a large radius
+	const int lookups = 1000000;
+	float timings[2][2];
+	int overlaps[2][2];
+
+	for (int r = 0; r < 2; r++)
+	{
+		float radius = r == 0 ? 0.5f : 3.0f;
+
+		for (int method = 0; method < 2; method++)
+		{
+			int count = 0;
+			start = std::chrono::steady_clock::now();
+			for (int l = 0; l < lookups; l++)
+			{
+				float x = (float)(((long long)l * 7919) % (width * 16)) / 16.0f;
+				float z = (float)(((long long)l * 104729) % (height * 16)) / 16.0f;
+				count += method == 0 ? walls.Overlaps(x, z, radius) : field.Overlaps(x, z, radius);
+			}
+			timings[r][method] = (float)MillisecondsSince(start);
+			overlaps[r][method] = count;
+		}
+	}
+
+	// The game rebakes after edits on a WallFieldBaker, the frame only pays for the request and the swap
+	WallFieldBaker baker;
+	WallDistanceField baked;
+	start = std::chrono::steady_clock::now();
+	bool requested = baker.Request(map.GetHeights(), width, height);
+	double requestTime = MillisecondsSince(start);
+	baker.Wait();
+	start = std::chrono::steady_clock::now();
+	bool swapped = requested && baker.Swap(baked);
+	double swapTime = MillisecondsSince(start);
+
+	int bakedWrong = 0;
+	for (int cell = 0; cell < cells && swapped; cell++)
+	{
+		float x = (float)(cell % width), z = (float)(cell / width);
+		bakedWrong += baked.Distance(x, z) != field.Distance(x, z);
+	}
+
+	printf("field: baked %dx%d in %.2f ms, %d of %d sampled cells off the brute force distance\n", width, height, buildTime, wrong, checked);
+	printf("  baker: %.3f ms to request and %.3f ms to swap in on the calling thread, %d cells differ from baking in place\n", requestTime,
+		swapTime, swapped ? bakedWrong : cells);
+	printf("  sweeps: %d, %d hit, %d passed into a wall\n", sweeps, hits, tunnelled);
+	for (int r = 0; r < 2; r++)
+	{
+		printf("  radius %.1f: grid %.1f ns, field %.1f ns per test, %d and %d overlapping\n", r == 0 ? 0.5f : 3.0f,
+			timings[r][0] * 1e6f / lookups, timings[r][1] * 1e6f / lookups, overlaps[r][0], overlaps[r][1]);
+	}
+
+	return wrong == 0 && tunnelled == 0 && swapped && bakedWrong == 0;
+}
+
+// Bodies dropped from up to 3 units over random floor cells, balls of radius 0.5 and
+// every other one a box of half size 0.4 if (boxes)
+static bool SpawnBodies(DungeonMap& map, PhysicsWorld& world, int count, bool boxes)
+{
+	const RegionLabeler& regions = map.GetRegions();
+	if (regions.GetFloorCells() == 0)
+	{
+		return false;
+	}
+
+	std::mt19937 random(*map.GetPCGSeed());
+	std::uniform_int_distribution<int> floorCell(0, regions.GetFloorCells() - 1);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	world.Clear();
+	world.SetFloorHeight(FLOOR_HEIGHT);
+	world.Reserve(count);
+
+	for (int b = 0; b < count; b++)
+	{
+		int cell = regions.GetFloorCell(floorCell(random));
+		float x = (float)(cell % map.GetWidth());
+		float z = (float)(cell / map.GetWidth());
+		float y = FLOOR_HEIGHT + 0.5f + (unit(random) * 3.0f);
+		float mass = 5.0f + (unit(random) * 25.0f);
+
+		if (boxes && b % 2 == 1)
+		{
+			world.SpawnBox(x, y, z, mass, 0.4f);
+		}
+		else
+		{
+			world.SpawnBall(x, y, z, mass, 0.5f);
+		}
+	}
+
+	return true;
+}
+
+// Bodies inside a wall or below the floor
+static int CountEscapedBodies(const PhysicsWorld& world, const WallGrid& walls)
+{
+	int escaped = 0;
+
+	for (int b = 0; b < world.GetBodyCount(); b++)
+	{
+		float position[3];
+		world.GetPosition(b, position);
+
+		// A ball as wide as a corridor touches both sides, stepping off one wall by the skin puts it in the other
+		escaped += walls.Overlaps(position[0], position[2], world.GetRadius(b) - (2.0f * WALL_SKIN)) || position[1] < FLOOR_HEIGHT;
+	}
+
+	return escaped;
+}
+
+// Half balls and half boxes stepped at the fixed rate. Afterwards no body may be inside a wall
+// or below the floor
+static bool ReportBodies(DungeonMap& map, int count)
+{
+	WallGrid walls;
+	if (!walls.Build(map.GetHeights(), map.GetWidth(), map.GetHeight()))
+	{
+		return false;
+	}
+
+	PhysicsWorld world;
+	PhysicsLevel level = { &walls, nullptr };
+	if (!SpawnBodies(map, world, count, true))
+	{
+		return false;
+	}
+
+	// The first step sizes the broadphase, after that stepping may not allocate
+	world.Step(PHYSICS_FIXED_STEP, level);
+	long long allocations = s_allocations.load();
+
+	const int steps = 600;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int step = 0; step < steps; step++)
+	{
+		world.Step(PHYSICS_FIXED_STEP, level);
+	}
+	double time = MillisecondsSince(start);
+
+	allocations = s_allocations.load() - allocations;
+	int escaped = CountEscapedBodies(world, walls);
+
+	printf("bodies: %d stepped %d times in %.2f ms, %.3f ms per step, %.1f ns per body step\n", world.GetBodyCount(), steps, time,
+		time / steps, time * 1e6 / ((double)steps * (world.GetBodyCount() > 0 ? world.GetBodyCount() : 1)));
+	printf("  %d contacts from %d candidate pairs in the last step, %d inside walls or below the floor, %lld allocations while stepping\n",
+		world.GetContacts(), world.GetCandidatePairs(), escaped, allocations);
+
+	return escaped == 0 && allocations == 0;
+}
+
+// Balls only, from 1k to 50k over the same map, 120 steps each. The broadphase's pairs
+// after the last step are checked against every pair, while that stays affordable
+static bool ReportContacts(DungeonMap& map)
+{
+	WallGrid walls;
+	if (!walls.Build(map.GetHeights(), map.GetWidth(), map.GetHeight()))
+	{
+		return false;
+	}
+
+	const int counts[] = { 1000, 2000, 5000, 10000, 20000, 50000 };
+	const int steps = 120;
+	const long long bruteForceLimit = 1LL << 28;
+	bool correct = true;
+
+	PhysicsWorld world;
+	PhysicsLevel level = { &walls, nullptr };
+	BodyGrid grid;
+	grid.Initialize(map.GetWidth(), map.GetHeight());
+
+	std::vector<float> x, z, radius;
+	std::vector<int> pairs;
+
+	for (int c = 0; c < (int)(sizeof(counts) / sizeof(counts[0])); c++)
+	{
+		if (!SpawnBodies(map, world, counts[c], false))
+		{
+			return false;
+		}
+
+		long long candidates = 0, contacts = 0;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int step = 0; step < steps; step++)
+		{
+			world.Step(PHYSICS_FIXED_STEP, level);
+			candidates += world.GetCandidatePairs();
+			contacts += world.GetContacts();
+		}
+		double time = MillisecondsSince(start);
+
+		int count = world.GetBodyCount();
+		int escaped = CountEscapedBodies(world, walls);
+		correct = correct && escaped == 0;
+
+		printf("contacts: %5d balls, %.3f ms per step, %.0f candidate pairs and %.0f contacts per step, %d escaped\n", count, time / steps,
+			(double)candidates / steps, (double)contacts / steps, escaped);
+
+		if ((long long)count * count / 2 > bruteForceLimit)
+		{
+			continue;
+		}
+
+		x.resize(count);
+		z.resize(count);
+		radius.resize(count);
+		for (int b = 0; b < count; b++)
+		{
+			float position[3];
+			world.GetPosition(b, position);
+			x[b] = position[0];
+			z[b] = position[2];
+			radius[b] = world.GetRadius(b);
+		}
+
+		start = std::chrono::steady_clock::now();
+		grid.Build(x.data(), z.data(), radius.data(), count);
+		pairs.clear();
+		int found = grid.FindPairs(x.data(), z.data(), radius.data(), pairs);
+		double gridTime = MillisecondsSince(start);
+
+		start = std::chrono::steady_clock::now();
+		int expected = 0;
+		for (int a = 0; a < count; a++)
+		{
+			for (int b = a + 1; b < count; b++)
+			{
+				float reach = radius[a] + radius[b];
+				expected += fabsf(x[b] - x[a]) <= reach && fabsf(z[b] - z[a]) <= reach;
+			}
+		}
+		double bruteTime = MillisecondsSince(start);
+
+		// Every pair once, first below second
+		bool ordered = true;
+		for (int p = 0; p < found; p++)
+		{
+			ordered = ordered && pairs[2 * p] < pairs[(2 * p) + 1];
+		}
+		correct = correct && found == expected && ordered;
+
+		printf("  broadphase %d pairs in %.3f ms, all pairs %d in %.3f ms\n", found, gridTime, expected, bruteTime);
+	}
+
+	return correct;
+}
+
+// A session of (frames) frames between 1/240 and 1/20 of a second, with the odd quarter
+// second stall to hit the substep cap. Bodies are spawned, kicked and pushed, and the
+// parameters moved as the GUI would, through a PhysicsInputLog along the way. A fresh
+// world replaying the log at the fixed step must end up bit for bit where the session did
+static bool ReportReplay(DungeonMap& map, int frames)
+{
+	WallGrid walls;
+	const RegionLabeler& regions = map.GetRegions();
+	if (!walls.Build(map.GetHeights(), map.GetWidth(), map.GetHeight()) || regions.GetFloorCells() == 0)
+	{
+		return false;
+	}
+
+	std::mt19937 random(*map.GetPCGSeed());
+	std::uniform_int_distribution<int> floorCell(0, regions.GetFloorCells() - 1);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	PhysicsWorld live;
+	PhysicsLevel level = { &walls, nullptr };
+	PhysicsInputLog inputs;
+
+	PhysicsParameters parameters;
+	live.GetParameters(parameters);
+	parameters.floorHeight = FLOOR_HEIGHT;
+	inputs.SetParameters(live, parameters);
+	int parameterChanges = 0;
+
+	int capped = 0, mostSteps = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int frame = 0; frame < frames; frame++)
+	{
+		float input = unit(random);
+		int cell = regions.GetFloorCell(floorCell(random));
+		float x = (float)(cell % map.GetWidth());
+		float z = (float)(cell / map.GetWidth());
+		float angle = unit(random) * 6.2831853f;
+
+		if (input < 0.2f || live.GetBodyCount() == 0)
+		{
+			if (frame % 2 == 0)
+			{
+				inputs.SpawnBall(live, x, FLOOR_HEIGHT + 1.0f, z, 5.0f + (unit(random) * 25.0f), 0.5f);
+			}
+			else
+			{
+				inputs.SpawnBox(live, x, FLOOR_HEIGHT + 1.0f, z, 5.0f + (unit(random) * 25.0f), 0.4f);
+			}
+		}
+		else if (input < 0.3f)
+		{
+			float position[3];
+			live.GetPosition(frame % live.GetBodyCount(), position);
+			inputs.ApplyForceInRange(live, position[0], position[2], KICK_RANGE, cosf(angle), 0.5f, sinf(angle), 50.0f);
+		}
+		else if (input < 0.4f)
+		{
+			inputs.ApplyForce(live, frame % live.GetBodyCount(), cosf(angle), 0.0f, sinf(angle), 10.0f);
+		}
+		else if (input < 0.42f)
+		{
+			parameters.gravity = 0.1f + unit(random);
+			parameters.friction = unit(random);
+			parameters.elasticity = unit(random) * 0.9f;
+			parameters.sleeping = frame % 3 != 0;
+			parameterChanges += inputs.SetParameters(live, parameters);
+		}
+
+		float dTime = frame % 97 == 96 ? 0.25f : (1.0f / 240.0f) + (unit(random) * ((1.0f / 20.0f) - (1.0f / 240.0f)));
+		int steps = live.Advance(dTime, level);
+
+		capped += steps == PHYSICS_MAX_SUBSTEPS;
+		mostSteps = steps > mostSteps ? steps : mostSteps;
+	}
+	double liveTime = MillisecondsSince(start);
+
+	// Floor and all, the replay takes its parameters from the log
+	PhysicsWorld replay;
+
+	start = std::chrono::steady_clock::now();
+	inputs.Replay(replay, live.GetStepCount(), level);
+	double replayTime = MillisecondsSince(start);
+
+	int differing = replay.GetBodyCount() == live.GetBodyCount() ? 0 : 1;
+	for (int b = 0; b < live.GetBodyCount() && differing == 0; b++)
+	{
+		float livePosition[3], liveVelocity[3], replayPosition[3], replayVelocity[3];
+		live.GetPosition(b, livePosition);
+		live.GetVelocity(b, liveVelocity);
+		replay.GetPosition(b, replayPosition);
+		replay.GetVelocity(b, replayVelocity);
+
+		differing += memcmp(livePosition, replayPosition, sizeof(livePosition)) != 0 || memcmp(liveVelocity, replayVelocity, sizeof(liveVelocity)) != 0;
+	}
+
+	int escaped = CountEscapedBodies(replay, walls);
+
+	printf("replay: %d frames ran %d steps in %.2f ms, at most %d a frame, %d frames hit the cap\n", frames, live.GetStepCount(), liveTime,
+		mostSteps, capped);
+	printf("  %d parameter changes, %d inputs replayed over %d steps in %.2f ms, %d of %d bodies differ, %d escaped\n", parameterChanges, inputs.GetCount(), replay.GetStepCount(),
+		replayTime, differing, live.GetBodyCount(), escaped);
+
+	return differing == 0 && replay.GetStepCount() == live.GetStepCount() && escaped == 0;
+}
+
+// FNV-1a over the bits of every body's position and velocity
+static uint64_t HashBodies(const PhysicsWorld& world)
+{
+	uint64_t hash = 14695981039346656037ULL;
+
+	for (int b = 0; b < world.GetBodyCount(); b++)
+	{
+		float state[6];
+		world.GetPosition(b, state);
+		world.GetVelocity(b, state + 3);
+
+		const unsigned char* bytes = (const unsigned char*)state;
+		for (size_t i = 0; i < sizeof(state); i++)
+		{
+			hash = (hash ^ bytes[i]) * 1099511628211ULL;
+		}
+	}
+
+	return hash;
+}
+
+// The same (count) balls and boxes stepped 120 times on 1, 2, 4 ... threads up to the
+// hardware's, at least 4. Every thread count must end in exactly the same state. The
+// largest island and the largest group left after splitting are the most pairs one
+// thread resolves alone, reported at their peak share of a step's pairs
+static bool ScaleOnMap(DungeonMap& map, int count)
+{
+	WallGrid walls;
+	if (!walls.Build(map.GetHeights(), map.GetWidth(), map.GetHeight()))
+	{
+		return false;
+	}
+
+	PhysicsLevel level = { &walls, nullptr };
+	const int steps = 120;
+	int mostThreads = WorkerPool::HardwareThreads() > 4 ? WorkerPool::HardwareThreads() : 4;
+
+	uint64_t expected = 0;
+	double serialTime = 0.0;
+	bool identical = true;
+
+	for (int threads = 1; ; threads = threads * 2 < mostThreads ? threads * 2 : mostThreads)
+	{
+		WorkerPool pool(threads);
+		PhysicsWorld world;
+		world.SetWorkerPool(&pool);
+		if (!SpawnBodies(map, world, count, true))
+		{
+			return false;
+		}
+
+		long long contacts = 0;
+		double islandShare = 0.0, groupShare = 0.0;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int step = 0; step < steps; step++)
+		{
+			world.Step(PHYSICS_FIXED_STEP, level);
+			contacts += world.GetContacts();
+
+			double pairs = world.GetCandidatePairs() > 0 ? (double)world.GetCandidatePairs() : 1.0;
+			islandShare = world.GetLargestIsland() / pairs > islandShare ? world.GetLargestIsland() / pairs : islandShare;
+			groupShare = world.GetLargestGroup() / pairs > groupShare ? world.GetLargestGroup() / pairs : groupShare;
+		}
+		double time = MillisecondsSince(start);
+
+		uint64_t hash = HashBodies(world);
+		if (threads == 1)
+		{
+			expected = hash;
+			serialTime = time;
+		}
+		identical = identical && hash == expected;
+
+		printf("scaling: %d bodies on %dx%d, %2d threads, %.3f ms per step, %.2fx, %.0f contacts per step, state %016llx%s\n", world.GetBodyCount(),
+			map.GetWidth(), map.GetHeight(), threads, time / steps, serialTime / time, (double)contacts / steps, (unsigned long long)hash,
+			hash == expected ? "" : " DIFFERS");
+		printf("  largest island up to %.1f%% of a step's pairs, largest group after splitting %.1f%%\n", islandShare * 100.0, groupShare * 100.0);
+
+		if (threads == mostThreads)
+		{
+			break;
+		}
+	}
+
+	return identical;
+}
+
+// On the given map, then on a 256x256 one of the same parameters, where the bodies are
+// packed tightly enough for a single island to hold nearly every pair
+static bool ReportScaling(DungeonMap& map, int count)
+{
+	if (!ScaleOnMap(map, count))
+	{
+		return false;
+	}
+
+	if (map.GetWidth() == 256 && map.GetHeight() == 256)
+	{
+		return true;
+	}
+
+	DungeonMap dense = map;
+	return dense.Initialize(256, 256) && dense.PCGDungeonMap(20, 20) && ScaleOnMap(dense, count);
+}
+
+// The same (count) balls and boxes stepped 1200 times with sleeping on and off, timed over
+// windows of 120 steps. Then a kick at a sleeper must wake every body in its range, and
+// no body may have left the floor either way
+static bool ReportSleep(DungeonMap& map, int count)
+{
+	WallGrid walls;
+	if (!walls.Build(map.GetHeights(), map.GetWidth(), map.GetHeight()))
+	{
+		return false;
+	}
+
+	PhysicsLevel level = { &walls, nullptr };
+	const int windows = 10;
+	const int steps = 120;
+	double windowTime[2][windows];
+	bool correct = true;
+	PhysicsWorld world;
+
+	for (int run = 0; run < 2; run++)
+	{
+		*world.GetSleeping() = run == 0;
+		if (!SpawnBodies(map, world, count, true))
+		{
+			return false;
+		}
+
+		for (int window = 0; window < windows; window++)
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			for (int step = 0; step < steps; step++)
+			{
+				world.Step(PHYSICS_FIXED_STEP, level);
+			}
+			windowTime[run][window] = MillisecondsSince(start) / steps;
+
+			if (run == 0)
+			{
+				printf("sleep: steps %4d-%4d, %d awake, %d sleeping, %.3f ms per step, %d contacts\n", window * steps, ((window + 1) * steps) - 1,
+					world.GetAwakeCount(), world.GetSleepingCount(), windowTime[run][window], world.GetContacts());
+			}
+		}
+
+		int escaped = CountEscapedBodies(world, walls);
+		correct = correct && escaped == 0 && (run == 0 || world.GetSleepingCount() == 0);
+		printf("  sleeping %s: %.3f ms per step over the last %d steps, %d escaped\n", run == 0 ? "on " : "off", windowTime[run][windows - 1], steps, escaped);
+	}
+
+	// Sleeping back on, and a kick where a sleeper lies
+	*world.GetSleeping() = true;
+	for (int step = 0; step < windows * steps && world.GetSleepingCount() == 0; step++)
+	{
+		world.Step(PHYSICS_FIXED_STEP, level);
+	}
+
+	int target = -1;
+	for (int b = 0; b < world.GetBodyCount() && target < 0; b++)
+	{
+		target = world.IsSleeping(b) ? b : -1;
+	}
+	if (target < 0)
+	{
+		printf("  no body fell asleep\n");
+		return false;
+	}
+
+	float position[3];
+	world.GetPosition(target, position);
+	int sleepingBefore = world.GetSleepingCount();
+	int kicked = world.ApplyForceInRange(position[0], position[2], KICK_RANGE, 1.0f, 0.5f, 0.0f, 50.0f);
+
+	int stillSleeping = 0;
+	for (int b = 0; b < world.GetBodyCount(); b++)
+	{
+		float other[3];
+		world.GetPosition(b, other);
+		float dx = other[0] - position[0], dz = other[2] - position[2];
+		stillSleeping += world.IsSleeping(b) && (dx * dx) + (dz * dz) <= KICK_RANGE * KICK_RANGE;
+	}
+
+	for (int step = 0; step < steps; step++)
+	{
+		world.Step(PHYSICS_FIXED_STEP, level);
+	}
+	int escaped = CountEscapedBodies(world, walls);
+
+	printf("  kick reached %d bodies, %d sleeping before and %d a second later, %d in range still asleep, %d escaped\n", kicked, sleepingBefore,
+		world.GetSleepingCount(), stillSleeping, escaped);
+
+	return correct && kicked > 0 && stillSleeping == 0 && escaped == 0;
+}
+
+// Side length of cell (i) along one axis, half cells on the map edge
+static float CellLength(int i, int size)
+{
+	return (i == 0 || i == size - 1) ? 0.5f : 1.0f;
+}
+
+// Triangle counts of both meshes, checked by area: the horizontal quads must tile the
+// map exactly and the vertical quads must cover every floor/wall boundary once
+static bool ReportWalls(DungeonMap& map)
+{
+	const float* heights = map.GetHeights();
+	int width = map.GetWidth();
+	int height = map.GetHeight();
+
+	IndexedTerrainMesh terrain;
+	TerrainMeshData blocks;
+	DungeonMeshStats stats;
+
+	if (!BuildIndexedTerrainMesh(heights, width, height, terrain) || !BuildDungeonBlockMesh(heights, width, height, blocks, &stats))
+	{
+		return false;
+	}
+
+	double horizontalArea = 0.0;
+	double wallLength = 0.0;
+	int horizontalQuads = stats.floorQuads + stats.topQuads;
+
+	for (int q = 0; q < horizontalQuads + stats.wallQuads; q++)
+	{
+		const float* a = blocks.vertices[(q * 4)].position;
+		const float* c = blocks.vertices[(q * 4) + 2].position;
+
+		if (q < horizontalQuads)
+		{
+			horizontalArea += fabs((double)(c[0] - a[0]) * (c[2] - a[2]));
+		}
+		else
+		{
+			wallLength += fabs((double)(c[0] - a[0]) + (c[2] - a[2]));
+		}
+	}
+
+	double boundaryLength = 0.0;
+	for (int j = 0; j < height; j++)
+	{
+		for (int i = 0; i < width; i++)
+		{
+			bool wall = IsDungeonWall(heights[(width * j) + i]);
+
+			if (i + 1 < width && wall != IsDungeonWall(heights[(width * j) + i + 1]))
+			{
+				boundaryLength += CellLength(j, height);
+			}
+			if (j + 1 < height && wall != IsDungeonWall(heights[(width * (j + 1)) + i]))
+			{
+				boundaryLength += CellLength(i, width);
+			}
+		}
+	}
+
+	bool tiled = horizontalArea == (double)(width - 1) * (height - 1);
+	bool enclosed = wallLength == boundaryLength;
+
+	printf("heightfield: %d triangles, %d vertices, %zu bytes\n", (int)(terrain.indices.size() / 3), (int)terrain.vertices.size(),
+		(terrain.vertices.size() * sizeof(TerrainVertex)) + (terrain.indices.size() * sizeof(uint16_t)));
+	printf("blocks: %d triangles, %d vertices, %zu bytes (%d floor, %d wall top, %d wall quads)%s%s\n", (int)(blocks.indices.size() / 3),
+		(int)blocks.vertices.size(), (blocks.vertices.size() * sizeof(TerrainVertex)) + (blocks.indices.size() * sizeof(uint32_t)),
+		stats.floorQuads, stats.topQuads, stats.wallQuads, tiled ? "" : " GAPS", enclosed ? "" : " OPEN WALLS");
+
+	return tiled && enclosed;
+}
+
+int main(int argc, char** argv)
+{
+	const char* positional[7];
+	int positionalCount = 0;
+	int mode = AUTOMATON_IN_PLACE;
+	int kernel = KERNEL_AVX2;
+	bool checkKernels = false;
+	int smoothPasses = 0;
+	int threads = 0;
+	bool async = false;
+	int normals = TERRAIN_NORMALS_CENTRAL;
+	bool quantize = false;
+	float lodDistance = 0.0f;
+	bool walls = false;
+	bool isolated = false;
+	bool reportRegions = false;
+	int collectibles = -1;
+	int pickups = 0;
+	int sweeps = 0;
+	bool field = false;
+	int bodies = 0;
+	bool contacts = false;
+	int replayFrames = 0;
+	int scaling = 0;
+	int sleep = 0;
+	float spacing = 0.0f;
+
+	for (int arg = 1; arg < argc; arg++)
+	{
+		if (strncmp(argv[arg], "--mode=", 7) == 0)
+		{
+			if (!ParseName(argv[arg] + 7, s_modeNames, AUTOMATON_MODE_COUNT, &mode))
+			{
+				fprintf(stderr, "unknown mode %s\n", argv[arg] + 7);
+				return 1;
+			}
+		}
+		else if (strncmp(argv[arg], "--kernel=", 9) == 0)
+		{
+			if (!ParseName(argv[arg] + 9, s_kernelNames, KERNEL_LEVEL_COUNT, &kernel))
+			{
+				fprintf(stderr, "unknown kernel %s\n", argv[arg] + 9);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[arg], "--kernels") == 0)
+		{
+			checkKernels = true;
+		}
+		else if (strncmp(argv[arg], "--smooth=", 9) == 0)
+		{
+			smoothPasses = atoi(argv[arg] + 9);
+		}
+		else if (strncmp(argv[arg], "--threads=", 10) == 0)
+		{
+			threads = atoi(argv[arg] + 10);
+		}
+		else if (strncmp(argv[arg], "--normals=", 10) == 0)
+		{
+			if (!ParseName(argv[arg] + 10, s_normalNames, 2, &normals))
+			{
+				fprintf(stderr, "unknown normals %s\n", argv[arg] + 10);
+				return 1;
+			}
+		}
+		else if (strncmp(argv[arg], "--lod=", 6) == 0)
+		{
+			lodDistance = (float)atof(argv[arg] + 6);
+		}
+		else if (strcmp(argv[arg], "--quantize") == 0)
+		{
+			quantize = true;
+		}
+		else if (strncmp(argv[arg], "--collectibles=", 15) == 0)
+		{
+			collectibles = atoi(argv[arg] + 15);
+		}
+		else if (strncmp(argv[arg], "--pickups=", 10) == 0)
+		{
+			pickups = atoi(argv[arg] + 10);
+		}
+		else if (strncmp(argv[arg], "--sweeps=", 9) == 0)
+		{
+			sweeps = atoi(argv[arg] + 9);
+		}
+		else if (strncmp(argv[arg], "--spacing=", 10) == 0)
+		{
+			spacing = (float)atof(argv[arg] + 10);
+		}
+		else if (strcmp(argv[arg], "--isolated") == 0)
+		{
+			isolated = true;
+		}
+		else if (strcmp(argv[arg], "--regions") == 0)
+		{
+			reportRegions = true;
+		}
+		else if (strncmp(argv[arg], "--bodies=", 9) == 0)
+		{
+			bodies = atoi(argv[arg] + 9);
+		}
+		else if (strncmp(argv[arg], "--replay=", 9) == 0)
+		{
+			replayFrames = atoi(argv[arg] + 9);
+		}
+		else if (strncmp(argv[arg], "--scaling=", 10) == 0)
+		{
+			scaling = atoi(argv[arg] + 10);
+		}
+		else if (strncmp(argv[arg], "--sleep=", 8) == 0)
+		{
+			sleep = atoi(argv[arg] + 8);
+		}
+		else if (strcmp(argv[arg], "--contacts") == 0)
+		{
+			contacts = true;
+		}
+		else if (strcmp(argv[arg], "--field") == 0)
+		{
+			field = true;
+		}
+		else if (strcmp(argv[arg], "--walls") == 0)
+		{
+			walls = true;
+		}
+		else if (strcmp(argv[arg], "--async") == 0)
+		{
+			async = true;
+		}
+		else if (argv[arg][0] == '-' && argv[arg][1] == '-')
+		{
+			PrintUsage(argv[0]);
+			return 1;
+		}
+		else if (positionalCount < 7)
+		{
+			positional[positionalCount++] = argv[arg];
+		}
+		else
+		{
+			PrintUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (positionalCount != 7)
+	{
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	int width = atoi(positional[0]);
+	int height = atoi(positional[1]);
+	const char* output = positional[6];
+
+	DungeonMap map;
+	if (!map.Initialize(width, height))
+	{
+		fprintf(stderr, "invalid map size %dx%d\n", width, height);
+		return 1;
+	}
+
+	*map.GetPCGSeed() = (unsigned int)strtoul(positional[2], NULL, 10);
+	*map.GetPCGSeedChance() = (float)atof(positional[3]);
+	*map.GetPCGThreshold() = atoi(positional[4]);
+	*map.GetPCGIterations() = atoi(positional[5]);
+	*map.GetPCGMode() = mode;
+	map.SetKernelLevel((KernelLevel)kernel);
+	map.SetThreadCount(threads);
+	*map.GetConnectRegions() = !isolated;
+	*map.GetCollectibleSpacing() = spacing;
+	if (collectibles >= 0)
+	{
+		*map.GetCollectibleCount() = collectibles;
+	}
+
+	if (checkKernels && !ReportKernels(*map.GetPCGSeed()))
+	{
+		fprintf(stderr, "row kernels disagree with scalar\n");
+		return 1;
+	}
+
+	// Start cell matches the in-game camera spawn
+	if (async)
+	{
+		if (!GenerateAsync(map, 20, 20, (TerrainNormalMode)normals, quantize ? TERRAIN_VERTEX_QUANTIZED : TERRAIN_VERTEX_FLOAT))
+		{
+			fprintf(stderr, "generation failed\n");
+			return 1;
+		}
+	}
+	else if (!map.PCGDungeonMap(20, 20))
+	{
+		fprintf(stderr, "generation failed\n");
+		return 1;
+	}
+
+	// Before smoothing, which the labels do not follow
+	if (reportRegions && !ReportRegions(map, 20, 20))
+	{
+		fprintf(stderr, "region labels disagree with a flood fill\n");
+		return 1;
+	}
+
+	if (collectibles >= 0 && !ReportCollectibles(map))
+	{
+		fprintf(stderr, "collectible placement failed\n");
+		return 1;
+	}
+
+	for (int pass = 0; pass < smoothPasses; pass++)
+	{
+		map.SmoothHeight();
+	}
+
+	if (quantize && !CheckQuantization(map, (TerrainNormalMode)normals))
+	{
+		fprintf(stderr, "quantization round trip out of tolerance\n");
+		return 1;
+	}
+
+	if (quantize && !CheckHeightFieldNormals(map))
+	{
+		fprintf(stderr, "stored height field normals disagree with the mesh\n");
+		return 1;
+	}
+
+	if (lodDistance > 0.0f && !ReportLod(map, lodDistance))
+	{
+		fprintf(stderr, "LOD draw list is not watertight\n");
+		return 1;
+	}
+
+	if (pickups > 0 && !ReportPickups(map, pickups))
+	{
+		fprintf(stderr, "pickup grid disagrees with a linear scan\n");
+		return 1;
+	}
+
+	if (sweeps > 0 && !ReportSweeps(map, sweeps))
+	{
+		fprintf(stderr, "swept collision let a circle into a wall\n");
+		return 1;
+	}
+
+	if (bodies > 0 && !ReportBodies(map, bodies))
+	{
+		fprintf(stderr, "physics bodies left the floor\n");
+		return 1;
+	}
+
+	if (contacts && !ReportContacts(map))
+	{
+		fprintf(stderr, "ball contacts missed a pair or left the floor\n");
+		return 1;
+	}
+
+	if (replayFrames > 0 && !ReportReplay(map, replayFrames))
+	{
+		fprintf(stderr, "physics replay did not match the recorded session\n");
+		return 1;
+	}
+
+	if (scaling > 0 && !ReportScaling(map, scaling))
+	{
+		fprintf(stderr, "physics differs between thread counts\n");
+		return 1;
+	}
+
+	if (sleep > 0 && !ReportSleep(map, sleep))
+	{
+		fprintf(stderr, "sleeping bodies did not wake or left the floor\n");
+		return 1;
+	}
+
+	if (field && !ReportField(map))
+	{
+		fprintf(stderr, "wall distance field is wrong\n");
+		return 1;
+	}
+
+	if (walls && !ReportWalls(map))
+	{
+		fprintf(stderr, "block mesh does not cover the map\n");
+		return 1;
+	}
+
+	if (!map.SaveGrid(output))
+	{
+		fprintf(stderr, "could not write %s\n", output);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,834 @@
+#include "DungeonMap.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <unordered_map>
+#include <utility>
+
+
+DungeonMap::DungeonMap()
+{
+	m_width = 0;
+	m_height = 0;
+	m_dirty = false;
+
+	m_seed = 0;
+	m_threshold = 5;
+	m_seedChance = 0.4f;
+	m_iterations = 5;
+	m_mode = AUTOMATON_IN_PLACE;
+	m_connectRegions = true;
+	m_carvedCells = 0;
+	m_regionsStale = true;
+
+	m_collectibleCount = COLLECTIBLE_DEFAULT_COUNT;
+	m_collectibleSpacing = 0.0f;
+
+	m_kernels = GetBestGridKernels();
+	m_threads = 0;
+}
+
+
+DungeonMap::~DungeonMap()
+{
+}
+
+bool DungeonMap::Initialize(int width, int height)
+{
+	if (width < 3 || height < 3)
+	{
+		return false;
+	}
+
+	m_width = width;
+	m_height = height;
+
+	m_heights.Initialize(m_width, m_height);
+	MarkAllDirty();
+
+	return true;
+}
+
+// Function to take Dungeon Map and imprint it onto the terrain
+bool DungeonMap::GenerateDungeonHeightMap()
+{
+	int index;
+
+	for (int j = 0; j < m_height; j++)
+	{
+		for (int i = 0; i < m_width; i++)
+		{
+			index = (m_width * j) + i;
+
+			if (i == 0 || j == 0 || i == m_width - 1 || j == m_height - 1)
+			{
+				m_heights[index] = WALL_HEIGHT;
+			}
+			else
+			{
+				m_heights[index] = FLOOR_HEIGHT;
+			}
+		}
+	}
+
+	MarkAllDirty();
+
+	m_carvedCells = 0;
+	m_regions.Label(m_heights.Heights(), m_width, m_height);
+	m_regionsStale = false;
+
+	return true;
+}
+
+// Using Cellular Automata, Construct a cave map by expanding traversable zones from a seed
+bool DungeonMap::PCGDungeonMap(int startX, int startZ)
+{
+	if (m_heights.IsEmpty())
+	{
+		return false;
+	}
+
+	SeedMap(startX, startZ);
+	MarkAllDirty();
+
+	bool result;
+	switch (m_mode)
+	{
+	case AUTOMATON_IN_PLACE:
+		RunAutomatonInPlace();
+		result = true;
+		break;
+	case AUTOMATON_DOUBLE_BUFFERED:
+		result = RunAutomatonDoubleBuffered();
+		break;
+	case AUTOMATON_BITBOARD:
+		result = RunAutomatonBitboard();
+		break;
+	default:
+		result = false;
+		break;
+	}
+
+	if (result)
+	{
+		LabelRegions();
+	}
+	return result;
+}
+
+// Runs once per generation, linear in the map size
+void DungeonMap::LabelRegions()
+{
+	m_carvedCells = 0;
+
+	if (m_regions.Label(m_heights.Heights(), m_width, m_height) > 1 && m_connectRegions)
+	{
+		m_carvedCells = m_regions.Connect(m_heights.Heights(), m_width, m_height, DUNGEON_CORRIDOR_RADIUS);
+		m_regions.Label(m_heights.Heights(), m_width, m_height);
+	}
+
+	m_regionsStale = false;
+}
+
+void DungeonMap::SeedMap(int startX, int startZ)
+{
+	ForEachRowBand(0, m_height, [this](int rowBegin, int rowEnd)
+	{
+		int index;
+
+		for (int j = rowBegin; j < rowEnd; j++)
+		{
+			for (int i = 0; i < m_width; i++)
+			{
+				index = (m_width * j) + i;
+
+				// Walls enforced on edge of map
+				if (i == 0 || j == 0 || i == m_width - 1 || j == m_height - 1)
+				{
+					m_heights[index] = WALL_HEIGHT;
+				}
+				else
+				{
+					float random = RandomUnit(m_seed, i, j, RANDOM_PASS_SEED_MAP);
+					if (random <= m_seedChance)
+					{
+						m_heights[index] = FLOOR_HEIGHT;
+					}
+					else
+					{
+						m_heights[index] = WALL_HEIGHT;
+					}
+				}
+			}
+		}
+	});
+
+	// Always Seed Camera Location as an empty area
+	if (startX >= 0 && startX < m_width && startZ >= 0 && startZ < m_height)
+	{
+		m_heights[(m_width * startZ) + startX] = FLOOR_HEIGHT;
+	}
+}
+
+// Original automaton, updates the height map while reading it so results depend on scan order
+void DungeonMap::RunAutomatonInPlace()
+{
+	int index;
+	int valid_neighbors;
+
+	for (int iter = 0; iter < m_iterations; iter++)
+	{
+		for (int j = 1; j < m_height - 1; j++)
+		{
+			for (int i = 1; i < m_width - 1; i++)
+			{
+				index = (m_width * j) + i;
+				valid_neighbors = 0;
+
+				if (j > 1)
+				{
+					// Top Left
+					if (i > 1 && m_heights[(m_width * (j - 1)) + (i - 1)] < 0)
+						valid_neighbors++;
+
+					// Top Right
+					if (i < (m_width - 2) && m_heights[(m_width * (j - 1)) + (i + 1)] < 0)
+						valid_neighbors++;
+
+					// Top Middle
+					if (m_heights[(m_width * (j - 1)) + i] < 0)
+						valid_neighbors++;
+				}
+
+				if (j < (m_height - 2))
+				{
+					// Bottom Left
+					if (i > 1 && m_heights[(m_width * (j + 1)) + (i - 1)] < 0)
+						valid_neighbors++;
+
+					// Bottom Right
+					if (i < (m_width - 2) && m_heights[(m_width * (j + 1)) + (i + 1)] < 0)
+						valid_neighbors++;
+
+					// Bottom Middle
+					if (m_heights[(m_width * (j + 1)) + i] < 0)
+						valid_neighbors++;
+				}
+
+				// Inline Left
+				if (i > 1 && m_heights[(m_width * j) + (i - 1)] < 0)
+					valid_neighbors++;
+
+				// Inline Right
+				if (i < (m_width - 2) && m_heights[(m_width * j) + (i + 1)] < 0)
+					valid_neighbors++;
+
+				// If threshold of neighbors reached
+				if (valid_neighbors >= m_threshold)
+					m_heights[index] = FLOOR_HEIGHT;
+			}
+		}
+	}
+}
+
+// Pack the interior into a byte grid (border stays wall and doubles as padding), iterate, unpack
+bool DungeonMap::RunAutomatonDoubleBuffered()
+{
+	if (m_cells.GetWidth() != m_width || m_cells.GetHeight() != m_height)
+	{
+		if (!m_cells.Initialize(m_width, m_height))
+		{
+			return false;
+		}
+	}
+
+	ForEachRowBand(1, m_height - 1, [this](int rowBegin, int rowEnd)
+	{
+		for (int j = rowBegin; j < rowEnd; j++)
+		{
+			const float* heights = &m_heights[m_width * j];
+			uint8_t* row = m_cells.Row(j);
+
+			for (int i = 1; i < m_width - 1; i++)
+			{
+				row[i] = (uint8_t)(heights[i] < 0);
+			}
+		}
+	});
+
+	if (!m_automaton.Run(m_cells, m_threshold, m_iterations, GetPool()))
+	{
+		return false;
+	}
+
+	ForEachRowBand(1, m_height - 1, [this](int rowBegin, int rowEnd)
+	{
+		for (int j = rowBegin; j < rowEnd; j++)
+		{
+			float* heights = &m_heights[m_width * j];
+			const uint8_t* row = m_cells.Row(j);
+
+			for (int i = 1; i < m_width - 1; i++)
+			{
+				heights[i] = row[i] ? FLOOR_HEIGHT : WALL_HEIGHT;
+			}
+		}
+	});
+
+	return true;
+}
+
+// Same rule as the double-buffered mode, packed 64 cells to a word
+bool DungeonMap::RunAutomatonBitboard()
+{
+	if (m_bits.GetWidth() != m_width || m_bits.GetHeight() != m_height)
+	{
+		if (!m_bits.Initialize(m_width, m_height))
+		{
+			return false;
+		}
+	}
+
+	m_bits.Clear();
+
+	ForEachRowBand(1, m_height - 1, [this](int rowBegin, int rowEnd)
+	{
+		for (int j = rowBegin; j < rowEnd; j++)
+		{
+			const float* heights = &m_heights[m_width * j];
+			uint64_t* row = m_bits.Row(j);
+
+			for (int i = 1; i < m_width - 1; i++)
+			{
+				row[i >> 6] |= (uint64_t)(heights[i] < 0) << (i & 63);
+			}
+		}
+	});
+
+	if (!m_bitAutomaton.Run(m_bits, m_threshold, m_iterations, GetPool()))
+	{
+		return false;
+	}
+
+	ForEachRowBand(1, m_height - 1, [this](int rowBegin, int rowEnd)
+	{
+		for (int j = rowBegin; j < rowEnd; j++)
+		{
+			float* heights = &m_heights[m_width * j];
+			const uint64_t* row = m_bits.Row(j);
+
+			for (int i = 1; i < m_width - 1; i++)
+			{
+				heights[i] = ((row[i >> 6] >> (i & 63)) & 1) ? FLOOR_HEIGHT : WALL_HEIGHT;
+			}
+		}
+	});
+
+	return true;
+}
+
+bool DungeonMap::SmoothHeight()
+{
+	if (m_heights.IsEmpty())
+	{
+		return false;
+	}
+
+	if (m_mode == AUTOMATON_IN_PLACE)
+	{
+		SmoothHeightInPlace();
+	}
+	else
+	{
+		SmoothHeightBuffered();
+	}
+
+	MarkAllDirty();
+
+	return true;
+}
+
+// Average of the existing cells in the 3x3 window, same order as the original smoothing
+float DungeonMap::AverageNeighbourhood(const float* heights, int i, int j) const
+{
+	float heightSum = 0.f;
+	int averageCount = 0;
+
+	if (j > 0)
+	{
+		// Top Left
+		if (i > 0)
+		{
+			averageCount++;
+			heightSum += heights[(m_width * (j - 1)) + (i - 1)];
+		}
+
+		// Top Right
+		if (i < (m_width - 1))
+		{
+			averageCount++;
+			heightSum += heights[(m_width * (j - 1)) + (i + 1)];
+		}
+
+		// Top Middle
+		averageCount++;
+		heightSum += heights[(m_width * (j - 1)) + i];
+	}
+
+	if (j < (m_height - 1))
+	{
+		// Bottom Left
+		if (i > 0)
+		{
+			averageCount++;
+			heightSum += heights[(m_width * (j + 1)) + (i - 1)];
+		}
+
+		// Bottom Right
+		if (i < (m_width - 1))
+		{
+			averageCount++;
+			heightSum += heights[(m_width * (j + 1)) + (i + 1)];
+		}
+
+		// Bottom Middle
+		averageCount++;
+		heightSum += heights[(m_width * (j + 1)) + i];
+	}
+
+	// Inline Left
+	if (i > 0)
+	{
+		averageCount++;
+		heightSum += heights[(m_width * j) + (i - 1)];
+	}
+
+	// Inline Right
+	if (i < (m_width - 1))
+	{
+		averageCount++;
+		heightSum += heights[(m_width * j) + (i + 1)];
+	}
+
+	// Ours
+	averageCount++;
+	heightSum += heights[(m_width * j) + i];
+
+	return heightSum / averageCount;
+}
+
+void DungeonMap::SmoothHeightInPlace()
+{
+	float* heights = m_heights.Heights();
+
+	for (int j = 0; j < m_height; j++)
+	{
+		for (int i = 0; i < m_width; i++)
+		{
+			heights[(m_width * j) + i] = AverageNeighbourhood(heights, i, j);
+		}
+	}
+}
+
+// Reads the previous heights only, interior rows go through the row kernel a strip at a time
+void DungeonMap::SmoothHeightBuffered()
+{
+	const float* src = m_heights.Heights();
+	if (m_smoothed.GetCount() != m_heights.GetCount())
+	{
+		m_smoothed.Initialize(m_width, m_height);
+	}
+	float* dst = m_smoothed.Heights();
+
+	ForEachRowBand(0, m_height, [this, src, dst](int rowBegin, int rowEnd)
+	{
+		for (int j = rowBegin; j < rowEnd; j++)
+		{
+			if (j == 0 || j == m_height - 1)
+			{
+				for (int i = 0; i < m_width; i++)
+				{
+					dst[(m_width * j) + i] = AverageNeighbourhood(src, i, j);
+				}
+				continue;
+			}
+
+			dst[m_width * j] = AverageNeighbourhood(src, 0, j);
+			m_kernels->smoothRow(&src[m_width * (j - 1)], &src[m_width * j], &src[m_width * (j + 1)], &dst[m_width * j], 1, m_width - 1);
+			dst[(m_width * j) + m_width - 1] = AverageNeighbourhood(src, m_width - 1, j);
+		}
+	});
+
+	m_heights.Swap(m_smoothed);
+}
+
+WorkerPool* DungeonMap::GetPool()
+{
+	int threads = m_threads > 0 ? m_threads : WorkerPool::HardwareThreads();
+	if (threads <= 1)
+	{
+		return nullptr;
+	}
+
+	if (!m_pool || m_pool->GetThreadCount() != threads)
+	{
+		m_pool = std::make_shared<WorkerPool>(threads);
+	}
+
+	return m_pool.get();
+}
+
+void DungeonMap::ForEachRowBand(int begin, int end, const std::function<void(int, int)>& task)
+{
+	WorkerPool* pool = GetPool();
+	if (!pool)
+	{
+		task(begin, end);
+		return;
+	}
+
+	int bands = pool->BandCount(begin, end, 8);
+	pool->ParallelFor(bands, [&](int band)
+	{
+		int bandBegin, bandEnd;
+		WorkerPool::BandRange(band, bands, begin, end, bandBegin, bandEnd);
+		task(bandBegin, bandEnd);
+	});
+}
+
+// Roll a particle downhill from (index) until it settles, then deposit it there
+bool DungeonMap::ParticleDepositionAtPoint(int index, float particleHeight)
+{
+	static const int neighbourOffsets[8][2] = {
+		{ -1, -1 }, { 1, -1 }, { 0, -1 },	// Top Left, Top Right, Top Middle
+		{ -1, 1 }, { 1, 1 }, { 0, 1 },		// Bottom Left, Bottom Right, Bottom Middle
+		{ -1, 0 }, { 1, 0 }					// Inline Left, Inline Right
+	};
+
+	int i, j;
+	int nextSite = index;
+	bool onFlatSurface = false;
+
+	if (index < 0 || index >= m_heights.GetCount())
+	{
+		return false;
+	}
+
+	while (!onFlatSurface)
+	{
+		onFlatSurface = true;
+		i = nextSite % m_width;
+		j = nextSite / m_width;
+
+		// Same neighbour order as the original terrain code so ties resolve identically
+		for (int n = 0; n < 8; n++)
+		{
+			int ni = i + neighbourOffsets[n][0];
+			int nj = j + neighbourOffsets[n][1];
+
+			if (ni < 0 || nj < 0 || ni >= m_width || nj >= m_height)
+				continue;
+
+			int neighbour = (m_width * nj) + ni;
+			if (m_heights[neighbour] < m_heights[nextSite])
+			{
+				onFlatSurface = false;
+				nextSite = neighbour;
+			}
+		}
+	}
+
+	m_heights[nextSite] += particleHeight;
+	MarkDirty(nextSite % m_width, nextSite / m_width, nextSite % m_width, nextSite / m_width);
+	return true;
+}
+
+bool DungeonMap::SetCellHeight(int index, float height)
+{
+	if (index < 0 || index >= m_heights.GetCount())
+	{
+		return false;
+	}
+
+	m_heights[index] = height;
+	MarkDirty(index % m_width, index / m_width, index % m_width, index / m_width);
+	return true;
+}
+
+// Poisson-disk test on a background grid of (spacing / sqrt 2) sized cells. A cell can hold
+// at most one accepted point, and any point closer than the spacing is within two cells
+class CollectibleSpacing
+{
+public:
+	explicit CollectibleSpacing(float spacing)
+	{
+		m_spacing = spacing;
+		m_cellSize = spacing * 0.70710678f;
+	}
+
+	// Records (point) when it is far enough from every accepted one
+	bool Accept(const DungeonPoint& point, const std::vector<DungeonPoint>& accepted)
+	{
+		if (m_spacing <= 0.0f)
+		{
+			return true;
+		}
+
+		int gx = (int)floorf(point.x / m_cellSize);
+		int gz = (int)floorf(point.z / m_cellSize);
+
+		for (int z = gz - 2; z <= gz + 2; z++)
+		{
+			for (int x = gx - 2; x <= gx + 2; x++)
+			{
+				std::unordered_map<uint64_t, int>::const_iterator found = m_cells.find(Key(x, z));
+				if (found == m_cells.end())
+				{
+					continue;
+				}
+
+				float dx = accepted[found->second].x - point.x;
+				float dz = accepted[found->second].z - point.z;
+				if ((dx * dx) + (dz * dz) < m_spacing * m_spacing)
+				{
+					return false;
+				}
+			}
+		}
+
+		m_cells[Key(gx, gz)] = (int)accepted.size();
+		return true;
+	}
+
+private:
+	static uint64_t Key(int x, int z)
+	{
+		return ((uint64_t)(uint32_t)x << 32) | (uint32_t)z;
+	}
+
+	float								m_spacing;
+	float								m_cellSize;
+	std::unordered_map<uint64_t, int>	m_cells;
+};
+
+// Floor ordinals come from a lazy Fisher-Yates shuffle: draw k swaps a random entry of
+// [k, floorCells) into slot k, and only slots that were touched are stored. Every floor
+// cell is drawn at most once, so placement ends after at most floorCells draws
+bool DungeonMap::PlaceCollectibles(std::vector<DungeonPoint>& collectibles)
+{
+	collectibles.clear();
+
+	if (m_regionsStale)
+	{
+		m_regions.Label(m_heights.Heights(), m_width, m_height);
+		m_regionsStale = false;
+	}
+
+	int floorCells = m_regions.GetFloorCells();
+	if (floorCells == 0)
+	{
+		return m_collectibleCount <= 0;
+	}
+
+	std::unordered_map<int, int> shuffled;
+	CollectibleSpacing spacing(m_collectibleSpacing);
+
+	for (int draw = 0; draw < floorCells && (int)collectibles.size() < m_collectibleCount; draw++)
+	{
+		int pick = draw + (int)RandomRange(m_seed, (uint32_t)draw, 0, RANDOM_PASS_COLLECTIBLES, (uint32_t)(floorCells - draw));
+
+		std::unordered_map<int, int>::iterator picked = shuffled.find(pick);
+		std::unordered_map<int, int>::iterator current = shuffled.find(draw);
+		int ordinal = picked != shuffled.end() ? picked->second : pick;
+		shuffled[pick] = current != shuffled.end() ? current->second : draw;
+
+		int index = m_regions.GetFloorCell(ordinal);
+		DungeonPoint point;
+		point.x = (float)(index % m_width);
+		point.y = m_heights[index];
+		point.z = (float)(index / m_width);
+
+		if (spacing.Accept(point, collectibles))
+		{
+			collectibles.push_back(point);
+		}
+	}
+
+	return true;
+}
+
+const RegionLabeler& DungeonMap::GetRegions() const
+{
+	return m_regions;
+}
+
+int DungeonMap::GetCarvedCells() const
+{
+	return m_carvedCells;
+}
+
+bool DungeonMap::SwapHeights(DungeonMap& other)
+{
+	if (other.m_width != m_width || other.m_height != m_height)
+	{
+		return false;
+	}
+
+	// Region labels describe the heights, so they travel with them
+	bool stale = m_regionsStale;
+	bool otherStale = other.m_regionsStale;
+	m_heights.Swap(other.m_heights);
+	std::swap(m_regions, other.m_regions);
+	std::swap(m_carvedCells, other.m_carvedCells);
+	MarkAllDirty();
+	other.MarkAllDirty();
+	m_regionsStale = otherStale;
+	other.m_regionsStale = stale;
+	return true;
+}
+
+void DungeonMap::MarkDirty(int x0, int z0, int x1, int z1)
+{
+	m_regionsStale = true;
+
+	if (!m_dirty)
+	{
+		m_dirtyRect.x0 = x0;
+		m_dirtyRect.z0 = z0;
+		m_dirtyRect.x1 = x1;
+		m_dirtyRect.z1 = z1;
+		m_dirty = true;
+		return;
+	}
+
+	m_dirtyRect.x0 = x0 < m_dirtyRect.x0 ? x0 : m_dirtyRect.x0;
+	m_dirtyRect.z0 = z0 < m_dirtyRect.z0 ? z0 : m_dirtyRect.z0;
+	m_dirtyRect.x1 = x1 > m_dirtyRect.x1 ? x1 : m_dirtyRect.x1;
+	m_dirtyRect.z1 = z1 > m_dirtyRect.z1 ? z1 : m_dirtyRect.z1;
+}
+
+void DungeonMap::MarkAllDirty()
+{
+	MarkDirty(0, 0, m_width - 1, m_height - 1);
+}
+
+bool DungeonMap::TakeDirtyRect(DungeonRect& rect)
+{
+	if (!m_dirty)
+	{
+		return false;
+	}
+
+	rect = m_dirtyRect;
+	m_dirty = false;
+	return true;
+}
+
+bool DungeonMap::SaveGrid(const char* filename) const
+{
+	FILE* file = fopen(filename, "wb");
+	if (!file)
+	{
+		return false;
+	}
+
+	fprintf(file, "P5\n%d %d\n255\n", m_width, m_height);
+
+	std::vector<unsigned char> row(m_width);
+	for (int j = 0; j < m_height; j++)
+	{
+		for (int i = 0; i < m_width; i++)
+		{
+			float t = (m_heights[(m_width * j) + i] - FLOOR_HEIGHT) / (WALL_HEIGHT - FLOOR_HEIGHT);
+			t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+			row[i] = (unsigned char)(t * 255.0f + 0.5f);
+		}
+		fwrite(row.data(), 1, m_width, file);
+	}
+
+	bool result = ferror(file) == 0;
+	fclose(file);
+
+	return result;
+}
+
+void DungeonMap::SetKernelLevel(KernelLevel level)
+{
+	m_kernels = GetGridKernels(level);
+	m_automaton.SetKernels(m_kernels);
+}
+
+const GridKernels* DungeonMap::GetKernels() const
+{
+	return m_kernels;
+}
+
+void DungeonMap::SetThreadCount(int threads)
+{
+	m_threads = threads < 0 ? 0 : threads;
+}
+
+int DungeonMap::GetThreadCount() const
+{
+	return m_threads > 0 ? m_threads : WorkerPool::HardwareThreads();
+}
+
+int DungeonMap::GetWidth() const
+{
+	return m_width;
+}
+
+int DungeonMap::GetHeight() const
+{
+	return m_height;
+}
+
+float DungeonMap::GetCellHeight(int index) const
+{
+	return m_heights[index];
+}
+
+float* DungeonMap::GetHeights()
+{
+	return m_heights.Heights();
+}
+
+unsigned int* DungeonMap::GetPCGSeed()
+{
+	return &m_seed;
+}
+
+int* DungeonMap::GetPCGIterations()
+{
+	return &m_iterations;
+}
+
+int* DungeonMap::GetPCGThreshold()
+{
+	return &m_threshold;
+}
+
+float* DungeonMap::GetPCGSeedChance()
+{
+	return &m_seedChance;
+}
+
+int* DungeonMap::GetPCGMode()
+{
+	return &m_mode;
+}
+
+bool* DungeonMap::GetConnectRegions()
+{
+	return &m_connectRegions;
+}
+
+int* DungeonMap::GetCollectibleCount()
+{
+	return &m_collectibleCount;
+}
+
+float* DungeonMap::GetCollectibleSpacing()
+{
+	return &m_collectibleSpacing;
+}
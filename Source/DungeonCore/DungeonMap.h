@@ -0,0 +1,162 @@
+#pragma once
+
+// Headless height-map / cellular automaton core for dungeon generation.
+// No DirectX or Win32 headers so it can be built as a static library on any platform.
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "BitAutomaton.h"
+#include "CaveAutomaton.h"
+#include "DungeonRandom.h"
+#include "GridKernels.h"
+#include "HeightField.h"
+#include "RegionLabeler.h"
+#include "WorkerPool.h"
+
+#define WALL_HEIGHT 100.0f
+#define FLOOR_HEIGHT -1.0f
+#define COLLECTIBLE_DEFAULT_COUNT 10
+
+// Half width of the corridors carved between regions. The player collides with any
+// wall next to its cell, so a corridor needs floor on both sides of its centre line
+#define DUNGEON_CORRIDOR_RADIUS 1
+
+enum AutomatonMode
+{
+	AUTOMATON_IN_PLACE = 0,			// Original scan-order dependent update on the height map
+	AUTOMATON_DOUBLE_BUFFERED,		// Byte grid, ping-pong buffers, branch-free inner loop
+	AUTOMATON_BITBOARD,				// 64 cells per word, same result as double buffered
+	AUTOMATON_MODE_COUNT
+};
+
+struct DungeonPoint
+{
+	float x, y, z;
+};
+
+// Inclusive cell rectangle
+struct DungeonRect
+{
+	int x0, z0, x1, z1;
+};
+
+class DungeonMap
+{
+public:
+	DungeonMap();
+	~DungeonMap();
+
+	bool Initialize(int width, int height);
+
+	// Flat floor with walls enforced on the edge of the map
+	bool GenerateDungeonHeightMap();
+
+	// Cellular automaton cave generation, the start cell is always left as floor.
+	// The initial noise is a pure function of the seed and cell, so any thread count gives the same map.
+	// Unless disabled through GetConnectRegions, sealed pockets are then joined by corridors
+	bool PCGDungeonMap(int startX, int startZ);
+
+	// 3x3 box average. In place mode keeps the original order-dependent update,
+	// the buffered modes read only the previous heights and use the vector kernels
+	bool SmoothHeight();
+	bool ParticleDepositionAtPoint(int index, float particleHeight);
+
+	// Single cell edit
+	bool SetCellHeight(int index, float height);
+
+	// Up to GetCollectibleCount distinct floor cells drawn from the seed, each at least
+	// GetCollectibleSpacing cells from the others. Samples the floor index directly, so a
+	// wall-heavy or crowded map just yields fewer points. False only if there is no floor
+	bool PlaceCollectibles(std::vector<DungeonPoint>& collectibles);
+
+	// Floor regions as of the last generation, edits since then are not reflected
+	const RegionLabeler&	GetRegions() const;
+	int						GetCarvedCells() const;
+
+	// Instruction set for the row kernels, clamped to what the CPU supports
+	void				SetKernelLevel(KernelLevel level);
+	const GridKernels*	GetKernels() const;
+
+	// Worker threads for the buffered modes, 0 uses every hardware thread.
+	// Output is identical for any thread count
+	void				SetThreadCount(int threads);
+	int					GetThreadCount() const;
+
+	// Exchanges height grids with a map of the same size, parameters and scratch stay put
+	bool SwapHeights(DungeonMap& other);
+
+	// Every change to the heights grows a dirty rectangle so the mesh can be patched
+	// instead of rebuilt. Callers that write through GetHeights mark their own edits
+	void MarkDirty(int x0, int z0, int x1, int z1);
+	void MarkAllDirty();
+	// Hands out the cells changed since the last call, false if none
+	bool TakeDirtyRect(DungeonRect& rect);
+
+	// Writes the height grid as a binary PGM image (floor black, wall white)
+	bool SaveGrid(const char* filename) const;
+
+	int		GetWidth() const;
+	int		GetHeight() const;
+	float	GetCellHeight(int index) const;
+	float*	GetHeights();
+
+	// Generation parameters, exposed as pointers so the GUI can edit them in place
+	unsigned int*	GetPCGSeed();
+	int*			GetPCGIterations();
+	int*			GetPCGThreshold();
+	float*			GetPCGSeedChance();
+	int*			GetPCGMode();
+	bool*			GetConnectRegions();
+	int*			GetCollectibleCount();
+	float*			GetCollectibleSpacing();
+
+private:
+	void SeedMap(int startX, int startZ);
+	void LabelRegions();
+	void RunAutomatonInPlace();
+	bool RunAutomatonDoubleBuffered();
+	bool RunAutomatonBitboard();
+	void SmoothHeightInPlace();
+	void SmoothHeightBuffered();
+	float AverageNeighbourhood(const float* heights, int i, int j) const;
+
+	WorkerPool* GetPool();
+	void ForEachRowBand(int begin, int end, const std::function<void(int, int)>& task);
+
+private:
+	int					m_width, m_height;
+	HeightField			m_heights;
+	bool				m_dirty;
+	DungeonRect			m_dirtyRect;
+
+	// PCG Dungeon Parameters
+	unsigned int	m_seed;
+	int				m_iterations;
+	int				m_threshold;
+	float			m_seedChance;
+	int				m_mode;
+	bool			m_connectRegions;
+
+	int				m_collectibleCount;
+	float			m_collectibleSpacing;
+
+	RegionLabeler	m_regions;
+	int				m_carvedCells;
+	bool			m_regionsStale;		// Heights edited since the last labeling
+
+	// Scratch occupancy grid for the buffered automaton modes
+	OccupancyGrid		m_cells;
+	CaveAutomaton		m_automaton;
+	BitGrid				m_bits;
+	BitCaveAutomaton	m_bitAutomaton;
+
+	const GridKernels*	m_kernels;
+	HeightField			m_smoothed;
+
+	// Created on first use and shared with copies of the map, so TerrainRegenerator's job
+	// reuses these threads rather than starting its own
+	int							m_threads;
+	std::shared_ptr<WorkerPool>	m_pool;
+};
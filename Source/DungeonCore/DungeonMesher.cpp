@@ -0,0 +1,219 @@
+#include "DungeonMesher.h"
+
+
+// Cell i spans [i - 0.5, i + 0.5], clamped to the [0, size - 1] extent of the heightfield
+static float CellMin(int i)
+{
+	return i > 0 ? (float)i - 0.5f : 0.0f;
+}
+
+static float CellMax(int i, int size)
+{
+	return i < size - 1 ? (float)i + 0.5f : (float)(size - 1);
+}
+
+// Corners in perimeter order. Wound so the face is in front when seen along -normal,
+// the same clockwise-from-above order as the heightfield triangles
+static void AddQuad(TerrainMeshData& mesh, const float corners[4][3], const float* normal, float textureStep)
+{
+	uint32_t base = (uint32_t)mesh.vertices.size();
+
+	// Planar texture projection onto the two axes the face spans
+	int u = normal[0] != 0.0f ? 2 : 0;
+	int v = normal[1] != 0.0f ? 2 : 1;
+
+	for (int c = 0; c < 4; c++)
+	{
+		TerrainVertex vertex;
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			vertex.position[axis] = corners[c][axis];
+			vertex.normal[axis] = normal[axis];
+		}
+		vertex.texture[0] = corners[c][u] * textureStep;
+		vertex.texture[1] = corners[c][v] * textureStep;
+
+		mesh.vertices.push_back(vertex);
+	}
+
+	float a[3], b[3];
+	for (int axis = 0; axis < 3; axis++)
+	{
+		a[axis] = corners[1][axis] - corners[0][axis];
+		b[axis] = corners[2][axis] - corners[0][axis];
+	}
+	float facing = (((a[1] * b[2]) - (a[2] * b[1])) * normal[0]) + (((a[2] * b[0]) - (a[0] * b[2])) * normal[1]) + (((a[0] * b[1]) - (a[1] * b[0])) * normal[2]);
+
+	static const uint32_t forward[6] = { 0, 1, 2, 0, 2, 3 };
+	static const uint32_t reversed[6] = { 0, 2, 1, 0, 3, 2 };
+	const uint32_t* order = facing > 0.0f ? forward : reversed;
+
+	for (int i = 0; i < 6; i++)
+	{
+		mesh.indices.push_back(base + order[i]);
+	}
+}
+
+// Largest rectangles of unused (type) cells, grown right along the row and then down while every row matches
+static int AddRectangles(TerrainMeshData& mesh, const std::vector<uint8_t>& walls, std::vector<uint8_t>& used,
+	int width, int height, uint8_t type, float y, float textureStep)
+{
+	static const float up[3] = { 0.0f, 1.0f, 0.0f };
+	int quads = 0;
+
+	for (int j = 0; j < height; j++)
+	{
+		for (int i = 0; i < width; i++)
+		{
+			int index = (width * j) + i;
+			if (used[index] || walls[index] != type)
+			{
+				continue;
+			}
+
+			int i1 = i + 1;
+			while (i1 < width && !used[index + (i1 - i)] && walls[index + (i1 - i)] == type)
+			{
+				i1++;
+			}
+
+			int j1 = j + 1;
+			for (; j1 < height; j1++)
+			{
+				int row = width * j1;
+				int k = i;
+				while (k < i1 && !used[row + k] && walls[row + k] == type)
+				{
+					k++;
+				}
+				if (k < i1)
+				{
+					break;
+				}
+			}
+
+			for (int jj = j; jj < j1; jj++)
+			{
+				for (int ii = i; ii < i1; ii++)
+				{
+					used[(width * jj) + ii] = 1;
+				}
+			}
+
+			float x0 = CellMin(i), x1 = CellMax(i1 - 1, width);
+			float z0 = CellMin(j), z1 = CellMax(j1 - 1, height);
+			const float corners[4][3] = { { x0, y, z0 }, { x0, y, z1 }, { x1, y, z1 }, { x1, y, z0 } };
+
+			AddQuad(mesh, corners, up, textureStep);
+			quads++;
+		}
+	}
+
+	return quads;
+}
+
+// Side of the boundary between cells (a) and (b) the floor is on: -1 for a, 1 for b, 0 when there is no wall face
+static int FloorSide(uint8_t a, uint8_t b)
+{
+	return a == b ? 0 : (a ? 1 : -1);
+}
+
+static void AddWall(TerrainMeshData& mesh, int axis, float position, float from, float to, int side, float textureStep)
+{
+	float normal[3] = { 0.0f, 0.0f, 0.0f };
+	normal[axis] = (float)side;
+
+	// (axis) is 0 for walls at constant x running along z, 2 for walls at constant z running along x
+	int run = 2 - axis;
+	float corners[4][3];
+
+	for (int c = 0; c < 4; c++)
+	{
+		corners[c][axis] = position;
+		corners[c][run] = (c == 0 || c == 1) ? from : to;
+		corners[c][1] = (c == 1 || c == 2) ? WALL_HEIGHT : FLOOR_HEIGHT;
+	}
+
+	AddQuad(mesh, corners, normal, textureStep);
+}
+
+bool BuildDungeonBlockMesh(const float* heights, int width, int height, TerrainMeshData& mesh, DungeonMeshStats* stats)
+{
+	if (!heights || width < 2 || height < 2)
+	{
+		return false;
+	}
+
+	float textureStep = 5.0f / width;
+	int count = width * height;
+	std::vector<uint8_t> walls(count);
+	std::vector<uint8_t> used(count, 0);
+
+	for (int index = 0; index < count; index++)
+	{
+		walls[index] = IsDungeonWall(heights[index]) ? 1 : 0;
+	}
+
+	mesh.vertices.clear();
+	mesh.indices.clear();
+
+	DungeonMeshStats counts;
+	counts.floorQuads = AddRectangles(mesh, walls, used, width, height, 0, FLOOR_HEIGHT, textureStep);
+	counts.topQuads = AddRectangles(mesh, walls, used, width, height, 1, WALL_HEIGHT, textureStep);
+	counts.wallQuads = 0;
+
+	// Walls at x = i + 0.5, merged along z while the floor stays on the same side
+	for (int i = 0; i < width - 1; i++)
+	{
+		int j = 0;
+		while (j < height)
+		{
+			int side = FloorSide(walls[(width * j) + i], walls[(width * j) + i + 1]);
+			int j1 = j + 1;
+			while (j1 < height && FloorSide(walls[(width * j1) + i], walls[(width * j1) + i + 1]) == side)
+			{
+				j1++;
+			}
+
+			if (side != 0)
+			{
+				AddWall(mesh, 0, (float)i + 0.5f, CellMin(j), CellMax(j1 - 1, height), side, textureStep);
+				counts.wallQuads++;
+			}
+			j = j1;
+		}
+	}
+
+	// Walls at z = j + 0.5, merged along x
+	for (int j = 0; j < height - 1; j++)
+	{
+		const uint8_t* row = &walls[width * j];
+		const uint8_t* next = row + width;
+
+		int i = 0;
+		while (i < width)
+		{
+			int side = FloorSide(row[i], next[i]);
+			int i1 = i + 1;
+			while (i1 < width && FloorSide(row[i1], next[i1]) == side)
+			{
+				i1++;
+			}
+
+			if (side != 0)
+			{
+				AddWall(mesh, 2, (float)j + 0.5f, CellMin(i), CellMax(i1 - 1, width), side, textureStep);
+				counts.wallQuads++;
+			}
+			i = i1;
+		}
+	}
+
+	if (stats)
+	{
+		*stats = counts;
+	}
+
+	return true;
+}
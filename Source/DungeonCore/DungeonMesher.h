@@ -0,0 +1,27 @@
+#pragma once
+
+// Block geometry for a floor/wall dungeon grid. Every cell is a square centred on
+// its grid point (clamped to the map edge, so the blocks cover the same area as
+// the heightfield). Floors and wall tops become greedily merged rectangles, and
+// every floor/wall boundary becomes a vertical quad facing the floor, merged
+// along straight runs. Only the faces visible from inside the dungeon are built.
+
+#include "DungeonMap.h"
+#include "TerrainMesh.h"
+
+// Cells above the midpoint of the floor and wall heights count as walls, so
+// smoothed or deposited maps still mesh to something sensible
+inline bool IsDungeonWall(float height)
+{
+	return height > (WALL_HEIGHT + FLOOR_HEIGHT) * 0.5f;
+}
+
+struct DungeonMeshStats
+{
+	int	floorQuads;
+	int	topQuads;
+	int	wallQuads;
+};
+
+// Four vertices and six indices per quad, texture tiled 5 times across the map like the heightfield
+bool BuildDungeonBlockMesh(const float* heights, int width, int height, TerrainMeshData& mesh, DungeonMeshStats* stats = nullptr);
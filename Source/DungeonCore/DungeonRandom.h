@@ -0,0 +1,44 @@
+#pragma once
+
+// Counter-based random numbers for procedural generation. Every value is a pure
+// function of (seed, x, y, pass), so cells can be drawn in any order on any thread
+// and a seed gives the same dungeon on every compiler and platform, unlike rand().
+
+#include <stdint.h>
+
+// Separate streams so passes over the same cells stay independent
+enum RandomPass
+{
+	RANDOM_PASS_SEED_MAP = 0,		// Initial floor/wall noise for the automaton
+	RANDOM_PASS_COLLECTIBLES,		// Collectible placement, x is the draw number
+	RANDOM_PASS_HEIGHTS,			// Terrain::RandomHeightMap
+	RANDOM_PASS_RESEED				// Next seed when the level is regenerated
+};
+
+// SplitMix64 finalizer
+inline uint64_t RandomMix(uint64_t z)
+{
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+inline uint64_t RandomBits(uint32_t seed, uint32_t x, uint32_t y, uint32_t pass)
+{
+	uint64_t key = RandomMix((((uint64_t)pass << 32) | seed) + 0x9E3779B97F4A7C15ULL);
+	uint64_t counter = ((uint64_t)y << 32) | x;
+
+	return RandomMix(key ^ RandomMix(counter + 0x9E3779B97F4A7C15ULL));
+}
+
+// Uniform in [0, 1)
+inline float RandomUnit(uint32_t seed, uint32_t x, uint32_t y, uint32_t pass)
+{
+	return (float)(RandomBits(seed, x, y, pass) >> 40) * (1.0f / 16777216.0f);
+}
+
+// Uniform in [0, range), range > 0
+inline uint32_t RandomRange(uint32_t seed, uint32_t x, uint32_t y, uint32_t pass, uint32_t range)
+{
+	return (uint32_t)(((RandomBits(seed, x, y, pass) >> 32) * range) >> 32);
+}
@@ -0,0 +1,328 @@
+#include "GridKernels.h"
+
+#include <math.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define DUNGEON_X86 1
+#include <emmintrin.h>
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define DUNGEON_TARGET_SSE2 __attribute__((target("sse2")))
+#define DUNGEON_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define DUNGEON_TARGET_SSE2
+#define DUNGEON_TARGET_AVX2
+#endif
+
+// Scalar
+
+static void AutomatonRowScalar(const uint8_t* above, const uint8_t* row, const uint8_t* below, uint8_t* out, int begin, int end, int threshold)
+{
+	for (int i = begin; i < end; i++)
+	{
+		int count = above[i - 1] + above[i] + above[i + 1]
+				  + row[i - 1]                + row[i + 1]
+				  + below[i - 1] + below[i] + below[i + 1];
+
+		out[i] = row[i] | (uint8_t)(count >= threshold);
+	}
+}
+
+// Summation order matches the original Terrain::SmoothHeight so the vector paths can reproduce it exactly
+static void SmoothRowScalar(const float* above, const float* row, const float* below, float* out, int begin, int end)
+{
+	for (int i = begin; i < end; i++)
+	{
+		float sum = 0.0f;
+		sum += above[i - 1];
+		sum += above[i + 1];
+		sum += above[i];
+		sum += below[i - 1];
+		sum += below[i + 1];
+		sum += below[i];
+		sum += row[i - 1];
+		sum += row[i + 1];
+		sum += row[i];
+
+		out[i] = sum / 9.0f;
+	}
+}
+
+// Gradient halves are taken as (left - right) and (above - below) so no path has to
+// negate, and one reciprocal square root scales all three components
+static void NormalRowScalar(const float* above, const float* row, const float* below, float* normals, int begin, int end)
+{
+	for (int i = begin; i < end; i++)
+	{
+		float dx = (row[i - 1] - row[i + 1]) * 0.5f;
+		float dz = (above[i] - below[i]) * 0.5f;
+		float scale = 1.0f / sqrtf((dx * dx) + (dz * dz) + 1.0f);
+
+		normals[i * 3] = dx * scale;
+		normals[i * 3 + 1] = scale;
+		normals[i * 3 + 2] = dz * scale;
+	}
+}
+
+#ifdef DUNGEON_X86
+
+// SSE2, 16 cells / 4 heights per iteration
+
+DUNGEON_TARGET_SSE2
+static void AutomatonRowSSE2(const uint8_t* above, const uint8_t* row, const uint8_t* below, uint8_t* out, int begin, int end, int threshold)
+{
+	// Counts never exceed 8, so clamping the threshold keeps the signed byte compare valid
+	int clamped = threshold < 0 ? 0 : (threshold > 9 ? 9 : threshold);
+	const __m128i limit = _mm_set1_epi8((char)(clamped - 1));
+	const __m128i one = _mm_set1_epi8(1);
+
+	int i = begin;
+	for (; i + 16 <= end; i += 16)
+	{
+		__m128i count = _mm_add_epi8(_mm_loadu_si128((const __m128i*)(above + i - 1)), _mm_loadu_si128((const __m128i*)(above + i)));
+		count = _mm_add_epi8(count, _mm_loadu_si128((const __m128i*)(above + i + 1)));
+		count = _mm_add_epi8(count, _mm_loadu_si128((const __m128i*)(row + i - 1)));
+		count = _mm_add_epi8(count, _mm_loadu_si128((const __m128i*)(row + i + 1)));
+		count = _mm_add_epi8(count, _mm_loadu_si128((const __m128i*)(below + i - 1)));
+		count = _mm_add_epi8(count, _mm_loadu_si128((const __m128i*)(below + i)));
+		count = _mm_add_epi8(count, _mm_loadu_si128((const __m128i*)(below + i + 1)));
+
+		__m128i grow = _mm_and_si128(_mm_cmpgt_epi8(count, limit), one);
+		__m128i centre = _mm_loadu_si128((const __m128i*)(row + i));
+		_mm_storeu_si128((__m128i*)(out + i), _mm_or_si128(centre, grow));
+	}
+
+	AutomatonRowScalar(above, row, below, out, i, end, threshold);
+}
+
+DUNGEON_TARGET_SSE2
+static void SmoothRowSSE2(const float* above, const float* row, const float* below, float* out, int begin, int end)
+{
+	const __m128 nine = _mm_set1_ps(9.0f);
+
+	int i = begin;
+	for (; i + 4 <= end; i += 4)
+	{
+		__m128 sum = _mm_setzero_ps();
+		sum = _mm_add_ps(sum, _mm_loadu_ps(above + i - 1));
+		sum = _mm_add_ps(sum, _mm_loadu_ps(above + i + 1));
+		sum = _mm_add_ps(sum, _mm_loadu_ps(above + i));
+		sum = _mm_add_ps(sum, _mm_loadu_ps(below + i - 1));
+		sum = _mm_add_ps(sum, _mm_loadu_ps(below + i + 1));
+		sum = _mm_add_ps(sum, _mm_loadu_ps(below + i));
+		sum = _mm_add_ps(sum, _mm_loadu_ps(row + i - 1));
+		sum = _mm_add_ps(sum, _mm_loadu_ps(row + i + 1));
+		sum = _mm_add_ps(sum, _mm_loadu_ps(row + i));
+
+		_mm_storeu_ps(out + i, _mm_div_ps(sum, nine));
+	}
+
+	SmoothRowScalar(above, row, below, out, i, end);
+}
+
+// Interleaves four x, y and z lanes into x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+DUNGEON_TARGET_SSE2
+static inline void StoreNormalsSSE2(float* normals, __m128 x, __m128 y, __m128 z)
+{
+	__m128 xy01 = _mm_unpacklo_ps(x, y);
+	__m128 xy23 = _mm_unpackhi_ps(x, y);
+
+	__m128 zx = _mm_shuffle_ps(z, xy01, _MM_SHUFFLE(2, 2, 0, 0));
+	__m128 yz = _mm_shuffle_ps(y, z, _MM_SHUFFLE(1, 1, 1, 1));
+	__m128 zx23 = _mm_shuffle_ps(z, xy23, _MM_SHUFFLE(2, 2, 2, 2));
+	__m128 yz3 = _mm_shuffle_ps(xy23, z, _MM_SHUFFLE(3, 3, 3, 3));
+
+	_mm_storeu_ps(normals, _mm_shuffle_ps(xy01, zx, _MM_SHUFFLE(2, 0, 1, 0)));
+	_mm_storeu_ps(normals + 4, _mm_shuffle_ps(yz, xy23, _MM_SHUFFLE(1, 0, 2, 0)));
+	_mm_storeu_ps(normals + 8, _mm_shuffle_ps(zx23, yz3, _MM_SHUFFLE(2, 0, 2, 0)));
+}
+
+DUNGEON_TARGET_SSE2
+static void NormalRowSSE2(const float* above, const float* row, const float* below, float* normals, int begin, int end)
+{
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	int i = begin;
+	for (; i + 4 <= end; i += 4)
+	{
+		__m128 dx = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(row + i - 1), _mm_loadu_ps(row + i + 1)), half);
+		__m128 dz = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(above + i), _mm_loadu_ps(below + i)), half);
+		__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dz, dz)), one));
+		__m128 scale = _mm_div_ps(one, length);
+
+		StoreNormalsSSE2(normals + i * 3, _mm_mul_ps(dx, scale), scale, _mm_mul_ps(dz, scale));
+	}
+
+	NormalRowScalar(above, row, below, normals, i, end);
+}
+
+// AVX2, 32 cells / 8 heights per iteration
+
+DUNGEON_TARGET_AVX2
+static void AutomatonRowAVX2(const uint8_t* above, const uint8_t* row, const uint8_t* below, uint8_t* out, int begin, int end, int threshold)
+{
+	int clamped = threshold < 0 ? 0 : (threshold > 9 ? 9 : threshold);
+	const __m256i limit = _mm256_set1_epi8((char)(clamped - 1));
+	const __m256i one = _mm256_set1_epi8(1);
+
+	int i = begin;
+	for (; i + 32 <= end; i += 32)
+	{
+		__m256i count = _mm256_add_epi8(_mm256_loadu_si256((const __m256i*)(above + i - 1)), _mm256_loadu_si256((const __m256i*)(above + i)));
+		count = _mm256_add_epi8(count, _mm256_loadu_si256((const __m256i*)(above + i + 1)));
+		count = _mm256_add_epi8(count, _mm256_loadu_si256((const __m256i*)(row + i - 1)));
+		count = _mm256_add_epi8(count, _mm256_loadu_si256((const __m256i*)(row + i + 1)));
+		count = _mm256_add_epi8(count, _mm256_loadu_si256((const __m256i*)(below + i - 1)));
+		count = _mm256_add_epi8(count, _mm256_loadu_si256((const __m256i*)(below + i)));
+		count = _mm256_add_epi8(count, _mm256_loadu_si256((const __m256i*)(below + i + 1)));
+
+		__m256i grow = _mm256_and_si256(_mm256_cmpgt_epi8(count, limit), one);
+		__m256i centre = _mm256_loadu_si256((const __m256i*)(row + i));
+		_mm256_storeu_si256((__m256i*)(out + i), _mm256_or_si256(centre, grow));
+	}
+
+	AutomatonRowSSE2(above, row, below, out, i, end, threshold);
+}
+
+DUNGEON_TARGET_AVX2
+static void SmoothRowAVX2(const float* above, const float* row, const float* below, float* out, int begin, int end)
+{
+	const __m256 nine = _mm256_set1_ps(9.0f);
+
+	int i = begin;
+	for (; i + 8 <= end; i += 8)
+	{
+		__m256 sum = _mm256_setzero_ps();
+		sum = _mm256_add_ps(sum, _mm256_loadu_ps(above + i - 1));
+		sum = _mm256_add_ps(sum, _mm256_loadu_ps(above + i + 1));
+		sum = _mm256_add_ps(sum, _mm256_loadu_ps(above + i));
+		sum = _mm256_add_ps(sum, _mm256_loadu_ps(below + i - 1));
+		sum = _mm256_add_ps(sum, _mm256_loadu_ps(below + i + 1));
+		sum = _mm256_add_ps(sum, _mm256_loadu_ps(below + i));
+		sum = _mm256_add_ps(sum, _mm256_loadu_ps(row + i - 1));
+		sum = _mm256_add_ps(sum, _mm256_loadu_ps(row + i + 1));
+		sum = _mm256_add_ps(sum, _mm256_loadu_ps(row + i));
+
+		_mm256_storeu_ps(out + i, _mm256_div_ps(sum, nine));
+	}
+
+	SmoothRowSSE2(above, row, below, out, i, end);
+}
+
+DUNGEON_TARGET_AVX2
+static void NormalRowAVX2(const float* above, const float* row, const float* below, float* normals, int begin, int end)
+{
+	const __m256 half = _mm256_set1_ps(0.5f);
+	const __m256 one = _mm256_set1_ps(1.0f);
+
+	int i = begin;
+	for (; i + 8 <= end; i += 8)
+	{
+		__m256 dx = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(row + i - 1), _mm256_loadu_ps(row + i + 1)), half);
+		__m256 dz = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(above + i), _mm256_loadu_ps(below + i)), half);
+		__m256 length = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dz, dz)), one));
+		__m256 scale = _mm256_div_ps(one, length);
+		__m256 x = _mm256_mul_ps(dx, scale);
+		__m256 z = _mm256_mul_ps(dz, scale);
+
+		// The interleave is cheaper per 128-bit half than across lanes
+		StoreNormalsSSE2(normals + i * 3, _mm256_castps256_ps128(x), _mm256_castps256_ps128(scale), _mm256_castps256_ps128(z));
+		StoreNormalsSSE2(normals + i * 3 + 12, _mm256_extractf128_ps(x, 1), _mm256_extractf128_ps(scale, 1), _mm256_extractf128_ps(z, 1));
+	}
+
+	NormalRowSSE2(above, row, below, normals, i, end);
+}
+
+static void CpuId(int leaf, int subleaf, int regs[4])
+{
+#if defined(_MSC_VER)
+	__cpuidex(regs, leaf, subleaf);
+#else
+	__asm__ __volatile__("cpuid" : "=a"(regs[0]), "=b"(regs[1]), "=c"(regs[2]), "=d"(regs[3]) : "a"(leaf), "c"(subleaf));
+#endif
+}
+
+static uint64_t ReadXCR0()
+{
+#if defined(_MSC_VER)
+	return _xgetbv(0);
+#else
+	uint32_t lo, hi;
+	__asm__ __volatile__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+	return ((uint64_t)hi << 32) | lo;
+#endif
+}
+
+#endif
+
+static const GridKernels s_kernels[KERNEL_LEVEL_COUNT] = {
+	{ KERNEL_SCALAR, "scalar", AutomatonRowScalar, SmoothRowScalar, NormalRowScalar },
+#ifdef DUNGEON_X86
+	{ KERNEL_SSE2, "sse2", AutomatonRowSSE2, SmoothRowSSE2, NormalRowSSE2 },
+	{ KERNEL_AVX2, "avx2", AutomatonRowAVX2, SmoothRowAVX2, NormalRowAVX2 },
+#else
+	{ KERNEL_SCALAR, "scalar", AutomatonRowScalar, SmoothRowScalar, NormalRowScalar },
+	{ KERNEL_SCALAR, "scalar", AutomatonRowScalar, SmoothRowScalar, NormalRowScalar },
+#endif
+};
+
+KernelLevel DetectKernelLevel()
+{
+#ifdef DUNGEON_X86
+	int regs[4];
+
+	CpuId(0, 0, regs);
+	int maxLeaf = regs[0];
+
+	CpuId(1, 0, regs);
+	bool sse2 = (regs[3] & (1 << 26)) != 0;
+	bool osxsave = (regs[2] & (1 << 27)) != 0;
+	bool avx = (regs[2] & (1 << 28)) != 0;
+
+	if (!sse2)
+	{
+		return KERNEL_SCALAR;
+	}
+
+	// AVX2 also needs the OS to save the YMM registers
+	if (maxLeaf >= 7 && osxsave && avx && (ReadXCR0() & 0x6) == 0x6)
+	{
+		CpuId(7, 0, regs);
+		if (regs[1] & (1 << 5))
+		{
+			return KERNEL_AVX2;
+		}
+	}
+
+	return KERNEL_SSE2;
+#else
+	return KERNEL_SCALAR;
+#endif
+}
+
+const GridKernels* GetGridKernels(KernelLevel level)
+{
+	static const KernelLevel supported = DetectKernelLevel();
+
+	if (level > supported)
+	{
+		level = supported;
+	}
+	if (level < KERNEL_SCALAR)
+	{
+		level = KERNEL_SCALAR;
+	}
+
+	return &s_kernels[level];
+}
+
+const GridKernels* GetBestGridKernels()
+{
+	return GetGridKernels(KERNEL_AVX2);
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+// Row-strip kernels for the 3x3 window passes (byte automaton, height smoothing and
+// central-difference normals).
+// The best instruction set is picked at runtime; every path gives bit-identical output.
+
+#include <stdint.h>
+
+enum KernelLevel
+{
+	KERNEL_SCALAR = 0,
+	KERNEL_SSE2,
+	KERNEL_AVX2,
+	KERNEL_LEVEL_COUNT
+};
+
+// Automaton step for cells [begin, end) of one row, reading the rows above and below
+typedef void (*AutomatonRowFn)(const uint8_t* above, const uint8_t* row, const uint8_t* below, uint8_t* out, int begin, int end, int threshold);
+
+// 3x3 box average for cells [begin, end) of one row, all nine taps must exist
+typedef void (*SmoothRowFn)(const float* above, const float* row, const float* below, float* out, int begin, int end);
+
+// Central-difference vertex normals for cells [begin, end) of one row, written as
+// x, y, z triples to normals + 3 * i. Needs the left, right, above and below taps
+typedef void (*NormalRowFn)(const float* above, const float* row, const float* below, float* normals, int begin, int end);
+
+struct GridKernels
+{
+	KernelLevel		level;
+	const char*		name;
+	AutomatonRowFn	automatonRow;
+	SmoothRowFn		smoothRow;
+	NormalRowFn		normalRow;
+};
+
+// Highest level supported by this CPU and build
+KernelLevel DetectKernelLevel();
+
+// Kernels for (level), clamped to what the CPU supports
+const GridKernels* GetGridKernels(KernelLevel level);
+const GridKernels* GetBestGridKernels();
@@ -0,0 +1,94 @@
+#include "HeightField.h"
+#include "NormalEncoding.h"
+#include "TerrainMesh.h"
+
+#include <utility>
+
+
+HeightField::HeightField()
+{
+	m_width = 0;
+	m_height = 0;
+	m_normalMode = TERRAIN_NORMALS_CENTRAL;
+}
+
+bool HeightField::Initialize(int width, int height, bool storeNormals, TerrainNormalMode mode)
+{
+	if (width < 2 || height < 2)
+	{
+		return false;
+	}
+
+	m_width = width;
+	m_height = height;
+	m_normalMode = mode;
+	m_heights.assign((size_t)m_width * m_height, 0.0f);
+
+	if (storeNormals)
+	{
+		m_normals.assign((size_t)m_width * m_height * 2, 0);
+		UpdateNormals(0, 0, m_width - 1, m_height - 1);
+	}
+	else
+	{
+		m_normals.clear();
+	}
+
+	return true;
+}
+
+void HeightField::Swap(HeightField& other)
+{
+	std::swap(m_width, other.m_width);
+	std::swap(m_height, other.m_height);
+	std::swap(m_normalMode, other.m_normalMode);
+	m_heights.swap(other.m_heights);
+	m_normals.swap(other.m_normals);
+}
+
+bool HeightField::HasNormals() const
+{
+	return !m_normals.empty();
+}
+
+void HeightField::UpdateNormals(int x0, int z0, int x1, int z1)
+{
+	if (!HasNormals())
+	{
+		return;
+	}
+
+	// Vertex normals read the heights one cell around them
+	x0 = x0 > 0 ? x0 - 1 : 0;
+	z0 = z0 > 0 ? z0 - 1 : 0;
+	x1 = x1 < m_width - 1 ? x1 + 1 : m_width - 1;
+	z1 = z1 < m_height - 1 ? z1 + 1 : m_height - 1;
+
+	for (int j = z0; j <= z1; j++)
+	{
+		for (int i = x0; i <= x1; i++)
+		{
+			float normal[3];
+			CalculateTerrainNormal(m_heights.data(), m_width, m_height, i, j, normal, m_normalMode);
+			EncodeOctahedral(normal, &m_normals[((size_t)m_width * j + i) * 2]);
+		}
+	}
+}
+
+void HeightField::GetNormal(int index, float* normal) const
+{
+	if (!HasNormals())
+	{
+		normal[0] = 0.0f;
+		normal[1] = 1.0f;
+		normal[2] = 0.0f;
+		return;
+	}
+
+	DecodeOctahedral(&m_normals[(size_t)index * 2], normal);
+}
+
+size_t HeightField::GetMemoryBytes() const
+{
+	return (m_heights.size() * sizeof(float)) + (m_normals.size() * sizeof(int16_t));
+}
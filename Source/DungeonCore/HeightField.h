@@ -0,0 +1,57 @@
+#pragma once
+
+// Structure-of-arrays height grid, the storage behind DungeonMap's heights. Only the
+// heights (and optionally octahedral quantized normals) are stored; x, z and the
+// texture coordinates are pure functions of the cell index and are derived on demand.
+// 4 bytes per cell, 8 with normals, against 32 for the old interleaved HeightMapType.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "TerrainMesh.h"
+
+class HeightField
+{
+public:
+	HeightField();
+
+	// Flat grid at height 0. Stored normals are computed in (mode)
+	bool Initialize(int width, int height, bool storeNormals = false, TerrainNormalMode mode = TERRAIN_NORMALS_CENTRAL);
+
+	int GetWidth() const	{ return m_width; }
+	int GetHeight() const	{ return m_height; }
+	int GetCount() const	{ return (int)m_heights.size(); }
+	bool IsEmpty() const	{ return m_heights.empty(); }
+
+	// Heights in row order, the float array every pass reads
+	float&			operator[](int index)			{ return m_heights[index]; }
+	float			operator[](int index) const		{ return m_heights[index]; }
+	float			GetY(int index) const			{ return m_heights[index]; }
+	void			SetY(int index, float y)		{ m_heights[index] = y; }
+	float*			Heights()						{ return m_heights.data(); }
+	const float*	Heights() const					{ return m_heights.data(); }
+
+	// Derived per cell, same values Terrain used to store
+	float GetX(int index) const	{ return (float)(index % m_width); }
+	float GetZ(int index) const	{ return (float)(index / m_width); }
+	float GetU(int index) const	{ return GetX(index) * (5.0f / m_width); }
+	float GetV(int index) const	{ return GetZ(index) * (5.0f / m_width); }
+
+	// Exchanges everything with (other), no copy
+	void Swap(HeightField& other);
+
+	// Quantized normals. Writes through Heights() or operator[] leave them alone, so the
+	// owner updates the vertices that read cells in the edited rectangle
+	bool HasNormals() const;
+	void UpdateNormals(int x0, int z0, int x1, int z1);
+	void GetNormal(int index, float* normal) const;
+
+	size_t GetMemoryBytes() const;
+
+private:
+	int						m_width, m_height;
+	TerrainNormalMode		m_normalMode;
+	std::vector<float>		m_heights;
+	std::vector<int16_t>	m_normals;		// Two octahedral components per cell
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+// Octahedral unit vector encoding. A normal is folded onto the octahedron and
+// stored as two signed normalized 16-bit values (4 bytes instead of 12).
+
+#include <math.h>
+#include <stdint.h>
+
+inline float OctSign(float v)
+{
+	return v >= 0.0f ? 1.0f : -1.0f;
+}
+
+inline int16_t OctQuantize(float v)
+{
+	v = v < -1.0f ? -1.0f : (v > 1.0f ? 1.0f : v);
+	return (int16_t)lrintf(v * 32767.0f);
+}
+
+inline void EncodeOctahedral(const float* normal, int16_t* encoded)
+{
+	float l1 = fabsf(normal[0]) + fabsf(normal[1]) + fabsf(normal[2]);
+	float u = normal[0] / l1;
+	float v = normal[2] / l1;
+
+	// Lower hemisphere folds over the diagonals
+	if (normal[1] < 0.0f)
+	{
+		float foldU = (1.0f - fabsf(v)) * OctSign(u);
+		float foldV = (1.0f - fabsf(u)) * OctSign(v);
+		u = foldU;
+		v = foldV;
+	}
+
+	encoded[0] = OctQuantize(u);
+	encoded[1] = OctQuantize(v);
+}
+
+inline void DecodeOctahedral(const int16_t* encoded, float* normal)
+{
+	float u = (float)encoded[0] / 32767.0f;
+	float v = (float)encoded[1] / 32767.0f;
+	float y = 1.0f - fabsf(u) - fabsf(v);
+
+	if (y < 0.0f)
+	{
+		float foldU = (1.0f - fabsf(v)) * OctSign(u);
+		float foldV = (1.0f - fabsf(u)) * OctSign(v);
+		u = foldU;
+		v = foldV;
+	}
+
+	float length = sqrtf((u * u) + (y * y) + (v * v));
+	normal[0] = u / length;
+	normal[1] = y / length;
+	normal[2] = v / length;
+}
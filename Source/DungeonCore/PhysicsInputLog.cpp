@@ -0,0 +1,146 @@
+#include "PhysicsInputLog.h"
+
+
+void PhysicsInputLog::Clear()
+{
+	m_inputs.clear();
+}
+
+PhysicsInput& PhysicsInputLog::Record(const PhysicsWorld& world, PhysicsInputType type)
+{
+	PhysicsInput input = {};
+	input.step = world.GetStepCount();
+	input.type = type;
+	input.body = -1;
+
+	m_inputs.push_back(input);
+	return m_inputs.back();
+}
+
+int PhysicsInputLog::Apply(PhysicsWorld& world, const PhysicsInput& input)
+{
+	switch (input.type)
+	{
+	case PHYSICS_INPUT_BALL:
+		return world.SpawnBall(input.x, input.y, input.z, input.amount, input.size);
+	case PHYSICS_INPUT_BOX:
+		return world.SpawnBox(input.x, input.y, input.z, input.amount, input.size);
+	case PHYSICS_INPUT_FORCE:
+		if (input.body >= 0 && input.body < world.GetBodyCount())
+		{
+			world.ApplyForce(input.body, input.directionX, input.directionY, input.directionZ, input.amount);
+		}
+		return input.body;
+	case PHYSICS_INPUT_FORCE_IN_RANGE:
+		return world.ApplyForceInRange(input.x, input.z, input.size, input.directionX, input.directionY, input.directionZ, input.amount);
+	case PHYSICS_INPUT_PARAMETERS:
+		world.SetParameters(input.parameters);
+		return 0;
+	}
+
+	return -1;
+}
+
+int PhysicsInputLog::SpawnBall(PhysicsWorld& world, float x, float y, float z, float mass, float radius)
+{
+	PhysicsInput& input = Record(world, PHYSICS_INPUT_BALL);
+	input.x = x;
+	input.y = y;
+	input.z = z;
+	input.amount = mass;
+	input.size = radius;
+
+	return Apply(world, input);
+}
+
+int PhysicsInputLog::SpawnBox(PhysicsWorld& world, float x, float y, float z, float mass, float halfSize)
+{
+	PhysicsInput& input = Record(world, PHYSICS_INPUT_BOX);
+	input.x = x;
+	input.y = y;
+	input.z = z;
+	input.amount = mass;
+	input.size = halfSize;
+
+	return Apply(world, input);
+}
+
+void PhysicsInputLog::ApplyForce(PhysicsWorld& world, int body, float directionX, float directionY, float directionZ, float force)
+{
+	PhysicsInput& input = Record(world, PHYSICS_INPUT_FORCE);
+	input.body = body;
+	input.directionX = directionX;
+	input.directionY = directionY;
+	input.directionZ = directionZ;
+	input.amount = force;
+
+	Apply(world, input);
+}
+
+int PhysicsInputLog::ApplyForceInRange(PhysicsWorld& world, float x, float z, float range, float directionX, float directionY, float directionZ, float force)
+{
+	PhysicsInput& input = Record(world, PHYSICS_INPUT_FORCE_IN_RANGE);
+	input.x = x;
+	input.z = z;
+	input.size = range;
+	input.directionX = directionX;
+	input.directionY = directionY;
+	input.directionZ = directionZ;
+	input.amount = force;
+
+	return Apply(world, input);
+}
+
+bool PhysicsInputLog::SetParameters(PhysicsWorld& world, const PhysicsParameters& parameters)
+{
+	PhysicsParameters current;
+	world.GetParameters(current);
+
+	// The first parameters of a log are always recorded, a fresh world may not have them
+	if (!m_inputs.empty() && current.gravity == parameters.gravity && current.friction == parameters.friction
+		&& current.elasticity == parameters.elasticity && current.floorHeight == parameters.floorHeight && current.sleeping == parameters.sleeping)
+	{
+		return false;
+	}
+
+	PhysicsInput& input = Record(world, PHYSICS_INPUT_PARAMETERS);
+	input.parameters = parameters;
+
+	Apply(world, input);
+	return true;
+}
+
+void PhysicsInputLog::Replay(PhysicsWorld& world, int steps, const PhysicsLevel& level) const
+{
+	size_t next = 0;
+	while (next < m_inputs.size() && m_inputs[next].step < world.GetStepCount())
+	{
+		next++;
+	}
+
+	while (world.GetStepCount() < steps)
+	{
+		for (; next < m_inputs.size() && m_inputs[next].step == world.GetStepCount(); next++)
+		{
+			Apply(world, m_inputs[next]);
+		}
+
+		world.Step(PHYSICS_FIXED_STEP, level);
+	}
+
+	// Inputs that arrived after the last step are waiting on the next one
+	for (; next < m_inputs.size() && m_inputs[next].step == world.GetStepCount(); next++)
+	{
+		Apply(world, m_inputs[next]);
+	}
+}
+
+int PhysicsInputLog::GetCount() const
+{
+	return (int)m_inputs.size();
+}
+
+const PhysicsInput& PhysicsInputLog::GetInput(int input) const
+{
+	return m_inputs[input];
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+// Everything the player does to a PhysicsWorld, stamped with the step it takes effect
+// on. Inputs go through the log on their way to the world, and replaying the log into
+// a world cleared the same way reproduces the recording exactly, whatever frame times
+// drove it, since steps are fixed and each input lands before the same step again.
+// Parameter changes are inputs too, so a session that moves the GUI sliders replays
+// with them moved at the same steps.
+
+#include <vector>
+
+#include "PhysicsWorld.h"
+
+enum PhysicsInputType
+{
+	PHYSICS_INPUT_BALL = 0,
+	PHYSICS_INPUT_BOX,
+	PHYSICS_INPUT_FORCE,
+	PHYSICS_INPUT_FORCE_IN_RANGE,
+	PHYSICS_INPUT_PARAMETERS
+};
+
+struct PhysicsInput
+{
+	int		step;			// World step count when the input arrived
+	int		type;			// PhysicsInputType
+	int		body;			// PHYSICS_INPUT_FORCE only
+	float	x, y, z;		// Spawn position or range centre
+	float	directionX, directionY, directionZ;
+	float	amount;			// Mass or force
+	float	size;			// Radius, half size or range
+	PhysicsParameters	parameters;	// PHYSICS_INPUT_PARAMETERS only
+};
+
+class PhysicsInputLog
+{
+public:
+	void Clear();
+
+	// Each applies the input to (world) and records it
+	int		SpawnBall(PhysicsWorld& world, float x, float y, float z, float mass, float radius);
+	int		SpawnBox(PhysicsWorld& world, float x, float y, float z, float mass, float halfSize);
+	void	ApplyForce(PhysicsWorld& world, int body, float directionX, float directionY, float directionZ, float force);
+	int		ApplyForceInRange(PhysicsWorld& world, float x, float z, float range, float directionX, float directionY, float directionZ, float force);
+
+	// Recorded only if they differ from the world's, returns whether they did. Record the
+	// starting parameters right after clearing so a fresh world replays from them too
+	bool	SetParameters(PhysicsWorld& world, const PhysicsParameters& parameters);
+
+	// Steps (world) on from its current step count to (steps), applying every recorded
+	// input before the step it arrived at
+	void	Replay(PhysicsWorld& world, int steps, const PhysicsLevel& level) const;
+
+	int					GetCount() const;
+	const PhysicsInput&	GetInput(int input) const;
+
+private:
+	PhysicsInput&	Record(const PhysicsWorld& world, PhysicsInputType type);
+	static int		Apply(PhysicsWorld& world, const PhysicsInput& input);
+
+private:
+	std::vector<PhysicsInput>	m_inputs;
+};
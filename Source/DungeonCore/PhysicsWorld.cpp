@@ -0,0 +1,1039 @@
+#include "PhysicsWorld.h"
+
+#include <algorithm>
+#include <math.h>
+
+
+PhysicsWorld::PhysicsWorld()
+{
+	m_gravity = 0.5f;
+	m_friction = 0.5f;
+	m_elastic = 0.3f;
+	m_floorHeight = 0.0f;
+	m_sleepEnabled = true;
+	m_sleepersChanged = false;
+	m_candidatePairs = 0;
+	m_contacts = 0;
+	m_accumulator = 0.0f;
+	m_stepTime = PHYSICS_FIXED_STEP;
+	m_stepCount = 0;
+	m_stepLevel = nullptr;
+	m_pool = nullptr;
+	m_phase = 0;
+	m_largestIsland = 0;
+	m_largestGroup = 0;
+
+	for (int phase = 0; phase <= PHYSICS_ISLAND_PHASES; phase++)
+	{
+		m_phaseGroups[phase] = 0;
+	}
+}
+
+int PhysicsWorld::AddBody(PhysicsShape shape, float x, float y, float z, float mass, float radius)
+{
+	if (mass <= 0.0f || radius <= 0.0f)
+	{
+		return -1;
+	}
+
+	m_positionX.push_back(x);
+	m_positionY.push_back(y);
+	m_positionZ.push_back(z);
+	m_previousX.push_back(x);
+	m_previousY.push_back(y);
+	m_previousZ.push_back(z);
+
+	// Spawned rolling, as the single ball always was
+	m_velocityX.push_back(1.0f);
+	m_velocityY.push_back(0.0f);
+	m_velocityZ.push_back(1.0f);
+
+	m_accelerationX.push_back(0.0f);
+	m_accelerationY.push_back(0.0f);
+	m_accelerationZ.push_back(0.0f);
+	m_impulseX.push_back(0.0f);
+	m_impulseY.push_back(0.0f);
+	m_impulseZ.push_back(0.0f);
+
+	m_radius.push_back(radius);
+	m_inverseMass.push_back(1.0f / mass);
+	m_shape.push_back((uint8_t)shape);
+
+	m_rotationX.push_back(0.0f);
+	m_rotationY.push_back(0.0f);
+	m_rotationZ.push_back(0.0f);
+	m_rotationW.push_back(1.0f);
+
+	m_restTime.push_back(0.0f);
+	m_sleepState.push_back(PHYSICS_AWAKE);
+
+	int count = (int)m_positionX.size();
+	m_nextX.resize(count);
+	m_nextY.resize(count);
+	m_nextZ.resize(count);
+	m_nextVelocityX.resize(count);
+	m_nextVelocityY.resize(count);
+	m_nextVelocityZ.resize(count);
+
+	return count - 1;
+}
+
+int PhysicsWorld::SpawnBall(float x, float y, float z, float mass, float radius)
+{
+	return AddBody(PHYSICS_BALL, x, y, z, mass, radius);
+}
+
+int PhysicsWorld::SpawnBox(float x, float y, float z, float mass, float halfSize)
+{
+	return AddBody(PHYSICS_BOX, x, y, z, mass, halfSize);
+}
+
+void PhysicsWorld::GetFloatArrays(std::vector<float>* arrays[PHYSICS_FLOAT_ARRAYS])
+{
+	std::vector<float>* all[PHYSICS_FLOAT_ARRAYS] = { &m_positionX, &m_positionY, &m_positionZ, &m_previousX, &m_previousY, &m_previousZ,
+		&m_velocityX, &m_velocityY, &m_velocityZ, &m_accelerationX, &m_accelerationY, &m_accelerationZ,
+		&m_impulseX, &m_impulseY, &m_impulseZ, &m_radius, &m_inverseMass,
+		&m_rotationX, &m_rotationY, &m_rotationZ, &m_rotationW, &m_restTime,
+		&m_nextX, &m_nextY, &m_nextZ, &m_nextVelocityX, &m_nextVelocityY, &m_nextVelocityZ };
+
+	for (int a = 0; a < PHYSICS_FLOAT_ARRAYS; a++)
+	{
+		arrays[a] = all[a];
+	}
+}
+
+// Pairs are reserved at two per body, more only grow the pair list in the rare step that needs them
+void PhysicsWorld::Reserve(int bodies)
+{
+	std::vector<float>* arrays[PHYSICS_FLOAT_ARRAYS];
+	GetFloatArrays(arrays);
+
+	for (int a = 0; a < PHYSICS_FLOAT_ARRAYS; a++)
+	{
+		arrays[a]->reserve(bodies);
+	}
+	m_shape.reserve(bodies);
+	m_sleepState.reserve(bodies);
+	m_awake.reserve(bodies);
+	m_sleepers.reserve(bodies);
+	m_bodyGrid.Reserve(bodies);
+	m_sleepGrid.Reserve(bodies);
+	m_pairs.reserve(4 * bodies);
+	m_pairIsland.reserve(2 * bodies);
+	m_islandPairs.reserve(2 * bodies);
+	m_islandGroup.reserve(2 * bodies);
+	m_islandStart.reserve((2 * bodies) + 1);
+
+	// The serial band's row cursors, enough for bodies up to a cell and a half across
+	if (m_bands.empty())
+	{
+		m_bands.resize(1);
+	}
+	m_bands[0].cursors.reserve(8);
+}
+
+void PhysicsWorld::Clear()
+{
+	std::vector<float>* arrays[PHYSICS_FLOAT_ARRAYS];
+	GetFloatArrays(arrays);
+
+	for (int a = 0; a < PHYSICS_FLOAT_ARRAYS; a++)
+	{
+		arrays[a]->clear();
+	}
+	m_shape.clear();
+	m_sleepState.clear();
+	m_awake.clear();
+	m_sleepers.clear();
+	m_sleepGrid.Clear();
+	m_sleepersChanged = false;
+	m_pairs.clear();
+	m_candidatePairs = 0;
+	m_contacts = 0;
+	m_largestIsland = 0;
+	m_largestGroup = 0;
+	m_accumulator = 0.0f;
+	m_stepCount = 0;
+}
+
+// Whole fixed steps only, the remainder carries over to the next frame. Time owed
+// beyond the substep cap is dropped, so a long frame slows the world down rather than
+// making every following frame longer still
+int PhysicsWorld::Advance(float dTime, const PhysicsLevel& level)
+{
+	m_accumulator += dTime > 0.0f ? dTime : 0.0f;
+
+	int steps = 0;
+	while (m_accumulator >= PHYSICS_FIXED_STEP && steps < PHYSICS_MAX_SUBSTEPS)
+	{
+		Step(PHYSICS_FIXED_STEP, level);
+		m_accumulator -= PHYSICS_FIXED_STEP;
+		steps++;
+	}
+
+	if (m_accumulator >= PHYSICS_FIXED_STEP)
+	{
+		m_accumulator = 0.0f;
+	}
+
+	return steps;
+}
+
+// Bodies per band, and pairs per band, below which a pass is not worth splitting
+#define PHYSICS_BAND_BODIES		1024
+#define PHYSICS_BAND_PAIRS		512
+
+void PhysicsWorld::SetWorkerPool(WorkerPool* pool)
+{
+	m_pool = pool;
+}
+
+// Runs (task) over [0, count) in bands, one band on the calling thread without a pool.
+// Returns the number of bands, each with its own entry in m_bands
+int PhysicsWorld::ForEachBand(int count, int minCount, BandTask task)
+{
+	int bands = m_pool ? m_pool->BandCount(0, count, minCount) : (count > 0 ? 1 : 0);
+	if (bands > (int)m_bands.size())
+	{
+		m_bands.resize(bands);
+	}
+
+	if (bands <= 1)
+	{
+		if (bands == 1)
+		{
+			(this->*task)(0, 0, count);
+		}
+		return bands;
+	}
+
+	// Captures stay within std::function's inline storage, so a pass allocates nothing
+	BandJob job = { task, bands, count };
+	m_pool->ParallelFor(bands, [this, &job](int band)
+	{
+		int begin, end;
+		WorkerPool::BandRange(band, job.bands, 0, job.count, begin, end);
+		(this->*job.task)(band, begin, end);
+	});
+
+	return bands;
+}
+
+void PhysicsWorld::Step(float dTime, const PhysicsLevel& level)
+{
+	if (!level.walls)
+	{
+		return;
+	}
+
+	// Last step's positions become the previous ones, and every body's position is
+	// written again by Resolve
+	m_stepTime = dTime;
+	m_stepLevel = &level;
+	m_previousX.swap(m_positionX);
+	m_previousY.swap(m_positionY);
+	m_previousZ.swap(m_positionZ);
+
+	// Only awake bodies are stepped. A sleeper's previous position is its position, so the
+	// swap leaves it where it was
+	UpdateSleepers();
+	ForEachBand((int)m_awake.size(), PHYSICS_BAND_BODIES, &PhysicsWorld::IntegrateBand);
+	CollideBodies(*level.walls);
+	ForEachBand((int)m_awake.size(), PHYSICS_BAND_BODIES, &PhysicsWorld::ResolveBand);
+
+	m_stepLevel = nullptr;
+	m_stepCount++;
+}
+
+// Velocity takes last step's acceleration over the step and any impulses, then the position
+// moves by the new velocity (semi-implicit Euler). The acceleration starts over from
+// gravity. Branch free, one awake body per lane
+void PhysicsWorld::IntegrateBand(int /*band*/, int begin, int end)
+{
+	const int* awake = m_awake.data();
+	float dTime = m_stepTime;
+	float gravity = m_gravity * GRAVITY;
+
+	const float* positionX = m_previousX.data();
+	const float* positionY = m_previousY.data();
+	const float* positionZ = m_previousZ.data();
+	const float* velocityX = m_velocityX.data();
+	const float* velocityY = m_velocityY.data();
+	const float* velocityZ = m_velocityZ.data();
+	float* accelerationX = m_accelerationX.data();
+	float* accelerationY = m_accelerationY.data();
+	float* accelerationZ = m_accelerationZ.data();
+	float* impulseX = m_impulseX.data();
+	float* impulseY = m_impulseY.data();
+	float* impulseZ = m_impulseZ.data();
+	float* nextX = m_nextX.data();
+	float* nextY = m_nextY.data();
+	float* nextZ = m_nextZ.data();
+	float* nextVelocityX = m_nextVelocityX.data();
+	float* nextVelocityY = m_nextVelocityY.data();
+	float* nextVelocityZ = m_nextVelocityZ.data();
+
+	for (int slot = begin; slot < end; slot++)
+	{
+		int i = awake[slot];
+		nextVelocityX[i] = velocityX[i] + (accelerationX[i] * dTime) + impulseX[i];
+		nextVelocityY[i] = velocityY[i] + (accelerationY[i] * dTime) + impulseY[i];
+		nextVelocityZ[i] = velocityZ[i] + (accelerationZ[i] * dTime) + impulseZ[i];
+
+		nextX[i] = positionX[i] + (nextVelocityX[i] * dTime);
+		nextY[i] = positionY[i] + (nextVelocityY[i] * dTime);
+		nextZ[i] = positionZ[i] + (nextVelocityZ[i] * dTime);
+	}
+
+	for (int slot = begin; slot < end; slot++)
+	{
+		int i = awake[slot];
+		accelerationX[i] = 0.0f;
+		accelerationY[i] = -gravity;
+		accelerationZ[i] = 0.0f;
+		impulseX[i] = 0.0f;
+		impulseY[i] = 0.0f;
+		impulseZ[i] = 0.0f;
+	}
+}
+
+void PhysicsWorld::ResolveBand(int /*band*/, int begin, int end)
+{
+	for (int slot = begin; slot < end; slot++)
+	{
+		Resolve(m_awake[slot], *m_stepLevel);
+	}
+}
+
+// Lists the awake bodies and the sleepers. Bodies only fall asleep in Resolve, which
+// leaves more sleepers than the grid holds; every wake marks the grid itself
+void PhysicsWorld::UpdateSleepers()
+{
+	m_awake.clear();
+	m_sleepers.clear();
+
+	for (int body = 0; body < (int)m_sleepState.size(); body++)
+	{
+		if (!m_sleepEnabled && m_sleepState[body] == PHYSICS_ASLEEP)
+		{
+			m_sleepState[body] = PHYSICS_AWAKE;
+			m_restTime[body] = 0.0f;
+			m_sleepersChanged = true;
+		}
+
+		if (m_sleepState[body] == PHYSICS_ASLEEP)
+		{
+			m_sleepers.push_back(body);
+		}
+		else
+		{
+			m_awake.push_back(body);
+		}
+	}
+
+	m_sleepersChanged = m_sleepersChanged || (int)m_sleepers.size() != m_sleepGrid.GetCount();
+}
+
+// Sleepers woken by a contact join the awake list for the rest of the step, in pair order
+void PhysicsWorld::WakeTouched()
+{
+	for (int p = 0; p < 2 * m_candidatePairs; p++)
+	{
+		int body = m_pairs[p];
+		if (m_sleepState[body] == PHYSICS_WOKEN)
+		{
+			m_sleepState[body] = PHYSICS_AWAKE;
+			m_restTime[body] = 0.0f;
+			m_awake.push_back(body);
+			m_sleepersChanged = true;
+		}
+	}
+}
+
+// Share of an overlap removed per step, and overlap left alone so resting bodies do not jitter
+#define PHYSICS_CONTACT_PUSH	0.8f
+#define PHYSICS_CONTACT_SLOP	0.01f
+
+// Contacts act on the integrated positions and velocities, so the walls and the floor
+// still get the last say over where a pushed body ends up. Candidate pairs are found in
+// bands of the broadphase's sorted awake bodies and joined in band order, those between
+// two awake bodies first and then those with a sleeper, then resolved group by group,
+// each group's pairs in that same order. No two groups of a phase share a body, so the
+// result only depends on the pairs, never on the threads. A small island is one group
+// and comes out as if every pair were resolved in order on one thread
+void PhysicsWorld::CollideBodies(const WallGrid& walls)
+{
+	m_candidatePairs = 0;
+	m_contacts = 0;
+	m_pairs.clear();
+
+	if (walls.GetWidth() < 1 || walls.GetHeight() < 1)
+	{
+		return;
+	}
+
+	if (m_bodyGrid.GetWidth() != walls.GetWidth() || m_bodyGrid.GetHeight() != walls.GetHeight())
+	{
+		m_bodyGrid.Initialize(walls.GetWidth(), walls.GetHeight());
+		m_sleepGrid.Initialize(walls.GetWidth(), walls.GetHeight());
+		m_sleepersChanged = true;
+	}
+
+	// Sleepers hold still, so their grid stands until one falls asleep or wakes
+	if (m_sleepersChanged)
+	{
+		m_sleepGrid.Build(m_nextX.data(), m_nextZ.data(), m_radius.data(), (int)m_sleepers.size(), m_sleepers.data());
+		m_sleepersChanged = false;
+	}
+
+	m_bodyGrid.Build(m_nextX.data(), m_nextZ.data(), m_radius.data(), (int)m_awake.size(), m_awake.data());
+
+	// The first band writes straight into m_pairs, the rest are appended after it
+	int bands = ForEachBand(m_bodyGrid.GetCount(), PHYSICS_BAND_BODIES, &PhysicsWorld::FindPairsBand);
+	for (int band = 1; band < bands; band++)
+	{
+		m_pairs.insert(m_pairs.end(), m_bands[band].pairs.begin(), m_bands[band].pairs.end());
+	}
+
+	if (m_sleepGrid.GetCount() > 0)
+	{
+		bands = ForEachBand(m_bodyGrid.GetCount(), PHYSICS_BAND_BODIES, &PhysicsWorld::FindSleeperPairsBand);
+		for (int band = 1; band < bands; band++)
+		{
+			m_pairs.insert(m_pairs.end(), m_bands[band].pairs.begin(), m_bands[band].pairs.end());
+		}
+	}
+	m_candidatePairs = (int)m_pairs.size() / 2;
+
+	BuildIslands();
+
+	// Bands split each phase's pairs evenly, whatever the size of its groups
+	for (m_phase = 0; m_phase < PHYSICS_ISLAND_PHASES; m_phase++)
+	{
+		int pairs = m_islandStart[m_phaseGroups[m_phase + 1]] - m_islandStart[m_phaseGroups[m_phase]];
+		bands = ForEachBand(pairs, PHYSICS_BAND_PAIRS, &PhysicsWorld::ResolveIslandsBand);
+		for (int band = 0; band < bands; band++)
+		{
+			m_contacts += m_bands[band].contacts;
+		}
+	}
+
+	WakeTouched();
+}
+
+void PhysicsWorld::FindPairsBand(int band, int begin, int end)
+{
+	std::vector<int>& pairs = band == 0 ? m_pairs : m_bands[band].pairs;
+	if (band > 0)
+	{
+		pairs.clear();
+	}
+
+	m_bodyGrid.FindPairs(begin, end, m_nextX.data(), m_nextZ.data(), m_radius.data(), pairs, m_bands[band].cursors);
+}
+
+// As FindPairsBand, appending after every pair between awake bodies
+void PhysicsWorld::FindSleeperPairsBand(int band, int begin, int end)
+{
+	std::vector<int>& pairs = band == 0 ? m_pairs : m_bands[band].pairs;
+	if (band > 0)
+	{
+		pairs.clear();
+	}
+
+	m_bodyGrid.FindPairsWith(m_sleepGrid, begin, end, m_nextX.data(), m_nextZ.data(), m_radius.data(), pairs, m_bands[band].cursors);
+}
+
+int PhysicsWorld::FindIsland(int body)
+{
+	int* parent = m_islandParent.data();
+	while (parent[body] != body)
+	{
+		parent[body] = parent[parent[body]];
+		body = parent[body];
+	}
+	return body;
+}
+
+// Slab of a body's integrated position, rows of PHYSICS_SLAB_ROWS cells from the top of the
+// map. Bodies off the map count as in the first or last slab
+int PhysicsWorld::GetSlab(int body) const
+{
+	float z = m_nextZ[body];
+	int last = (m_bodyGrid.GetHeight() / PHYSICS_SLAB_ROWS) + 1;
+	int slab = z > 0.0f ? (int)(z / PHYSICS_SLAB_ROWS) : 0;
+	return slab < last ? slab : last;
+}
+
+// Groups the candidate pairs into islands of bodies linked by pairs, numbered in order of
+// their first pair. An island of up to PHYSICS_ISLAND_PAIRS pairs is one group of the first
+// phase. A bigger one is cut by the slabs of its bodies' positions: pairs within a slab
+// join that slab's group in the first phase, pairs across one boundary that boundary's
+// group in the second (even boundaries) or third (odd), and the rest the one group of the
+// last. Each group lists its pairs in pair order. Returns the group count
+int PhysicsWorld::BuildIslands()
+{
+	int count = (int)m_positionX.size();
+	const int* pairs = m_pairs.data();
+
+	// Per pair arrays keep up with the pair list's room, so they only grow in a step that grew it
+	if (m_pairIsland.capacity() < m_pairs.capacity() / 2)
+	{
+		m_pairIsland.reserve(m_pairs.capacity() / 2);
+		m_islandPairs.reserve(m_pairs.capacity() / 2);
+		m_islandGroup.reserve(m_pairs.capacity() / 2);
+		m_islandStart.reserve((m_pairs.capacity() / 2) + (3 * ((m_bodyGrid.GetHeight() / PHYSICS_SLAB_ROWS) + 2)) + 2);
+	}
+
+	m_islandParent.resize(count);
+	m_islandIndex.resize(count);
+	m_pairIsland.resize(m_candidatePairs);
+	m_islandPairs.resize(m_candidatePairs);
+
+	// Only bodies in a pair take part, so only they are reset
+	for (int p = 0; p < 2 * m_candidatePairs; p++)
+	{
+		m_islandParent[pairs[p]] = pairs[p];
+		m_islandIndex[pairs[p]] = -1;
+	}
+
+	// The lower root always wins, so the islands do not depend on anything but the pairs
+	for (int p = 0; p < m_candidatePairs; p++)
+	{
+		int first = FindIsland(pairs[2 * p]);
+		int second = FindIsland(pairs[(2 * p) + 1]);
+		if (first != second)
+		{
+			m_islandParent[first > second ? first : second] = first < second ? first : second;
+		}
+	}
+
+	// Pairs per island, counted in m_islandGroup for now
+	int islands = 0;
+	m_islandGroup.clear();
+
+	for (int p = 0; p < m_candidatePairs; p++)
+	{
+		int root = FindIsland(pairs[2 * p]);
+		if (m_islandIndex[root] < 0)
+		{
+			m_islandIndex[root] = islands++;
+			m_islandGroup.push_back(0);
+		}
+
+		m_pairIsland[p] = m_islandIndex[root];
+		m_islandGroup[m_pairIsland[p]]++;
+	}
+
+	// Whole islands first, then the slabs, the even and odd boundaries and the spanning pairs
+	int groups = 0;
+	bool split = false;
+	m_largestIsland = 0;
+
+	for (int island = 0; island < islands; island++)
+	{
+		int islandPairs = m_islandGroup[island];
+		m_largestIsland = islandPairs > m_largestIsland ? islandPairs : m_largestIsland;
+		split = split || islandPairs > PHYSICS_ISLAND_PAIRS;
+		m_islandGroup[island] = islandPairs > PHYSICS_ISLAND_PAIRS ? -1 : groups++;
+	}
+
+	int slabs = split ? (m_bodyGrid.GetHeight() / PHYSICS_SLAB_ROWS) + 2 : 0;
+	m_phaseGroups[0] = 0;
+	m_phaseGroups[1] = groups + slabs;
+	m_phaseGroups[2] = m_phaseGroups[1] + slabs;
+	m_phaseGroups[3] = m_phaseGroups[2] + slabs;
+	m_phaseGroups[4] = m_phaseGroups[3] + 1;
+
+	m_islandStart.assign(m_phaseGroups[PHYSICS_ISLAND_PHASES] + 1, 0);
+
+	for (int p = 0; p < m_candidatePairs; p++)
+	{
+		int group = m_islandGroup[m_pairIsland[p]];
+		if (group < 0)
+		{
+			int first = GetSlab(pairs[2 * p]);
+			int second = GetSlab(pairs[(2 * p) + 1]);
+			int top = first < second ? first : second;
+			int apart = first < second ? second - first : first - second;
+			group = apart == 0 ? groups + top : (apart == 1 ? m_phaseGroups[top % 2 == 0 ? 1 : 2] + top : m_phaseGroups[3]);
+		}
+
+		m_pairIsland[p] = group;
+		m_islandStart[group + 1]++;
+	}
+
+	m_largestGroup = 0;
+	for (int group = 0; group < m_phaseGroups[PHYSICS_ISLAND_PHASES]; group++)
+	{
+		m_largestGroup = m_islandStart[group + 1] > m_largestGroup ? m_islandStart[group + 1] : m_largestGroup;
+		m_islandStart[group + 1] += m_islandStart[group];
+	}
+
+	// Scatter through each group's start, then shift the starts back by one group
+	for (int p = 0; p < m_candidatePairs; p++)
+	{
+		m_islandPairs[m_islandStart[m_pairIsland[p]]++] = p;
+	}
+
+	for (int group = m_phaseGroups[PHYSICS_ISLAND_PHASES]; group > 0; group--)
+	{
+		m_islandStart[group] = m_islandStart[group - 1];
+	}
+	m_islandStart[0] = 0;
+
+	return m_phaseGroups[PHYSICS_ISLAND_PHASES];
+}
+
+// Runs over [begin, end) of the current phase's pair slots. Each group goes to the band
+// holding its first slot and is resolved there whole
+void PhysicsWorld::ResolveIslandsBand(int band, int begin, int end)
+{
+	int contacts = 0;
+	const int* starts = m_islandStart.data();
+	int firstGroup = m_phaseGroups[m_phase];
+	int endGroup = m_phaseGroups[m_phase + 1];
+	begin += starts[firstGroup];
+	end += starts[firstGroup];
+
+	for (int group = (int)(std::lower_bound(starts + firstGroup, starts + endGroup, begin) - starts); group < endGroup && starts[group] < end; group++)
+	{
+		for (int slot = starts[group]; slot < starts[group + 1]; slot++)
+		{
+			int p = m_islandPairs[slot];
+			contacts += ResolveContact(m_pairs[2 * p], m_pairs[(2 * p) + 1]);
+		}
+	}
+
+	m_bands[band].contacts = contacts;
+}
+
+// Sphere against sphere. The pair separates along the line between the centres in
+// proportion to inverse mass and, if closing, takes an impulse that leaves them
+// parting at (elasticity) times the closing speed. A sleeper has no inverse mass
+// unless the contact is deep or fast enough to wake it
+bool PhysicsWorld::ResolveContact(int first, int second)
+{
+	float normalX = m_nextX[second] - m_nextX[first];
+	float normalY = m_nextY[second] - m_nextY[first];
+	float normalZ = m_nextZ[second] - m_nextZ[first];
+	float reach = m_radius[first] + m_radius[second];
+	float distanceSquared = (normalX * normalX) + (normalY * normalY) + (normalZ * normalZ);
+
+	if (distanceSquared >= reach * reach)
+	{
+		return false;
+	}
+
+	// Centres on top of each other, part them along x
+	float distance = sqrtf(distanceSquared);
+	if (distance > 0.0f)
+	{
+		normalX /= distance;
+		normalY /= distance;
+		normalZ /= distance;
+	}
+	else
+	{
+		normalX = 1.0f;
+	}
+
+	float closing = ((m_nextVelocityX[second] - m_nextVelocityX[first]) * normalX) + ((m_nextVelocityY[second] - m_nextVelocityY[first]) * normalY)
+		+ ((m_nextVelocityZ[second] - m_nextVelocityZ[first]) * normalZ);
+	bool wakes = reach - distance > PHYSICS_SLEEP_DEPTH || closing < -PHYSICS_SLEEP_SPEED;
+
+	uint8_t* state[2] = { &m_sleepState[first], &m_sleepState[second] };
+	for (int b = 0; b < 2; b++)
+	{
+		if (*state[b] == PHYSICS_ASLEEP && wakes)
+		{
+			*state[b] = PHYSICS_WOKEN;
+		}
+	}
+
+	float inverseFirst = *state[0] == PHYSICS_ASLEEP ? 0.0f : m_inverseMass[first];
+	float inverseSecond = *state[1] == PHYSICS_ASLEEP ? 0.0f : m_inverseMass[second];
+	float inverseTotal = inverseFirst + inverseSecond;
+
+	float overlap = reach - distance - PHYSICS_CONTACT_SLOP;
+	if (overlap > 0.0f)
+	{
+		float push = overlap * PHYSICS_CONTACT_PUSH / inverseTotal;
+		m_nextX[first] -= normalX * push * inverseFirst;
+		m_nextY[first] -= normalY * push * inverseFirst;
+		m_nextZ[first] -= normalZ * push * inverseFirst;
+		m_nextX[second] += normalX * push * inverseSecond;
+		m_nextY[second] += normalY * push * inverseSecond;
+		m_nextZ[second] += normalZ * push * inverseSecond;
+	}
+
+	if (closing >= 0.0f)
+	{
+		return true;
+	}
+
+	float impulse = -(1.0f + m_elastic) * closing / inverseTotal;
+	m_nextVelocityX[first] -= normalX * impulse * inverseFirst;
+	m_nextVelocityY[first] -= normalY * impulse * inverseFirst;
+	m_nextVelocityZ[first] -= normalZ * impulse * inverseFirst;
+	m_nextVelocityX[second] += normalX * impulse * inverseSecond;
+	m_nextVelocityY[second] += normalY * impulse * inverseSecond;
+	m_nextVelocityZ[second] += normalZ * impulse * inverseSecond;
+
+	return true;
+}
+
+static void Normalize(float& x, float& y, float& z)
+{
+	float length = sqrtf((x * x) + (y * y) + (z * z));
+	if (length > 0.0f)
+	{
+		x /= length;
+		y /= length;
+		z /= length;
+	}
+}
+
+// Up to this many wall contacts per body per step, as in WallGrid::Slide
+#define PHYSICS_WALL_CONTACTS 3
+
+// Moves the body to its integrated position, stopping at walls and keeping the movement
+// along them. The first wall bounces the velocity on whichever axis it faces most.
+// No wall friction, its normal force came from horizontal acceleration, which gravity never has
+bool PhysicsWorld::SlideAlongWalls(int body, const PhysicsLevel& level)
+{
+	float x = m_previousX[body], z = m_previousZ[body];
+	float moveX = m_nextX[body] - x;
+	float moveZ = m_nextZ[body] - z;
+	float radius = m_radius[body];
+	const WallDistanceField* field = level.field && level.field->IsBuilt() ? level.field : nullptr;
+	bool bounced = false;
+
+	for (int contact = 0; contact < PHYSICS_WALL_CONTACTS && (moveX != 0.0f || moveZ != 0.0f); contact++)
+	{
+		WallHit hit;
+		bool onWall = field ? field->SweepCircle(x, z, radius, moveX, moveZ, hit) : level.walls->SweepCircle(x, z, radius, moveX, moveZ, hit);
+		if (!onWall)
+		{
+			x += moveX;
+			z += moveZ;
+			break;
+		}
+
+		if (!bounced)
+		{
+			Bounce(body, fabsf(hit.normalX) >= fabsf(hit.normalZ) ? PHYSICS_AXIS_X : PHYSICS_AXIS_Z);
+			bounced = true;
+		}
+
+		x += (moveX * hit.time) + (hit.normalX * WALL_SKIN);
+		z += (moveZ * hit.time) + (hit.normalZ * WALL_SKIN);
+
+		// Keep what is left of the move along the wall
+		float restX = moveX * (1.0f - hit.time);
+		float restZ = moveZ * (1.0f - hit.time);
+		float into = (restX * hit.normalX) + (restZ * hit.normalZ);
+		moveX = restX - (hit.normalX * into);
+		moveZ = restZ - (hit.normalZ * into);
+	}
+
+	m_nextX[body] = x;
+	m_nextZ[body] = z;
+	return bounced;
+}
+
+// Walls, then the floor or air resistance while off it. Friction always opposes the
+// velocity the body had at the start of the step
+void PhysicsWorld::Resolve(int body, const PhysicsLevel& level)
+{
+	SlideAlongWalls(body, level);
+
+	if (m_nextY[body] - m_radius[body] <= m_floorHeight)
+	{
+		// No friction in the perpendicular axis
+		float directionX = -m_velocityX[body], directionY = 0.0f, directionZ = -m_velocityZ[body];
+		Normalize(directionX, directionY, directionZ);
+
+		float normalForce = m_gravity * GRAVITY / m_inverseMass[body];
+		ApplyFriction(body, directionX, directionY, directionZ, m_friction * FLOOR_FRICTION * normalForce);
+
+		// Stay at last step's height, or rest on the floor if that was already below it
+		Bounce(body, PHYSICS_AXIS_Y);
+		m_nextY[body] = m_previousY[body] - m_radius[body] > m_floorHeight ? m_previousY[body] : m_floorHeight + m_radius[body];
+	}
+	else
+	{
+		float directionX = -m_velocityX[body], directionY = -m_velocityY[body], directionZ = -m_velocityZ[body];
+		Normalize(directionX, directionY, directionZ);
+
+		ApplyFriction(body, directionX, directionY, directionZ, m_friction * AIR_FRICTION);
+	}
+
+	m_positionX[body] = m_nextX[body];
+	m_positionY[body] = m_nextY[body];
+	m_positionZ[body] = m_nextZ[body];
+	m_velocityX[body] = m_nextVelocityX[body];
+	m_velocityY[body] = m_nextVelocityY[body];
+	m_velocityZ[body] = m_nextVelocityZ[body];
+
+	UpdateRest(body);
+}
+
+// Resting long enough puts the body to sleep where it is, still, and with only gravity to
+// take up when it wakes
+void PhysicsWorld::UpdateRest(int body)
+{
+	float speedSquared = (m_velocityX[body] * m_velocityX[body]) + (m_velocityY[body] * m_velocityY[body]) + (m_velocityZ[body] * m_velocityZ[body]);
+	m_restTime[body] = speedSquared < PHYSICS_SLEEP_SPEED * PHYSICS_SLEEP_SPEED ? m_restTime[body] + m_stepTime : 0.0f;
+
+	if (!m_sleepEnabled || m_restTime[body] < PHYSICS_SLEEP_TIME)
+	{
+		return;
+	}
+
+	m_sleepState[body] = PHYSICS_ASLEEP;
+	m_previousX[body] = m_nextX[body] = m_positionX[body];
+	m_previousY[body] = m_nextY[body] = m_positionY[body];
+	m_previousZ[body] = m_nextZ[body] = m_positionZ[body];
+	m_velocityX[body] = m_nextVelocityX[body] = 0.0f;
+	m_velocityY[body] = m_nextVelocityY[body] = 0.0f;
+	m_velocityZ[body] = m_nextVelocityZ[body] = 0.0f;
+	m_accelerationX[body] = 0.0f;
+	m_accelerationY[body] = -m_gravity * GRAVITY;
+	m_accelerationZ[body] = 0.0f;
+}
+
+void PhysicsWorld::Bounce(int body, PhysicsAxis axis)
+{
+	std::vector<float>& velocity = axis == PHYSICS_AXIS_X ? m_nextVelocityX : (axis == PHYSICS_AXIS_Y ? m_nextVelocityY : m_nextVelocityZ);
+	velocity[body] *= -m_elastic;
+}
+
+// Friction may stop an axis over the next step but never reverse it
+void PhysicsWorld::ApplyFriction(int body, float directionX, float directionY, float directionZ, float force)
+{
+	float change = force * m_inverseMass[body];
+	float* velocity[3] = { &m_nextVelocityX[body], &m_nextVelocityY[body], &m_nextVelocityZ[body] };
+	float* acceleration[3] = { &m_accelerationX[body], &m_accelerationY[body], &m_accelerationZ[body] };
+	float result[3] = { directionX * change, directionY * change, directionZ * change };
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if ((*velocity[axis] + (result[axis] * m_stepTime)) * *velocity[axis] < 0.0f)
+		{
+			result[axis] = 0.0f;
+			*velocity[axis] = 0.0f;
+		}
+		*acceleration[axis] += result[axis];
+	}
+}
+
+void PhysicsWorld::ApplyForce(int body, float directionX, float directionY, float directionZ, float force)
+{
+	float change = force * m_inverseMass[body];
+
+	if (m_sleepState[body] == PHYSICS_ASLEEP)
+	{
+		m_sleepState[body] = PHYSICS_AWAKE;
+		m_sleepersChanged = true;
+	}
+	m_restTime[body] = 0.0f;
+
+	m_impulseX[body] += directionX * change;
+	m_impulseY[body] += directionY * change;
+	m_impulseZ[body] += directionZ * change;
+}
+
+int PhysicsWorld::ApplyForceInRange(float x, float z, float range, float directionX, float directionY, float directionZ, float force)
+{
+	int pushed = 0;
+
+	for (int body = 0; body < (int)m_positionX.size(); body++)
+	{
+		float dx = m_positionX[body] - x;
+		float dz = m_positionZ[body] - z;
+
+		if ((dx * dx) + (dz * dz) <= range * range)
+		{
+			ApplyForce(body, directionX, directionY, directionZ, force);
+			pushed++;
+		}
+	}
+
+	return pushed;
+}
+
+int PhysicsWorld::FindBodyNear(float x, float z, float reach) const
+{
+	for (int body = 0; body < (int)m_positionX.size(); body++)
+	{
+		float extent = m_radius[body] * reach;
+
+		if (fabsf(m_positionX[body] - x) <= extent && fabsf(m_positionZ[body] - z) <= extent)
+		{
+			return body;
+		}
+	}
+
+	return -1;
+}
+
+int PhysicsWorld::GetStepCount() const
+{
+	return m_stepCount;
+}
+
+float PhysicsWorld::GetInterpolation() const
+{
+	return m_accumulator / PHYSICS_FIXED_STEP;
+}
+
+void PhysicsWorld::GetRenderPosition(int body, float* position) const
+{
+	float t = GetInterpolation();
+
+	position[0] = m_previousX[body] + ((m_positionX[body] - m_previousX[body]) * t);
+	position[1] = m_previousY[body] + ((m_positionY[body] - m_previousY[body]) * t);
+	position[2] = m_previousZ[body] + ((m_positionZ[body] - m_previousZ[body]) * t);
+}
+
+int PhysicsWorld::GetAwakeCount() const
+{
+	return GetBodyCount() - GetSleepingCount();
+}
+
+int PhysicsWorld::GetSleepingCount() const
+{
+	int sleeping = 0;
+	for (int body = 0; body < (int)m_sleepState.size(); body++)
+	{
+		sleeping += m_sleepState[body] == PHYSICS_ASLEEP;
+	}
+	return sleeping;
+}
+
+bool PhysicsWorld::IsSleeping(int body) const
+{
+	return m_sleepState[body] == PHYSICS_ASLEEP;
+}
+
+void PhysicsWorld::WakeAll()
+{
+	for (int body = 0; body < (int)m_sleepState.size(); body++)
+	{
+		if (m_sleepState[body] == PHYSICS_ASLEEP)
+		{
+			m_sleepState[body] = PHYSICS_AWAKE;
+			m_restTime[body] = 0.0f;
+			m_sleepersChanged = true;
+		}
+	}
+}
+
+int PhysicsWorld::GetCandidatePairs() const
+{
+	return m_candidatePairs;
+}
+
+int PhysicsWorld::GetContacts() const
+{
+	return m_contacts;
+}
+
+int PhysicsWorld::GetLargestIsland() const
+{
+	return m_largestIsland;
+}
+
+int PhysicsWorld::GetLargestGroup() const
+{
+	return m_largestGroup;
+}
+
+float* PhysicsWorld::GetGravity()
+{
+	return &m_gravity;
+}
+
+float* PhysicsWorld::GetFriction()
+{
+	return &m_friction;
+}
+
+float* PhysicsWorld::GetElasticity()
+{
+	return &m_elastic;
+}
+
+bool* PhysicsWorld::GetSleeping()
+{
+	return &m_sleepEnabled;
+}
+
+void PhysicsWorld::SetFloorHeight(float height)
+{
+	m_floorHeight = height;
+}
+
+void PhysicsWorld::GetParameters(PhysicsParameters& parameters) const
+{
+	parameters.gravity = m_gravity;
+	parameters.friction = m_friction;
+	parameters.elasticity = m_elastic;
+	parameters.floorHeight = m_floorHeight;
+	parameters.sleeping = m_sleepEnabled;
+}
+
+void PhysicsWorld::SetParameters(const PhysicsParameters& parameters)
+{
+	m_gravity = parameters.gravity;
+	m_friction = parameters.friction;
+	m_elastic = parameters.elasticity;
+	m_floorHeight = parameters.floorHeight;
+	m_sleepEnabled = parameters.sleeping;
+}
+
+int PhysicsWorld::GetBodyCount() const
+{
+	return (int)m_positionX.size();
+}
+
+PhysicsShape PhysicsWorld::GetShape(int body) const
+{
+	return (PhysicsShape)m_shape[body];
+}
+
+float PhysicsWorld::GetRadius(int body) const
+{
+	return m_radius[body];
+}
+
+void PhysicsWorld::GetPosition(int body, float* position) const
+{
+	position[0] = m_positionX[body];
+	position[1] = m_positionY[body];
+	position[2] = m_positionZ[body];
+}
+
+void PhysicsWorld::GetVelocity(int body, float* velocity) const
+{
+	velocity[0] = m_velocityX[body];
+	velocity[1] = m_velocityY[body];
+	velocity[2] = m_velocityZ[body];
+}
+
+void PhysicsWorld::GetRotation(int body, float* rotation) const
+{
+	rotation[0] = m_rotationX[body];
+	rotation[1] = m_rotationY[body];
+	rotation[2] = m_rotationZ[body];
+	rotation[3] = m_rotationW[body];
+}
+
+void PhysicsWorld::SetRotation(int body, const float* rotation)
+{
+	m_rotationX[body] = rotation[0];
+	m_rotationY[body] = rotation[1];
+	m_rotationZ[body] = rotation[2];
+	m_rotationW[body] = rotation[3];
+}
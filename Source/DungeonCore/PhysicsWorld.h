@@ -0,0 +1,259 @@
+#pragma once
+
+// Balls and boxes bouncing around a dungeon, stored as structure of arrays: every
+// property is its own contiguous array indexed by body. The step first integrates
+// all bodies in plain loops over those arrays, which compilers vectorize, and then
+// resolves the floor and walls body by body. Between the two, bodies that meet are
+// pushed apart and bounced off each other as spheres: a BodyGrid over the map's cells
+// finds the candidate pairs and each overlapping pair gets an impulse along the line
+// between the centres, island by island, the biggest islands cut into row slabs. Boxes collide as their bounding sphere, with the floor as their
+// half size, and do not rotate. Advance turns frame times into fixed steps, so where
+// the bodies end up depends on the inputs and the steps they land on, never on the
+// frame rate; PhysicsInputLog records those inputs for a headless replay.
+//
+// A body that has moved slower than PHYSICS_SLEEP_SPEED for PHYSICS_SLEEP_TIME falls
+// asleep: it is left out of integration, the floor and walls, and of the broadphase but
+// for a second grid of sleepers that awake bodies are checked against. A sleeper hit
+// hard enough, or given a force, wakes up; until then it holds still like a wall.
+
+#include <stdint.h>
+#include <vector>
+
+#include "BodyGrid.h"
+#include "WallDistanceField.h"
+#include "WallGrid.h"
+#include "WorkerPool.h"
+
+// Define global parameters for physics engine
+#define AIR_FRICTION	 0.02f
+#define FLOOR_FRICTION	 0.5f
+#define GRAVITY			 9.8f
+#define KICK_RANGE		 5.0f
+
+// Advance runs whole steps of this length, at most this many per call
+#define PHYSICS_STEP_RATE		120
+#define PHYSICS_FIXED_STEP		(1.0f / PHYSICS_STEP_RATE)
+#define PHYSICS_MAX_SUBSTEPS	8
+
+// Per-body float arrays, see GetFloatArrays
+#define PHYSICS_FLOAT_ARRAYS 28
+
+// Speed below which a body counts as resting, how long it must rest to fall asleep, and
+// how far a contact must push into a sleeper to wake it
+#define PHYSICS_SLEEP_SPEED	0.1f
+#define PHYSICS_SLEEP_TIME	0.5f
+#define PHYSICS_SLEEP_DEPTH	0.05f
+
+// Islands with more pairs than this are resolved in slabs of this many map rows, in
+// phases whose groups share no body: within slabs, across even and then odd slab
+// boundaries, and last any pair spanning more than one boundary
+#define PHYSICS_ISLAND_PAIRS	1024
+#define PHYSICS_SLAB_ROWS		8
+#define PHYSICS_ISLAND_PHASES	4
+
+enum PhysicsAxis
+{
+	PHYSICS_AXIS_X = 0,
+	PHYSICS_AXIS_Y,
+	PHYSICS_AXIS_Z
+};
+
+// Read-only view of a level's collision data, owned by the level and valid while it
+// lives. The field is used while it is baked and may be null
+struct PhysicsLevel
+{
+	const WallGrid*				walls;
+	const WallDistanceField*	field;
+};
+
+// Everything about a world a player can change besides its bodies, see PhysicsInputLog
+struct PhysicsParameters
+{
+	float	gravity;		// Times GRAVITY
+	float	friction;
+	float	elasticity;
+	float	floorHeight;
+	bool	sleeping;
+};
+
+enum PhysicsSleepState
+{
+	PHYSICS_ASLEEP = 0,
+	PHYSICS_AWAKE,
+	PHYSICS_WOKEN	// Woken by a contact in this step, not yet in the awake list
+};
+
+enum PhysicsShape
+{
+	PHYSICS_BALL = 0,
+	PHYSICS_BOX
+};
+
+class PhysicsWorld
+{
+public:
+	PhysicsWorld();
+
+	// Bodies keep their index until Clear, which is their handle everywhere else. Once
+	// Reserve has room for them and the first step has sized the broadphase to the map,
+	// steps allocate nothing
+	int		SpawnBall(float x, float y, float z, float mass, float radius);
+	int		SpawnBox(float x, float y, float z, float mass, float halfSize);
+	void	Reserve(int bodies);
+	void	Clear();
+
+	// Steps split their passes over (pool), not owned, null runs them on the calling
+	// thread. The result is the same for any number of threads
+	void	SetWorkerPool(WorkerPool* pool);
+
+	// Frame time in, fixed steps out. Returns how many steps ran, and the time left
+	// over sets the interpolation of the render positions
+	int		Advance(float dTime, const PhysicsLevel& level);
+
+	// One step of (dTime), nothing without walls. Walls come from the distance field when it is baked, otherwise from the grid
+	void	Step(float dTime, const PhysicsLevel& level);
+
+	// Steps taken since the last Clear, inputs recorded against it replay exactly
+	int		GetStepCount() const;
+
+	// Changes the body's velocity by force / mass at the next step, a kick rather than a push held over time.
+	// Wakes the body
+	void	ApplyForce(int body, float directionX, float directionY, float directionZ, float force);
+
+	// Every body within (range) of the point on the ground plane gets the force, returns how many
+	int		ApplyForceInRange(float x, float z, float range, float directionX, float directionY, float directionZ, float force);
+
+	// Bodies stepped and bodies asleep, as of the last step and any wakes since
+	int		GetAwakeCount() const;
+	int		GetSleepingCount() const;
+	bool	IsSleeping(int body) const;
+	void	WakeAll();
+
+	// Candidate pairs from the broadphase and pairs that were touching, during the last step
+	int		GetCandidatePairs() const;
+	int		GetContacts() const;
+
+	// Pairs in the largest island of linked bodies during the last step, and in the largest
+	// group resolved on one thread once islands over PHYSICS_ISLAND_PAIRS were split
+	int		GetLargestIsland() const;
+	int		GetLargestGroup() const;
+
+	// First body whose box of (reach) times its radius holds (x, z), -1 if none
+	int		FindBodyNear(float x, float z, float reach) const;
+
+	// Parameters, edited in place by headless tools. A recorded session changes them
+	// through PhysicsInputLog so that its replay does too
+	float*	GetGravity();
+	float*	GetFriction();
+	float*	GetElasticity();
+	bool*	GetSleeping();	// Off wakes every body at the next step
+	void	SetFloorHeight(float height);
+	void	GetParameters(PhysicsParameters& parameters) const;
+	void	SetParameters(const PhysicsParameters& parameters);
+
+	int				GetBodyCount() const;
+	PhysicsShape	GetShape(int body) const;
+	float			GetRadius(int body) const;
+	void			GetPosition(int body, float* position) const;
+	void			GetVelocity(int body, float* velocity) const;
+
+	// Between the last two steps' positions by the fraction of a step Advance has left over
+	float			GetInterpolation() const;
+	void			GetRenderPosition(int body, float* position) const;
+
+	// Quaternion (x, y, z, w), kept for rendering
+	void			GetRotation(int body, float* rotation) const;
+	void			SetRotation(int body, const float* rotation);
+
+private:
+	// Runs over [begin, end) of a pass split by ForEachBand
+	typedef void (PhysicsWorld::*BandTask)(int band, int begin, int end);
+
+	struct BandJob
+	{
+		BandTask	task;
+		int			bands;
+		int			count;
+	};
+
+	// Scratch of one band, kept between steps
+	struct PhysicsBand
+	{
+		std::vector<int>	pairs;
+		std::vector<int>	cursors;
+		int					contacts;
+	};
+
+	int		ForEachBand(int count, int minCount, BandTask task);
+	void	IntegrateBand(int band, int begin, int end);
+	void	FindPairsBand(int band, int begin, int end);
+	void	FindSleeperPairsBand(int band, int begin, int end);
+	void	ResolveIslandsBand(int band, int begin, int end);
+	void	ResolveBand(int band, int begin, int end);
+	int		BuildIslands();
+	int		FindIsland(int body);
+	int		GetSlab(int body) const;
+
+	void	UpdateSleepers();
+	void	WakeTouched();
+	int		AddBody(PhysicsShape shape, float x, float y, float z, float mass, float radius);
+	void	GetFloatArrays(std::vector<float>* arrays[PHYSICS_FLOAT_ARRAYS]);
+	void	CollideBodies(const WallGrid& walls);
+	bool	ResolveContact(int first, int second);
+	bool	SlideAlongWalls(int body, const PhysicsLevel& level);
+	void	Resolve(int body, const PhysicsLevel& level);
+	void	Bounce(int body, PhysicsAxis axis);
+	void	ApplyFriction(int body, float directionX, float directionY, float directionZ, float force);
+	void	UpdateRest(int body);
+
+private:
+	float		m_gravity;
+	float		m_friction;
+	float		m_elastic;
+	float		m_floorHeight;
+	bool		m_sleepEnabled;
+	float		m_accumulator;	// Frame time not yet stepped
+	float		m_stepTime;		// Length of the step being taken
+	int			m_stepCount;
+	const PhysicsLevel*	m_stepLevel;	// Level of the step being taken
+	WorkerPool*	m_pool;
+
+	std::vector<float>		m_positionX, m_positionY, m_positionZ;
+	std::vector<float>		m_previousX, m_previousY, m_previousZ;	// Before the last step, for interpolation
+	std::vector<float>		m_velocityX, m_velocityY, m_velocityZ;
+	std::vector<float>		m_accelerationX, m_accelerationY, m_accelerationZ;	// Per second, applied over the next step
+	std::vector<float>		m_impulseX, m_impulseY, m_impulseZ;	// Velocity changes applied at the next step
+	std::vector<float>		m_radius;
+	std::vector<float>		m_inverseMass;
+	std::vector<uint8_t>	m_shape;
+	std::vector<float>		m_rotationX, m_rotationY, m_rotationZ, m_rotationW;
+	std::vector<float>		m_restTime;		// Time spent under the sleep speed
+	std::vector<uint8_t>	m_sleepState;	// PhysicsSleepState
+
+	// Awake bodies in index order, then any woken by a contact this step. The passes run over this list
+	std::vector<int>		m_awake;
+	std::vector<int>		m_sleepers;
+	bool					m_sleepersChanged;	// m_sleepGrid no longer matches the sleepers
+
+	// Integrated position and velocity, before the floor and walls have a say
+	std::vector<float>		m_nextX, m_nextY, m_nextZ;
+	std::vector<float>		m_nextVelocityX, m_nextVelocityY, m_nextVelocityZ;
+
+	BodyGrid				m_bodyGrid;		// Awake bodies
+	BodyGrid				m_sleepGrid;	// Sleeping bodies, only rebuilt when they change
+	std::vector<int>		m_pairs;	// Candidate pairs as (first, second) indices
+	int						m_candidatePairs;
+	int						m_contacts;
+	std::vector<PhysicsBand>	m_bands;
+
+	// Islands of bodies linked by candidate pairs, and the groups they are resolved in, see BuildIslands
+	std::vector<int>		m_islandParent, m_islandIndex;	// Per body
+	std::vector<int>		m_islandGroup;	// First group of each island, -1 for one split into slabs
+	std::vector<int>		m_pairIsland;	// Island, then group, of each pair
+	std::vector<int>		m_islandStart;	// First slot of each group in m_islandPairs, one past the end last
+	std::vector<int>		m_islandPairs;	// Pair indices grouped by group
+	int						m_phaseGroups[PHYSICS_ISLAND_PHASES + 1];	// First group of each phase
+	int						m_phase;		// Phase being resolved
+	int						m_largestIsland;
+	int						m_largestGroup;
+};
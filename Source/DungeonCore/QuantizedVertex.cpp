@@ -0,0 +1,189 @@
+#include "QuantizedVertex.h"
+#include "NormalEncoding.h"
+
+#include <math.h>
+#include <string.h>
+
+
+void MakeTerrainQuantization(VertexQuantization& quantization)
+{
+	quantization.origin[0] = 0.0f;
+	quantization.origin[1] = TERRAIN_QUANTIZED_MIN_Y;
+	quantization.origin[2] = 0.0f;
+	quantization.step[0] = 1.0f;
+	quantization.step[1] = TERRAIN_QUANTIZED_Y_STEP;
+	quantization.step[2] = 1.0f;
+}
+
+void MakeBoundsQuantization(const float* min, const float* max, VertexQuantization& quantization)
+{
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float extent = max[axis] - min[axis];
+
+		quantization.origin[axis] = min[axis];
+		quantization.step[axis] = extent > 0.0f ? extent / 65535.0f : 1.0f;
+	}
+}
+
+void GetUnormDequantization(const VertexQuantization& quantization, float* origin, float* scale)
+{
+	for (int axis = 0; axis < 3; axis++)
+	{
+		origin[axis] = quantization.origin[axis];
+		scale[axis] = quantization.step[axis] * 65535.0f;
+	}
+}
+
+// Round to nearest even, subnormals kept, overflow goes to infinity
+uint16_t FloatToHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	uint32_t sign = (bits >> 16) & 0x8000;
+	uint32_t exponent = (bits >> 23) & 0xFF;
+	uint32_t mantissa = bits & 0x7FFFFF;
+
+	if (exponent == 0xFF)
+	{
+		return (uint16_t)(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+	}
+
+	int halfExponent = (int)exponent - 127 + 15;
+	if (halfExponent >= 31)
+	{
+		return (uint16_t)(sign | 0x7C00);
+	}
+
+	if (halfExponent <= 0)
+	{
+		if (halfExponent < -10)
+		{
+			return (uint16_t)sign;
+		}
+
+		mantissa |= 0x800000;
+		int shift = 14 - halfExponent;
+		uint32_t half = mantissa >> shift;
+		uint32_t rest = mantissa & ((1u << shift) - 1);
+		uint32_t halfway = 1u << (shift - 1);
+
+		if (rest > halfway || (rest == halfway && (half & 1)))
+		{
+			half++;
+		}
+		return (uint16_t)(sign | half);
+	}
+
+	// A carry out of the mantissa correctly bumps the exponent
+	uint32_t half = ((uint32_t)halfExponent << 10) | (mantissa >> 13);
+	uint32_t rest = mantissa & 0x1FFF;
+
+	if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+	{
+		half++;
+	}
+	return (uint16_t)(sign | half);
+}
+
+float HalfToFloat(uint16_t half)
+{
+	uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+	uint32_t exponent = (half >> 10) & 0x1F;
+	uint32_t mantissa = half & 0x3FF;
+	uint32_t bits;
+
+	if (exponent == 0)
+	{
+		float value = (float)mantissa * (1.0f / 16777216.0f);
+		return sign ? -value : value;
+	}
+
+	if (exponent == 31)
+	{
+		bits = sign | 0x7F800000 | (mantissa << 13);
+	}
+	else
+	{
+		bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	}
+
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+static uint16_t QuantizeCoordinate(float value, float origin, float step)
+{
+	float q = (value - origin) / step;
+	q = q < 0.0f ? 0.0f : (q > 65535.0f ? 65535.0f : q);
+	return (uint16_t)lrintf(q);
+}
+
+void QuantizeVertex(const TerrainVertex& vertex, const VertexQuantization& quantization, QuantizedVertex& quantized)
+{
+	for (int axis = 0; axis < 3; axis++)
+	{
+		quantized.position[axis] = QuantizeCoordinate(vertex.position[axis], quantization.origin[axis], quantization.step[axis]);
+	}
+	quantized.position[3] = 0;
+
+	quantized.texture[0] = FloatToHalf(vertex.texture[0]);
+	quantized.texture[1] = FloatToHalf(vertex.texture[1]);
+
+	EncodeOctahedral(vertex.normal, quantized.normal);
+}
+
+void DequantizeVertex(const QuantizedVertex& quantized, const VertexQuantization& quantization, TerrainVertex& vertex)
+{
+	for (int axis = 0; axis < 3; axis++)
+	{
+		vertex.position[axis] = quantization.origin[axis] + ((float)quantized.position[axis] * quantization.step[axis]);
+	}
+
+	vertex.texture[0] = HalfToFloat(quantized.texture[0]);
+	vertex.texture[1] = HalfToFloat(quantized.texture[1]);
+
+	DecodeOctahedral(quantized.normal, vertex.normal);
+}
+
+void QuantizeVertices(const TerrainVertex* vertices, size_t count, const VertexQuantization& quantization, QuantizedVertex* quantized)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		QuantizeVertex(vertices[i], quantization, quantized[i]);
+	}
+}
+
+void MeasureQuantizationError(const TerrainVertex* vertices, size_t count, const VertexQuantization& quantization, QuantizationError& error)
+{
+	error.position = 0.0f;
+	error.texture = 0.0f;
+	error.normalDegrees = 0.0f;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		QuantizedVertex quantized;
+		TerrainVertex decoded;
+
+		QuantizeVertex(vertices[i], quantization, quantized);
+		DequantizeVertex(quantized, quantization, decoded);
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			error.position = fmaxf(error.position, fabsf(decoded.position[axis] - vertices[i].position[axis]));
+		}
+		error.texture = fmaxf(error.texture, fabsf(decoded.texture[0] - vertices[i].texture[0]));
+		error.texture = fmaxf(error.texture, fabsf(decoded.texture[1] - vertices[i].texture[1]));
+
+		// atan2 of the cross and dot products stays accurate for tiny angles, acos does not
+		const float* a = vertices[i].normal;
+		const float* b = decoded.normal;
+		float cross[3] = { (a[1] * b[2]) - (a[2] * b[1]), (a[2] * b[0]) - (a[0] * b[2]), (a[0] * b[1]) - (a[1] * b[0]) };
+		float sine = sqrtf((cross[0] * cross[0]) + (cross[1] * cross[1]) + (cross[2] * cross[2]));
+		float cosine = (a[0] * b[0]) + (a[1] * b[1]) + (a[2] * b[2]);
+
+		error.normalDegrees = fmaxf(error.normalDegrees, atan2f(sine, cosine) * (180.0f / 3.14159265f));
+	}
+}
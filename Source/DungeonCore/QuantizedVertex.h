@@ -0,0 +1,65 @@
+#pragma once
+
+// Compact 16-byte vertex, half the size of TerrainVertex / ModelClass::VertexType.
+// Positions are 16-bit offsets on a per-mesh grid, normals are octahedral snorm16
+// and texture coordinates are half floats. The shader reads positions as UNORM and
+// scales them back with one multiply-add per vertex.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "TerrainMesh.h"
+
+enum TerrainVertexFormat
+{
+	TERRAIN_VERTEX_FLOAT = 0,		// TerrainVertex, 32 bytes
+	TERRAIN_VERTEX_QUANTIZED		// QuantizedVertex, 16 bytes
+};
+
+// Matches Shader's quantized input layout (R16G16B16A16_UNORM, R16G16_FLOAT, R16G16_SNORM)
+struct QuantizedVertex
+{
+	uint16_t	position[4];	// w is padding
+	uint16_t	texture[2];
+	int16_t		normal[2];
+};
+
+// position = origin + q * step for each axis, q in [0, 65535]
+struct VertexQuantization
+{
+	float	origin[3];
+	float	step[3];
+};
+
+// Terrain heights are stored with 1/256 precision in [-128, 128), x and z are the
+// grid coordinates themselves so maps up to 65536 cells wide stay exact
+#define TERRAIN_QUANTIZED_MIN_Y -128.0f
+#define TERRAIN_QUANTIZED_Y_STEP (1.0f / 256.0f)
+
+void MakeTerrainQuantization(VertexQuantization& quantization);
+
+// Smallest grid covering [min, max] on every axis, for models
+void MakeBoundsQuantization(const float* min, const float* max, VertexQuantization& quantization);
+
+// position = origin + unorm * scale for UNORM inputs (q / 65535), what the quantized vertex shader applies
+void GetUnormDequantization(const VertexQuantization& quantization, float* origin, float* scale);
+
+uint16_t	FloatToHalf(float value);
+float		HalfToFloat(uint16_t half);
+
+// Out-of-range positions are clamped to the grid
+void QuantizeVertex(const TerrainVertex& vertex, const VertexQuantization& quantization, QuantizedVertex& quantized);
+void DequantizeVertex(const QuantizedVertex& quantized, const VertexQuantization& quantization, TerrainVertex& vertex);
+
+void QuantizeVertices(const TerrainVertex* vertices, size_t count, const VertexQuantization& quantization, QuantizedVertex* quantized);
+
+// Worst round-trip error over a set of vertices
+struct QuantizationError
+{
+	float	position;		// Largest absolute error on any axis
+	float	texture;		// Largest absolute error on either coordinate
+	float	normalDegrees;	// Largest angle between the original and decoded normal
+};
+
+void MeasureQuantizationError(const TerrainVertex* vertices, size_t count, const VertexQuantization& quantization, QuantizationError& error);
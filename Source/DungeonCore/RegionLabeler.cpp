@@ -0,0 +1,448 @@
+#include "RegionLabeler.h"
+#include "DungeonMesher.h"
+
+#include <algorithm>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+
+// m_from values: the direction index of the step into the cell, or one of these
+#define FROM_SOURCE 4
+#define FROM_NONE 0xFF
+#define FROM_NEW 0x80		// Reached during the current search round
+
+// m_owner value of the map border
+#define OWNER_BORDER -2
+
+RegionLabeler::RegionLabeler()
+{
+	m_width = 0;
+	m_height = 0;
+	m_floorCells = 0;
+}
+
+static int CountTrailingZeros(uint64_t word)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward64(&index, word);
+	return (int)index;
+#else
+	return __builtin_ctzll(word);
+#endif
+}
+
+// First position at or after (i) whose bit equals (set), or words * 64
+static int FindBit(const uint64_t* bits, int words, int i, bool set)
+{
+	int w = i >> 6;
+	uint64_t flip = set ? 0 : ~(uint64_t)0;
+	uint64_t word = (bits[w] ^ flip) & (~(uint64_t)0 << (i & 63));
+
+	while (!word)
+	{
+		if (++w == words)
+		{
+			return words * 64;
+		}
+		word = bits[w] ^ flip;
+	}
+
+	return (w * 64) + CountTrailingZeros(word);
+}
+
+// Path halving, the root of a set is always its smallest member
+int RegionLabeler::Find(int item)
+{
+	while (m_parent[item] != item)
+	{
+		m_parent[item] = m_parent[m_parent[item]];
+		item = m_parent[item];
+	}
+	return item;
+}
+
+int RegionLabeler::Label(const float* heights, int width, int height)
+{
+	m_width = width;
+	m_height = height;
+	m_floorCells = 0;
+	m_runs.clear();
+	m_runFloor.clear();
+	m_parent.clear();
+	m_regions.clear();
+	m_rowRuns.resize(height + 1);
+
+	// Floor cells of a row packed into bits, so runs are found a word at a time
+	int words = (width + 63) / 64;
+	m_rowBits.resize(words);
+
+	for (int j = 0; j < height; j++)
+	{
+		const float* row = &heights[width * j];
+		int first = (int)m_runs.size();
+		m_rowRuns[j] = first;
+
+		for (int w = 0; w < words; w++)
+		{
+			uint64_t word = 0;
+			int count = width - (w * 64) < 64 ? width - (w * 64) : 64;
+
+			for (int b = 0; b < count; b++)
+			{
+				word |= (uint64_t)!IsDungeonWall(row[(w * 64) + b]) << b;
+			}
+			m_rowBits[w] = word;
+		}
+
+		int i = FindBit(m_rowBits.data(), words, 0, true);
+		while (i < width)
+		{
+			Run run;
+			run.begin = i;
+			run.end = FindBit(m_rowBits.data(), words, i, false);
+			run.end = run.end < width ? run.end : width;
+			run.region = -1;
+
+			m_parent.push_back((int)m_runs.size());
+			m_runs.push_back(run);
+
+			i = run.end < width ? FindBit(m_rowBits.data(), words, run.end, true) : width;
+		}
+
+		if (j == 0)
+		{
+			continue;
+		}
+
+		// Both rows are sorted, so overlapping pairs are found in one merge-like walk
+		int a = m_rowRuns[j - 1];
+		int b = first;
+		while (a < first && b < (int)m_runs.size())
+		{
+			if (m_runs[a].begin < m_runs[b].end && m_runs[b].begin < m_runs[a].end)
+			{
+				int rootA = Find(a);
+				int rootB = Find(b);
+
+				if (rootA < rootB)
+				{
+					m_parent[rootB] = rootA;
+				}
+				else if (rootB < rootA)
+				{
+					m_parent[rootA] = rootB;
+				}
+			}
+
+			if (m_runs[a].end < m_runs[b].end)
+			{
+				a++;
+			}
+			else
+			{
+				b++;
+			}
+		}
+	}
+	m_rowRuns[height] = (int)m_runs.size();
+
+	// Roots come before their members, so regions are numbered in scan order
+	for (int j = 0; j < height; j++)
+	{
+		for (int r = m_rowRuns[j]; r < m_rowRuns[j + 1]; r++)
+		{
+			Run& run = m_runs[r];
+			int root = Find(r);
+			m_runFloor.push_back(m_floorCells);
+
+			if (root == r)
+			{
+				DungeonRegion region;
+				region.cells = 0;
+				region.x0 = run.begin;
+				region.z0 = j;
+				region.x1 = run.end - 1;
+				region.z1 = j;
+				region.firstCell = (width * j) + run.begin;
+
+				run.region = (int)m_regions.size();
+				m_regions.push_back(region);
+			}
+			else
+			{
+				run.region = m_runs[root].region;
+			}
+
+			DungeonRegion& region = m_regions[run.region];
+			region.cells += run.end - run.begin;
+			region.x0 = run.begin < region.x0 ? run.begin : region.x0;
+			region.x1 = run.end - 1 > region.x1 ? run.end - 1 : region.x1;
+			region.z1 = j;
+
+			m_floorCells += run.end - run.begin;
+		}
+	}
+
+	return (int)m_regions.size();
+}
+
+int RegionLabeler::GetRegionCount() const
+{
+	return (int)m_regions.size();
+}
+
+const DungeonRegion& RegionLabeler::GetRegion(int region) const
+{
+	return m_regions[region];
+}
+
+int RegionLabeler::GetFloorCells() const
+{
+	return m_floorCells;
+}
+
+int RegionLabeler::GetRegionAt(int i, int j) const
+{
+	if (i < 0 || j < 0 || i >= m_width || j >= m_height)
+	{
+		return -1;
+	}
+
+	// Last run starting at or before i
+	int low = m_rowRuns[j];
+	int high = m_rowRuns[j + 1];
+	while (low < high)
+	{
+		int middle = (low + high) / 2;
+		if (m_runs[middle].begin <= i)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+
+	if (low == m_rowRuns[j] || i >= m_runs[low - 1].end)
+	{
+		return -1;
+	}
+	return m_runs[low - 1].region;
+}
+
+int RegionLabeler::GetFloorCell(int ordinal) const
+{
+	// Last run with no more than (ordinal) floor cells before it
+	int low = 0;
+	int high = (int)m_runs.size();
+	while (high - low > 1)
+	{
+		int middle = (low + high) / 2;
+		if (m_runFloor[middle] <= ordinal)
+		{
+			low = middle;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+
+	// Rows are not stored per run, find the one holding it
+	int row = (int)(std::upper_bound(m_rowRuns.begin(), m_rowRuns.end(), low) - m_rowRuns.begin()) - 1;
+
+	return (m_width * row) + m_runs[low].begin + (ordinal - m_runFloor[low]);
+}
+
+int RegionLabeler::GetLargestRegion() const
+{
+	int largest = -1;
+
+	for (int r = 0; r < (int)m_regions.size(); r++)
+	{
+		if (largest < 0 || m_regions[r].cells > m_regions[largest].cells)
+		{
+			largest = r;
+		}
+	}
+
+	return largest;
+}
+
+int RegionLabeler::Connect(float* heights, int width, int height, int radius)
+{
+	int regions = (int)m_regions.size();
+	if (regions < 2 || width != m_width || height != m_height)
+	{
+		return 0;
+	}
+
+	int count = width * height;
+	m_owner.assign(count, -1);
+	m_from.assign(count, FROM_NONE);
+	m_frontier.clear();
+
+	// The border is never carved, claiming it up front keeps every search step in bounds
+	for (int i = 0; i < width; i++)
+	{
+		m_owner[i] = OWNER_BORDER;
+		m_owner[count - width + i] = OWNER_BORDER;
+	}
+	for (int j = 0; j < height; j++)
+	{
+		m_owner[width * j] = OWNER_BORDER;
+		m_owner[(width * j) + width - 1] = OWNER_BORDER;
+	}
+
+	// Every interior floor cell is at distance 0
+	for (int j = 1; j < height - 1; j++)
+	{
+		for (int r = m_rowRuns[j]; r < m_rowRuns[j + 1]; r++)
+		{
+			int begin = m_runs[r].begin > 1 ? m_runs[r].begin : 1;
+			int end = m_runs[r].end < width - 1 ? m_runs[r].end : width - 1;
+
+			for (int i = begin; i < end; i++)
+			{
+				m_owner[(width * j) + i] = m_runs[r].region;
+				m_from[(width * j) + i] = FROM_SOURCE;
+			}
+		}
+	}
+
+	const int offsets[4] = { -1, 1, -width, width };
+
+	// Only the ones next to a wall can reach anything
+	for (int j = 1; j < height - 1; j++)
+	{
+		for (int r = m_rowRuns[j]; r < m_rowRuns[j + 1]; r++)
+		{
+			int begin = m_runs[r].begin > 1 ? m_runs[r].begin : 1;
+			int end = m_runs[r].end < width - 1 ? m_runs[r].end : width - 1;
+
+			for (int i = begin; i < end; i++)
+			{
+				int cell = (width * j) + i;
+				if (m_owner[cell - 1] == -1 || m_owner[cell + 1] == -1 || m_owner[cell - width] == -1 || m_owner[cell + width] == -1)
+				{
+					m_frontier.push_back(cell);
+				}
+			}
+		}
+	}
+
+	m_parent.resize(regions);
+	for (int r = 0; r < regions; r++)
+	{
+		m_parent[r] = r;
+	}
+
+	std::vector<int> shorter, longer;
+	int components = regions;
+	int carved = 0;
+
+	// Round L expands the cells at distance L. A meeting with a cell at distance L is a
+	// corridor of 2L + 1 cells, with one reached this round 2L + 2, and no later round
+	// finds anything shorter, so accepting per round keeps Kruskal's order
+	while (!m_frontier.empty() && components > 1)
+	{
+		m_next.clear();
+		shorter.clear();
+		longer.clear();
+
+		for (size_t f = 0; f < m_frontier.size(); f++)
+		{
+			int cell = m_frontier[f];
+			int owner = m_owner[cell];
+
+			for (int d = 0; d < 4; d++)
+			{
+				int neighbour = cell + offsets[d];
+				int other = m_owner[neighbour];
+
+				if (other == -1)
+				{
+					m_owner[neighbour] = owner;
+					m_from[neighbour] = (uint8_t)(d | FROM_NEW);
+					m_next.push_back(neighbour);
+				}
+				else if (other >= 0 && other != owner && Find(other) != Find(owner))
+				{
+					std::vector<int>& edges = (m_from[neighbour] & FROM_NEW) ? longer : shorter;
+					edges.push_back(cell);
+					edges.push_back(neighbour);
+				}
+			}
+		}
+
+		for (int pass = 0; pass < 2; pass++)
+		{
+			const std::vector<int>& edges = pass == 0 ? shorter : longer;
+
+			for (size_t e = 0; e < edges.size(); e += 2)
+			{
+				int rootA = Find(m_owner[edges[e]]);
+				int rootB = Find(m_owner[edges[e + 1]]);
+				if (rootA == rootB)
+				{
+					continue;
+				}
+
+				m_parent[rootA > rootB ? rootA : rootB] = rootA < rootB ? rootA : rootB;
+				components--;
+
+				CarvePath(heights, edges[e], radius, carved);
+				CarvePath(heights, edges[e + 1], radius, carved);
+			}
+		}
+
+		for (size_t n = 0; n < m_next.size(); n++)
+		{
+			m_from[m_next[n]] &= (uint8_t)~FROM_NEW;
+		}
+		m_frontier.swap(m_next);
+	}
+
+	return carved;
+}
+
+// Walks the search back to the region the cell was reached from, clearing a square brush around each step
+void RegionLabeler::CarvePath(float* heights, int cell, int radius, int& carved)
+{
+	const int offsets[4] = { -1, 1, -m_width, m_width };
+
+	for (;;)
+	{
+		int i = cell % m_width;
+		int j = cell / m_width;
+
+		for (int z = j - radius; z <= j + radius; z++)
+		{
+			for (int x = i - radius; x <= i + radius; x++)
+			{
+				if (x < 1 || z < 1 || x > m_width - 2 || z > m_height - 2)
+				{
+					continue;
+				}
+
+				float& cellHeight = heights[(m_width * z) + x];
+				if (IsDungeonWall(cellHeight))
+				{
+					cellHeight = FLOOR_HEIGHT;
+					carved++;
+				}
+			}
+		}
+
+		uint8_t step = (uint8_t)(m_from[cell] & ~FROM_NEW);
+		if (step == FROM_SOURCE)
+		{
+			return;
+		}
+		cell -= offsets[step];
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+// Connected floor regions of a dungeon grid. Labeling works on horizontal runs of
+// floor cells: each run is unioned with the overlapping runs of the row above, so
+// one pass over the heights plus a near-constant union-find step per run is all it
+// costs. Cells are 4-connected, the way the player can actually walk.
+//
+// Connect joins every region with the shortest corridors through the walls: a
+// breadth-first search grows all regions at once, and the first time two fronts
+// meet gives the shortest corridor between them. Accepting those meetings in order
+// of length (Kruskal) keeps only the ones that join something new.
+
+#include <stdint.h>
+#include <vector>
+
+struct DungeonRegion
+{
+	int	cells;
+	int	x0, z0, x1, z1;		// Inclusive bounds
+	int	firstCell;			// First cell in scan order
+};
+
+class RegionLabeler
+{
+public:
+	RegionLabeler();
+
+	// Labels the floor cells of (heights), returns the region count
+	int Label(const float* heights, int width, int height);
+
+	int						GetRegionCount() const;
+	const DungeonRegion&	GetRegion(int region) const;
+	int						GetFloorCells() const;
+
+	// Region of cell (i, j), -1 for walls. Binary search over the runs of row j
+	int GetRegionAt(int i, int j) const;
+
+	// Cell index of the (ordinal)-th floor cell in scan order, ordinal in [0, GetFloorCells()).
+	// Binary search over the running floor count of the runs
+	int GetFloorCell(int ordinal) const;
+
+	// Index of the region with the most cells, -1 without floor
+	int GetLargestRegion() const;
+
+	// Carves corridors (2 * radius + 1) cells wide joining every labelled region, never
+	// touching the border. Returns the number of wall cells turned to floor. Labels are
+	// stale afterwards, call Label again
+	int Connect(float* heights, int width, int height, int radius);
+
+private:
+	struct Run
+	{
+		int	begin, end;		// [begin, end) within the row
+		int	region;
+	};
+
+	int Find(int item);
+	void CarvePath(float* heights, int cell, int radius, int& carved);
+
+private:
+	int							m_width, m_height;
+	int							m_floorCells;
+	std::vector<Run>			m_runs;
+	std::vector<int>			m_rowRuns;		// First run of each row, plus one past the last
+	std::vector<int>			m_runFloor;		// Floor cells before each run
+	std::vector<int>			m_parent;		// Union-find over runs, then over regions in Connect
+	std::vector<DungeonRegion>	m_regions;
+	std::vector<uint64_t>		m_rowBits;
+
+	// Connect scratch, sized to the map on first use
+	std::vector<int>			m_owner;		// Region that reached a cell first, -1 if none yet, -2 on the border
+	std::vector<uint8_t>		m_from;			// Step the search took into a cell
+	std::vector<int>			m_frontier, m_next;
+};
@@ -0,0 +1,190 @@
+#include "TerrainChunkCache.h"
+
+#include <algorithm>
+
+
+TerrainChunkCache::TerrainChunkCache()
+{
+	m_width = 0;
+	m_height = 0;
+	m_chunkQuads = TERRAIN_DEFAULT_CHUNK_QUADS;
+	m_chunksX = 0;
+	m_chunksZ = 0;
+	m_tilesX = 0;
+	m_tilesZ = 0;
+	m_normalMode = TERRAIN_NORMALS_CENTRAL;
+}
+
+void TerrainChunkCache::SetNormalMode(TerrainNormalMode mode)
+{
+	m_normalMode = mode;
+}
+
+TerrainNormalMode TerrainChunkCache::GetNormalMode() const
+{
+	return m_normalMode;
+}
+
+bool TerrainChunkCache::Build(const float* heights, int width, int height, int chunkQuads)
+{
+	if (!BuildIndexedTerrainMesh(heights, width, height, m_mesh, chunkQuads, m_normalMode))
+	{
+		return false;
+	}
+
+	m_width = width;
+	m_height = height;
+	m_chunkQuads = chunkQuads;
+	ResetTiles();
+
+	return true;
+}
+
+void TerrainChunkCache::Adopt(IndexedTerrainMesh& mesh, int width, int height, int chunkQuads)
+{
+	m_mesh.vertices.swap(mesh.vertices);
+	m_mesh.indices.swap(mesh.indices);
+	m_mesh.chunks.swap(mesh.chunks);
+
+	m_width = width;
+	m_height = height;
+	m_chunkQuads = chunkQuads;
+	ResetTiles();
+}
+
+void TerrainChunkCache::ResetTiles()
+{
+	m_chunksX = (m_width - 1 + m_chunkQuads - 1) / m_chunkQuads;
+	m_chunksZ = (m_height - 1 + m_chunkQuads - 1) / m_chunkQuads;
+
+	m_tilesX = (m_width + TERRAIN_DIRTY_TILE - 1) / TERRAIN_DIRTY_TILE;
+	m_tilesZ = (m_height + TERRAIN_DIRTY_TILE - 1) / TERRAIN_DIRTY_TILE;
+	m_tileDirty.assign((size_t)m_tilesX * m_tilesZ, 0);
+	m_dirtyTiles.clear();
+}
+
+void TerrainChunkCache::MarkDirty(int x0, int z0, int x1, int z1)
+{
+	if (m_tileDirty.empty())
+	{
+		return;
+	}
+
+	x0 = std::max(x0 - 1, 0);
+	z0 = std::max(z0 - 1, 0);
+	x1 = std::min(x1 + 1, m_width - 1);
+	z1 = std::min(z1 + 1, m_height - 1);
+
+	for (int tz = z0 / TERRAIN_DIRTY_TILE; tz <= z1 / TERRAIN_DIRTY_TILE; tz++)
+	{
+		for (int tx = x0 / TERRAIN_DIRTY_TILE; tx <= x1 / TERRAIN_DIRTY_TILE; tx++)
+		{
+			int tile = (m_tilesX * tz) + tx;
+			if (!m_tileDirty[tile])
+			{
+				m_tileDirty[tile] = 1;
+				m_dirtyTiles.push_back(tile);
+			}
+		}
+	}
+}
+
+bool TerrainChunkCache::HasDirty() const
+{
+	return !m_dirtyTiles.empty();
+}
+
+void TerrainChunkCache::Update(const float* heights, std::vector<TerrainVertexRange>& ranges)
+{
+	if (m_dirtyTiles.empty())
+	{
+		return;
+	}
+
+	size_t first = ranges.size();
+
+	for (size_t t = 0; t < m_dirtyTiles.size(); t++)
+	{
+		UpdateTile(heights, m_dirtyTiles[t], ranges);
+		m_tileDirty[m_dirtyTiles[t]] = 0;
+	}
+	m_dirtyTiles.clear();
+
+	// Neighbouring tiles produce adjacent rows, merge them into fewer uploads
+	std::sort(ranges.begin() + first, ranges.end(), [](const TerrainVertexRange& a, const TerrainVertexRange& b)
+	{
+		return a.firstVertex < b.firstVertex;
+	});
+
+	size_t merged = first;
+	for (size_t r = first; r < ranges.size(); r++)
+	{
+		if (merged > first && ranges[merged - 1].firstVertex + ranges[merged - 1].vertexCount >= ranges[r].firstVertex)
+		{
+			uint32_t end = std::max(ranges[merged - 1].firstVertex + ranges[merged - 1].vertexCount, ranges[r].firstVertex + ranges[r].vertexCount);
+			ranges[merged - 1].vertexCount = end - ranges[merged - 1].firstVertex;
+		}
+		else
+		{
+			ranges[merged++] = ranges[r];
+		}
+	}
+	ranges.resize(merged);
+}
+
+// A tile can straddle mesh chunks, and vertices on a chunk seam exist in both
+void TerrainChunkCache::UpdateTile(const float* heights, int tile, std::vector<TerrainVertexRange>& ranges)
+{
+	int x0 = (tile % m_tilesX) * TERRAIN_DIRTY_TILE;
+	int z0 = (tile / m_tilesX) * TERRAIN_DIRTY_TILE;
+	int x1 = std::min(x0 + TERRAIN_DIRTY_TILE, m_width) - 1;
+	int z1 = std::min(z0 + TERRAIN_DIRTY_TILE, m_height) - 1;
+
+	int cxBegin = std::max((x0 - 1) / m_chunkQuads, 0);
+	int cxEnd = std::min(x1 / m_chunkQuads, m_chunksX - 1);
+	int czBegin = std::max((z0 - 1) / m_chunkQuads, 0);
+	int czEnd = std::min(z1 / m_chunkQuads, m_chunksZ - 1);
+
+	for (int cz = czBegin; cz <= czEnd; cz++)
+	{
+		for (int cx = cxBegin; cx <= cxEnd; cx++)
+		{
+			const TerrainMeshChunk& chunk = m_mesh.chunks[(size_t)m_chunksX * cz + cx];
+			int beginX = cx * m_chunkQuads;
+			int beginZ = cz * m_chunkQuads;
+			int stride = std::min(m_chunkQuads, m_width - 1 - beginX) + 1;
+			int rows = (int)chunk.vertexCount / stride;
+
+			int ox0 = std::max(x0, beginX);
+			int ox1 = std::min(x1, beginX + stride - 1);
+			int oz0 = std::max(z0, beginZ);
+			int oz1 = std::min(z1, beginZ + rows - 1);
+
+			if (ox0 > ox1 || oz0 > oz1)
+				continue;
+
+			for (int z = oz0; z <= oz1; z++)
+			{
+				uint32_t base = chunk.baseVertex + (uint32_t)((stride * (z - beginZ)) + (ox0 - beginX));
+
+				for (int x = ox0; x <= ox1; x++)
+				{
+					BuildTerrainVertex(heights, m_width, m_height, x, z, m_mesh.vertices[base + (x - ox0)], m_normalMode);
+				}
+
+				TerrainVertexRange range = { base, (uint32_t)(ox1 - ox0 + 1) };
+				ranges.push_back(range);
+			}
+		}
+	}
+}
+
+const IndexedTerrainMesh& TerrainChunkCache::GetMesh() const
+{
+	return m_mesh;
+}
+
+int TerrainChunkCache::GetDirtyTileCount() const
+{
+	return (int)m_dirtyTiles.size();
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+// CPU copy of the indexed terrain mesh with dirty tracking. Height edits mark
+// small tiles dirty, Update rebuilds only the vertices (and normals) of those
+// tiles and reports the vertex ranges that need uploading, so an edit costs
+// O(changed area) instead of a full rebuild.
+
+#include <stdint.h>
+#include <vector>
+
+#include "TerrainMesh.h"
+
+// Side of a dirty tile in vertices
+#define TERRAIN_DIRTY_TILE 16
+
+// Contiguous run of vertices in the vertex buffer
+struct TerrainVertexRange
+{
+	uint32_t	firstVertex;
+	uint32_t	vertexCount;
+};
+
+class TerrainChunkCache
+{
+public:
+	TerrainChunkCache();
+
+	// Normals used by Build and Update, the tiles Update patches must match the full build
+	void				SetNormalMode(TerrainNormalMode mode);
+	TerrainNormalMode	GetNormalMode() const;
+
+	// Full rebuild from (heights), nothing is left dirty
+	bool Build(const float* heights, int width, int height, int chunkQuads = TERRAIN_DEFAULT_CHUNK_QUADS);
+
+	// Takes over a mesh already built for the current heights (e.g. by the regeneration job)
+	void Adopt(IndexedTerrainMesh& mesh, int width, int height, int chunkQuads = TERRAIN_DEFAULT_CHUNK_QUADS);
+
+	// Heights of cells [x0, x1] x [z0, z1] changed. Vertices one cell further out
+	// are included because their normals read the changed heights
+	void MarkDirty(int x0, int z0, int x1, int z1);
+	bool HasDirty() const;
+
+	// Rebuilds the dirty vertices from (heights) and appends the merged ranges to upload
+	void Update(const float* heights, std::vector<TerrainVertexRange>& ranges);
+
+	const IndexedTerrainMesh&	GetMesh() const;
+	int							GetDirtyTileCount() const;
+
+private:
+	void ResetTiles();
+	void UpdateTile(const float* heights, int tile, std::vector<TerrainVertexRange>& ranges);
+
+private:
+	int					m_width, m_height;
+	int					m_chunkQuads, m_chunksX, m_chunksZ;
+	IndexedTerrainMesh	m_mesh;
+	TerrainNormalMode	m_normalMode;
+
+	int					m_tilesX, m_tilesZ;
+	std::vector<uint8_t> m_tileDirty;
+	std::vector<int>	m_dirtyTiles;
+};
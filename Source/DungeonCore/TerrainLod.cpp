@@ -0,0 +1,433 @@
+#include "TerrainLod.h"
+
+#include <algorithm>
+#include <math.h>
+
+
+// Same corner tables as the full-detail mesh, 0 bottom left, 1 bottom right, 2 upper left, 3 upper right
+static const int s_evenQuad[6] = { 2, 3, 0, 0, 3, 1 };
+static const int s_oddQuad[6] = { 2, 1, 0, 2, 3, 1 };
+
+// Side bits of a stitch mask, set where the neighbour is one level coarser
+enum
+{
+	STITCH_LEFT = 1,
+	STITCH_RIGHT = 2,
+	STITCH_BOTTOM = 4,
+	STITCH_TOP = 8
+};
+
+// Grid lines kept at (step) across (size) quads, the last one is always the chunk edge
+static void LevelSamples(int size, int step, std::vector<int>& samples)
+{
+	samples.clear();
+	for (int v = 0; v < size; v += step)
+	{
+		samples.push_back(v);
+	}
+	samples.push_back(size);
+}
+
+static bool CanStitch(int sizeX, int sizeZ, int level)
+{
+	int step = 1 << level;
+	return (sizeX + step - 1) / step >= 2 && (sizeZ + step - 1) / step >= 2;
+}
+
+struct LodPoint
+{
+	int x, z;
+};
+
+class LodIndexWriter
+{
+public:
+	LodIndexWriter(std::vector<uint16_t>& indices, int stride) : m_indices(indices), m_stride(stride) {}
+
+	void Vertex(int x, int z)
+	{
+		m_indices.push_back((uint16_t)((m_stride * z) + x));
+	}
+
+	// Wound like the full-detail quads, clockwise seen from above. Degenerate triangles are dropped
+	void Triangle(LodPoint a, LodPoint b, LodPoint c)
+	{
+		int cross = ((b.x - a.x) * (c.z - a.z)) - ((b.z - a.z) * (c.x - a.x));
+		if (cross == 0)
+		{
+			return;
+		}
+		if (cross > 0)
+		{
+			std::swap(b, c);
+		}
+
+		Vertex(a.x, a.z);
+		Vertex(b.x, b.z);
+		Vertex(c.x, c.z);
+	}
+
+private:
+	std::vector<uint16_t>&	m_indices;
+	int						m_stride;
+};
+
+// Triangulates the strip between an outer edge and the row of vertices one step inside,
+// advancing along whichever chain is further behind. (t) is the coordinate along the edge
+static void ZipSide(LodIndexWriter& writer, const std::vector<LodPoint>& outer, const std::vector<LodPoint>& inner, bool alongX)
+{
+	size_t i = 0;
+	size_t j = 0;
+
+	while (i + 1 < outer.size() || j + 1 < inner.size())
+	{
+		bool advanceOuter;
+		if (j + 1 >= inner.size())
+		{
+			advanceOuter = true;
+		}
+		else if (i + 1 >= outer.size())
+		{
+			advanceOuter = false;
+		}
+		else
+		{
+			int outerNext = alongX ? outer[i + 1].x : outer[i + 1].z;
+			int innerNext = alongX ? inner[j + 1].x : inner[j + 1].z;
+			advanceOuter = outerNext <= innerNext;
+		}
+
+		if (advanceOuter)
+		{
+			writer.Triangle(outer[i], outer[i + 1], inner[j]);
+			i++;
+		}
+		else
+		{
+			writer.Triangle(outer[i], inner[j + 1], inner[j]);
+			j++;
+		}
+	}
+}
+
+TerrainLod::TerrainLod()
+{
+	m_device = nullptr;
+	m_baseDistance = 64.0f;
+	m_maxLevel = TERRAIN_LOD_MAX_LEVELS - 1;
+	m_chunksX = 0;
+	m_chunksZ = 0;
+	m_fullTriangles = 0;
+}
+
+TerrainLod::~TerrainLod()
+{
+	ReleaseBuffers();
+}
+
+void TerrainLod::SetDevice(MeshBufferDevice* device)
+{
+	ReleaseBuffers();
+	m_lists.clear();
+	m_device = device;
+}
+
+void TerrainLod::SetBaseDistance(float distance)
+{
+	m_baseDistance = distance > 1.0f ? distance : 1.0f;
+}
+
+void TerrainLod::SetMaxLevel(int maxLevel)
+{
+	m_maxLevel = std::max(0, std::min(maxLevel, TERRAIN_LOD_MAX_LEVELS - 1));
+}
+
+void TerrainLod::ReleaseBuffers()
+{
+	if (!m_device)
+	{
+		return;
+	}
+
+	for (std::map<uint32_t, IndexList>::iterator it = m_lists.begin(); it != m_lists.end(); ++it)
+	{
+		if (it->second.buffer)
+		{
+			m_device->ReleaseBuffer(it->second.buffer);
+			it->second.buffer = nullptr;
+		}
+	}
+}
+
+void TerrainLod::Reset(const IndexedTerrainMesh& mesh, int width, int height, int chunkQuads)
+{
+	int quadsX = width - 1;
+	int quadsZ = height - 1;
+
+	m_chunksX = (quadsX + chunkQuads - 1) / chunkQuads;
+	m_chunksZ = (quadsZ + chunkQuads - 1) / chunkQuads;
+	m_chunks.resize((size_t)m_chunksX * m_chunksZ);
+	m_levels.assign(m_chunks.size(), 0);
+	m_fullTriangles = (int)(mesh.indices.size() / 3);
+
+	if (mesh.chunks.size() != m_chunks.size())
+	{
+		m_chunks.clear();
+		m_levels.clear();
+		m_chunksX = 0;
+		m_chunksZ = 0;
+		return;
+	}
+
+	for (int cz = 0; cz < m_chunksZ; cz++)
+	{
+		for (int cx = 0; cx < m_chunksX; cx++)
+		{
+			size_t c = (size_t)m_chunksX * cz + cx;
+			ChunkInfo& chunk = m_chunks[c];
+			const TerrainMeshChunk& meshChunk = mesh.chunks[c];
+
+			chunk.beginX = cx * chunkQuads;
+			chunk.beginZ = cz * chunkQuads;
+			chunk.sizeX = std::min(chunkQuads, quadsX - chunk.beginX);
+			chunk.sizeZ = std::min(chunkQuads, quadsZ - chunk.beginZ);
+			chunk.baseVertex = meshChunk.baseVertex;
+
+			chunk.maxLevel = 0;
+			while (chunk.maxLevel + 1 < TERRAIN_LOD_MAX_LEVELS && CanStitch(chunk.sizeX, chunk.sizeZ, chunk.maxLevel + 1))
+			{
+				chunk.maxLevel++;
+			}
+
+			for (int axis = 0; axis < 3; axis++)
+			{
+				chunk.min[axis] = mesh.vertices[meshChunk.baseVertex].position[axis];
+				chunk.max[axis] = chunk.min[axis];
+			}
+			for (uint32_t v = meshChunk.baseVertex; v < meshChunk.baseVertex + meshChunk.vertexCount; v++)
+			{
+				for (int axis = 0; axis < 3; axis++)
+				{
+					chunk.min[axis] = std::min(chunk.min[axis], mesh.vertices[v].position[axis]);
+					chunk.max[axis] = std::max(chunk.max[axis], mesh.vertices[v].position[axis]);
+				}
+			}
+		}
+	}
+}
+
+void TerrainLod::ChooseLevels(const float* camera)
+{
+	for (size_t c = 0; c < m_chunks.size(); c++)
+	{
+		const ChunkInfo& chunk = m_chunks[c];
+
+		// Distance from the camera to the chunk's bounding box
+		float squared = 0.0f;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float d = std::max(std::max(chunk.min[axis] - camera[axis], camera[axis] - chunk.max[axis]), 0.0f);
+			squared += d * d;
+		}
+		float distance = sqrtf(squared);
+
+		int level = 0;
+		if (distance >= m_baseDistance)
+		{
+			level = 1 + (int)floorf(log2f(distance / m_baseDistance));
+		}
+		m_levels[c] = std::min(level, std::min(m_maxLevel, chunk.maxLevel));
+	}
+
+	// A chunk can only stitch to neighbours one level coarser, and only if it keeps an
+	// inner ring at its own level. Refine neighbours until every pair is compatible
+	bool changed = true;
+	while (changed)
+	{
+		changed = false;
+
+		for (int cz = 0; cz < m_chunksZ; cz++)
+		{
+			for (int cx = 0; cx < m_chunksX; cx++)
+			{
+				int c = (m_chunksX * cz) + cx;
+				const ChunkInfo& chunk = m_chunks[c];
+				int limit = m_levels[c] + (CanStitch(chunk.sizeX, chunk.sizeZ, m_levels[c]) ? 1 : 0);
+
+				const int neighbours[4][2] = { { cx - 1, cz }, { cx + 1, cz }, { cx, cz - 1 }, { cx, cz + 1 } };
+				for (int n = 0; n < 4; n++)
+				{
+					int nx = neighbours[n][0];
+					int nz = neighbours[n][1];
+					if (nx < 0 || nz < 0 || nx >= m_chunksX || nz >= m_chunksZ)
+						continue;
+
+					int neighbour = (m_chunksX * nz) + nx;
+					if (m_levels[neighbour] > limit)
+					{
+						m_levels[neighbour] = limit;
+						changed = true;
+					}
+				}
+			}
+		}
+	}
+}
+
+int TerrainLod::Select(const float* camera, std::vector<TerrainDrawItem>& items)
+{
+	items.clear();
+	ChooseLevels(camera);
+
+	int triangles = 0;
+
+	for (int cz = 0; cz < m_chunksZ; cz++)
+	{
+		for (int cx = 0; cx < m_chunksX; cx++)
+		{
+			int c = (m_chunksX * cz) + cx;
+			int level = m_levels[c];
+
+			int stitchMask = 0;
+			if (cx > 0 && m_levels[c - 1] > level)
+				stitchMask |= STITCH_LEFT;
+			if (cx + 1 < m_chunksX && m_levels[c + 1] > level)
+				stitchMask |= STITCH_RIGHT;
+			if (cz > 0 && m_levels[c - m_chunksX] > level)
+				stitchMask |= STITCH_BOTTOM;
+			if (cz + 1 < m_chunksZ && m_levels[c + m_chunksX] > level)
+				stitchMask |= STITCH_TOP;
+
+			const IndexList& list = GetIndexList(m_chunks[c], level, stitchMask);
+
+			TerrainDrawItem item;
+			item.chunk = c;
+			item.level = level;
+			item.baseVertex = m_chunks[c].baseVertex;
+			item.indexCount = (uint32_t)list.indices.size();
+			item.indexBuffer = list.buffer;
+			item.indices = list.indices.data();
+			items.push_back(item);
+
+			triangles += (int)(list.indices.size() / 3);
+		}
+	}
+
+	return triangles;
+}
+
+const TerrainLod::IndexList& TerrainLod::GetIndexList(const ChunkInfo& chunk, int level, int stitchMask)
+{
+	int parity = (chunk.beginX + chunk.beginZ) & 1;
+	uint32_t key = (uint32_t)chunk.sizeX | ((uint32_t)chunk.sizeZ << 8) | ((uint32_t)parity << 16) | ((uint32_t)level << 17) | ((uint32_t)stitchMask << 20);
+
+	std::map<uint32_t, IndexList>::iterator found = m_lists.find(key);
+	if (found != m_lists.end())
+	{
+		return found->second;
+	}
+
+	IndexList& list = m_lists[key];
+	list.buffer = nullptr;
+
+	int step = 1 << level;
+	std::vector<int> xs, zs;
+	LevelSamples(chunk.sizeX, step, xs);
+	LevelSamples(chunk.sizeZ, step, zs);
+	int cellsX = (int)xs.size() - 1;
+	int cellsZ = (int)zs.size() - 1;
+
+	LodIndexWriter writer(list.indices, chunk.sizeX + 1);
+
+	// Without stitching the whole chunk is regular cells, at level 0 exactly the full-detail indices
+	bool ring = stitchMask != 0 && cellsX >= 2 && cellsZ >= 2;
+	int first = ring ? 1 : 0;
+
+	for (int j = first; j < cellsZ - first; j++)
+	{
+		for (int i = first; i < cellsX - first; i++)
+		{
+			const int* order = ((i + j + parity) % 2 == 0) ? s_evenQuad : s_oddQuad;
+
+			for (int v = 0; v < 6; v++)
+			{
+				writer.Vertex(xs[i + (order[v] & 1)], zs[j + (order[v] >> 1)]);
+			}
+		}
+	}
+
+	if (ring)
+	{
+		// Outer edges keep only the coarser neighbour's grid lines on stitched sides
+		int coarse = step * 2;
+		std::vector<LodPoint> outer, inner;
+
+		for (int side = 0; side < 4; side++)
+		{
+			bool alongX = side >= 2;
+			bool stitched = (stitchMask & (1 << side)) != 0;
+			const std::vector<int>& along = alongX ? xs : zs;
+			int size = alongX ? chunk.sizeX : chunk.sizeZ;
+
+			// Left and bottom sit on the first grid line, right and top on the last
+			int edge, innerLine;
+			if (alongX)
+			{
+				edge = side == 2 ? zs[0] : zs[cellsZ];
+				innerLine = side == 2 ? zs[1] : zs[cellsZ - 1];
+			}
+			else
+			{
+				edge = side == 0 ? xs[0] : xs[cellsX];
+				innerLine = side == 0 ? xs[1] : xs[cellsX - 1];
+			}
+
+			outer.clear();
+			inner.clear();
+			for (size_t k = 0; k < along.size(); k++)
+			{
+				int t = along[k];
+				if (stitched && t % coarse != 0 && t != size)
+					continue;
+
+				LodPoint point = alongX ? LodPoint{ t, edge } : LodPoint{ edge, t };
+				outer.push_back(point);
+			}
+			for (size_t k = 1; k + 1 < along.size(); k++)
+			{
+				int t = along[k];
+				LodPoint point = alongX ? LodPoint{ t, innerLine } : LodPoint{ innerLine, t };
+				inner.push_back(point);
+			}
+
+			ZipSide(writer, outer, inner, alongX);
+		}
+	}
+
+	if (m_device && !list.indices.empty())
+	{
+		list.buffer = m_device->CreateIndexBuffer(list.indices.data(), list.indices.size() * sizeof(uint16_t));
+	}
+
+	return list;
+}
+
+int TerrainLod::GetChunkCount() const
+{
+	return (int)m_chunks.size();
+}
+
+int TerrainLod::GetLevel(int chunk) const
+{
+	return m_levels[chunk];
+}
+
+int TerrainLod::GetCachedListCount() const
+{
+	return (int)m_lists.size();
+}
+
+int TerrainLod::GetFullTriangleCount() const
+{
+	return m_fullTriangles;
+}
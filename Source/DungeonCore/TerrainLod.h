@@ -0,0 +1,93 @@
+#pragma once
+
+// Geomipmapped terrain LOD over the chunks of an IndexedTerrainMesh. Each chunk
+// picks a level from its distance to the camera; level L keeps every 2^L-th
+// vertex of the unchanged vertex buffer, so switching levels only swaps index
+// lists. Neighbouring chunks differ by at most one level, and the finer side
+// stitches its border ring to the coarser side's vertices so no cracks open.
+// Selection and index generation are pure CPU; GPU index buffers are created
+// through a MeshBufferDevice only when one is set.
+
+#include <map>
+#include <stdint.h>
+#include <vector>
+
+#include "TerrainMesh.h"
+#include "TerrainRegenerator.h"
+
+#define TERRAIN_LOD_MAX_LEVELS 8
+
+// One DrawIndexed(indexCount, 0, baseVertex) with indexBuffer bound
+struct TerrainDrawItem
+{
+	int					chunk;
+	int					level;
+	uint32_t			baseVertex;
+	uint32_t			indexCount;
+	MeshBufferHandle	indexBuffer;	// Null without a device
+	const uint16_t*		indices;		// CPU copy, valid until the TerrainLod is destroyed
+};
+
+class TerrainLod
+{
+public:
+	TerrainLod();
+	~TerrainLod();
+
+	// Index buffers are created on demand and released with the TerrainLod
+	void SetDevice(MeshBufferDevice* device);
+
+	// Chunks closer than (distance) are drawn at full detail, every doubling of the
+	// distance drops one level, up to (maxLevel)
+	void SetBaseDistance(float distance);
+	void SetMaxLevel(int maxLevel);
+
+	// Chunk layout and bounds of (mesh). Cached index lists are kept, they only depend on the chunk shape
+	void Reset(const IndexedTerrainMesh& mesh, int width, int height, int chunkQuads = TERRAIN_DEFAULT_CHUNK_QUADS);
+
+	// Fills this frame's draw list for a camera at (x, y, z) and returns its triangle count
+	int Select(const float* camera, std::vector<TerrainDrawItem>& items);
+
+	int GetChunkCount() const;
+	int GetLevel(int chunk) const;
+	int GetCachedListCount() const;
+
+	// Triangles drawn with every chunk at level 0
+	int GetFullTriangleCount() const;
+
+private:
+	TerrainLod(const TerrainLod&);
+	TerrainLod& operator=(const TerrainLod&);
+
+	struct ChunkInfo
+	{
+		int			beginX, beginZ;
+		int			sizeX, sizeZ;
+		int			maxLevel;
+		uint32_t	baseVertex;
+		float		min[3], max[3];
+	};
+
+	struct IndexList
+	{
+		std::vector<uint16_t>	indices;
+		MeshBufferHandle		buffer;
+	};
+
+	void				ChooseLevels(const float* camera);
+	const IndexList&	GetIndexList(const ChunkInfo& chunk, int level, int stitchMask);
+	void				ReleaseBuffers();
+
+private:
+	MeshBufferDevice*				m_device;
+	float							m_baseDistance;
+	int								m_maxLevel;
+
+	int								m_chunksX, m_chunksZ;
+	std::vector<ChunkInfo>			m_chunks;
+	std::vector<int>				m_levels;
+	int								m_fullTriangles;
+
+	// Keyed by chunk shape, diagonal parity, level and stitched sides
+	std::map<uint32_t, IndexList>	m_lists;
+};
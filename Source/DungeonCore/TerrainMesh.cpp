@@ -0,0 +1,341 @@
+#include "TerrainMesh.h"
+
+#include "GridKernels.h"
+
+#include <algorithm>
+#include <math.h>
+
+
+// Un-normalized normal of the quad whose bottom left corner is (i, j)
+static void FaceNormal(const float* heights, int width, int i, int j, float* face)
+{
+	float vertex1[3] = { (float)i, heights[(width * j) + i], (float)j };
+	float vertex2[3] = { (float)(i + 1), heights[(width * j) + (i + 1)], (float)j };
+	float vertex3[3] = { (float)i, heights[(width * (j + 1)) + i], (float)(j + 1) };
+
+	float vector1[3] = { vertex1[0] - vertex3[0], vertex1[1] - vertex3[1], vertex1[2] - vertex3[2] };
+	float vector2[3] = { vertex3[0] - vertex2[0], vertex3[1] - vertex2[1], vertex3[2] - vertex2[2] };
+
+	face[0] = (vector1[1] * vector2[2]) - (vector1[2] * vector2[1]);
+	face[1] = (vector1[2] * vector2[0]) - (vector1[0] * vector2[2]);
+	face[2] = (vector1[0] * vector2[1]) - (vector1[1] * vector2[0]);
+}
+
+static void AverageFaceNormals(float* sum, int count, float* normal)
+{
+	sum[0] = sum[0] / (float)count;
+	sum[1] = sum[1] / (float)count;
+	sum[2] = sum[2] / (float)count;
+
+	float length = sqrtf((sum[0] * sum[0]) + (sum[1] * sum[1]) + (sum[2] * sum[2]));
+
+	normal[0] = sum[0] / length;
+	normal[1] = sum[1] / length;
+	normal[2] = sum[2] / length;
+}
+
+// Sums the faces around (i, j) in the original order, (i-1, j-1), (i, j-1), (i-1, j), (i, j).
+// Each face row holds width - 1 faces, null where the row is outside the grid
+static void SumFaceRows(const float* lower, const float* upper, int width, int i, float* normal)
+{
+	float sum[3] = { 0.0f, 0.0f, 0.0f };
+	int count = 0;
+
+	const float* rows[2] = { lower, upper };
+	for (int r = 0; r < 2; r++)
+	{
+		if (!rows[r])
+			continue;
+
+		for (int fi = i - 1; fi <= i; fi++)
+		{
+			if (fi < 0 || fi >= width - 1)
+				continue;
+
+			const float* face = &rows[r][fi * 3];
+			sum[0] += face[0];
+			sum[1] += face[1];
+			sum[2] += face[2];
+			count++;
+		}
+	}
+
+	AverageFaceNormals(sum, count, normal);
+}
+
+static void FaceNormalRow(const float* heights, int width, int j, float* faces)
+{
+	for (int i = 0; i < width - 1; i++)
+	{
+		FaceNormal(heights, width, i, j, &faces[i * 3]);
+	}
+}
+
+// Central differences at (i, j), one-sided where a neighbour is off the grid.
+// Same arithmetic as GridKernels::normalRow so both give identical bits
+static void CentralDifferenceNormal(const float* heights, int width, int height, int i, int j, float* normal)
+{
+	int left = i > 0 ? i - 1 : i;
+	int right = i < width - 1 ? i + 1 : i;
+	int above = j > 0 ? j - 1 : j;
+	int below = j < height - 1 ? j + 1 : j;
+
+	const float* row = &heights[(size_t)width * j];
+	float dx = (row[left] - row[right]) * (right - left == 2 ? 0.5f : 1.0f);
+	float dz = (heights[(size_t)width * above + i] - heights[(size_t)width * below + i]) * (below - above == 2 ? 0.5f : 1.0f);
+	float scale = 1.0f / sqrtf((dx * dx) + (dz * dz) + 1.0f);
+
+	normal[0] = dx * scale;
+	normal[1] = scale;
+	normal[2] = dz * scale;
+}
+
+static void CalculateFaceAveragedNormals(const float* heights, int width, int height, float* normals)
+{
+	// Only the face rows below and above the current vertex row are kept
+	std::vector<float> faceRows((size_t)(width - 1) * 3 * 2);
+	float* lower = &faceRows[0];
+	float* upper = &faceRows[(size_t)(width - 1) * 3];
+
+	FaceNormalRow(heights, width, 0, upper);
+
+	for (int j = 0; j < height; j++)
+	{
+		for (int i = 0; i < width; i++)
+		{
+			SumFaceRows(j > 0 ? lower : nullptr, j < height - 1 ? upper : nullptr, width, i, &normals[((size_t)width * j + i) * 3]);
+		}
+
+		if (j + 1 < height - 1)
+		{
+			std::swap(lower, upper);
+			FaceNormalRow(heights, width, j + 1, upper);
+		}
+		else
+		{
+			lower = upper;
+		}
+	}
+}
+
+static void CalculateCentralNormals(const float* heights, int width, int height, float* normals)
+{
+	const GridKernels* kernels = GetBestGridKernels();
+
+	for (int j = 0; j < height; j++)
+	{
+		float* rowNormals = &normals[(size_t)width * j * 3];
+
+		if (j == 0 || j == height - 1 || width < 3)
+		{
+			for (int i = 0; i < width; i++)
+			{
+				CentralDifferenceNormal(heights, width, height, i, j, &rowNormals[i * 3]);
+			}
+			continue;
+		}
+
+		const float* row = &heights[(size_t)width * j];
+		kernels->normalRow(row - width, row, row + width, rowNormals, 1, width - 1);
+		CentralDifferenceNormal(heights, width, height, 0, j, &rowNormals[0]);
+		CentralDifferenceNormal(heights, width, height, width - 1, j, &rowNormals[(width - 1) * 3]);
+	}
+}
+
+bool CalculateTerrainNormals(const float* heights, int width, int height, std::vector<float>& normals, TerrainNormalMode mode)
+{
+	if (width < 2 || height < 2)
+	{
+		return false;
+	}
+
+	normals.resize((size_t)width * height * 3);
+
+	if (mode == TERRAIN_NORMALS_FACE_AVERAGED)
+	{
+		CalculateFaceAveragedNormals(heights, width, height, normals.data());
+	}
+	else
+	{
+		CalculateCentralNormals(heights, width, height, normals.data());
+	}
+
+	return true;
+}
+
+void CalculateTerrainNormal(const float* heights, int width, int height, int i, int j, float* normal, TerrainNormalMode mode)
+{
+	if (mode != TERRAIN_NORMALS_FACE_AVERAGED)
+	{
+		CentralDifferenceNormal(heights, width, height, i, j, normal);
+		return;
+	}
+
+	float sum[3] = { 0.0f, 0.0f, 0.0f };
+	int count = 0;
+
+	for (int fj = j - 1; fj <= j; fj++)
+	{
+		for (int fi = i - 1; fi <= i; fi++)
+		{
+			if (fi < 0 || fj < 0 || fi >= width - 1 || fj >= height - 1)
+				continue;
+
+			float face[3];
+			FaceNormal(heights, width, fi, fj, face);
+			sum[0] += face[0];
+			sum[1] += face[1];
+			sum[2] += face[2];
+			count++;
+		}
+	}
+
+	AverageFaceNormals(sum, count, normal);
+}
+
+void BuildTerrainVertex(const float* heights, int width, int height, int i, int j, TerrainVertex& vertex, TerrainNormalMode mode)
+{
+	float textureCoordinatesStep = 5.0f / width;
+
+	vertex.position[0] = (float)i;
+	vertex.position[1] = heights[((size_t)width * j) + i];
+	vertex.position[2] = (float)j;
+	vertex.texture[0] = (float)i * textureCoordinatesStep;
+	vertex.texture[1] = (float)j * textureCoordinatesStep;
+	CalculateTerrainNormal(heights, width, height, i, j, vertex.normal, mode);
+}
+
+// Corner order per quad, 0 bottom left, 1 bottom right, 2 upper left, 3 upper right.
+// The diagonal flips on every other quad in both directions
+static const int s_evenQuad[6] = { 2, 3, 0, 0, 3, 1 };
+static const int s_oddQuad[6] = { 2, 1, 0, 2, 3, 1 };
+
+static void SetTerrainVertex(TerrainVertex& vertex, const float* heights, const std::vector<float>& normals, int width, int ci, int cj)
+{
+	size_t cell = ((size_t)width * cj) + ci;
+	float textureCoordinatesStep = 5.0f / width;
+
+	vertex.position[0] = (float)ci;
+	vertex.position[1] = heights[cell];
+	vertex.position[2] = (float)cj;
+	vertex.texture[0] = (float)ci * textureCoordinatesStep;
+	vertex.texture[1] = (float)cj * textureCoordinatesStep;
+	vertex.normal[0] = normals[cell * 3];
+	vertex.normal[1] = normals[cell * 3 + 1];
+	vertex.normal[2] = normals[cell * 3 + 2];
+}
+
+bool BuildTerrainMesh(const float* heights, int width, int height, TerrainMeshData& mesh, TerrainNormalMode mode)
+{
+	std::vector<float> normals;
+	if (!CalculateTerrainNormals(heights, width, height, normals, mode))
+	{
+		return false;
+	}
+
+	size_t vertexCount = (size_t)(width - 1) * (height - 1) * 6;
+	mesh.vertices.resize(vertexCount);
+	mesh.indices.resize(vertexCount);
+
+	size_t index = 0;
+
+	for (int j = 0; j < height - 1; j++)
+	{
+		for (int i = 0; i < width - 1; i++)
+		{
+			const int* order = ((i + j) % 2 == 0) ? s_evenQuad : s_oddQuad;
+
+			for (int v = 0; v < 6; v++)
+			{
+				int ci = i + (order[v] & 1);
+				int cj = j + (order[v] >> 1);
+
+				SetTerrainVertex(mesh.vertices[index], heights, normals, width, ci, cj);
+				mesh.indices[index] = (uint32_t)index;
+				index++;
+			}
+		}
+	}
+
+	return true;
+}
+
+bool BuildIndexedTerrainMesh(const float* heights, int width, int height, IndexedTerrainMesh& mesh, int chunkQuads, TerrainNormalMode mode)
+{
+	if (chunkQuads < 1 || chunkQuads > TERRAIN_MAX_CHUNK_QUADS)
+	{
+		return false;
+	}
+
+	std::vector<float> normals;
+	if (!CalculateTerrainNormals(heights, width, height, normals, mode))
+	{
+		return false;
+	}
+
+	int quadsX = width - 1;
+	int quadsZ = height - 1;
+	int chunksX = (quadsX + chunkQuads - 1) / chunkQuads;
+	int chunksZ = (quadsZ + chunkQuads - 1) / chunkQuads;
+
+	// Chunks on the right and top edge may be narrower
+	size_t vertexCount = 0;
+	for (int cz = 0; cz < chunksZ; cz++)
+	{
+		for (int cx = 0; cx < chunksX; cx++)
+		{
+			int sizeX = std::min(chunkQuads, quadsX - cx * chunkQuads);
+			int sizeZ = std::min(chunkQuads, quadsZ - cz * chunkQuads);
+			vertexCount += (size_t)(sizeX + 1) * (sizeZ + 1);
+		}
+	}
+
+	mesh.vertices.resize(vertexCount);
+	mesh.indices.resize((size_t)quadsX * quadsZ * 6);
+	mesh.chunks.resize((size_t)chunksX * chunksZ);
+
+	size_t vertex = 0;
+	size_t index = 0;
+
+	for (int cz = 0; cz < chunksZ; cz++)
+	{
+		for (int cx = 0; cx < chunksX; cx++)
+		{
+			int beginX = cx * chunkQuads;
+			int beginZ = cz * chunkQuads;
+			int sizeX = std::min(chunkQuads, quadsX - beginX);
+			int sizeZ = std::min(chunkQuads, quadsZ - beginZ);
+			int stride = sizeX + 1;
+
+			TerrainMeshChunk& chunk = mesh.chunks[(size_t)chunksX * cz + cx];
+			chunk.baseVertex = (uint32_t)vertex;
+			chunk.vertexCount = (uint32_t)(stride * (sizeZ + 1));
+			chunk.firstIndex = (uint32_t)index;
+			chunk.indexCount = (uint32_t)(sizeX * sizeZ * 6);
+
+			for (int j = 0; j <= sizeZ; j++)
+			{
+				for (int i = 0; i <= sizeX; i++)
+				{
+					SetTerrainVertex(mesh.vertices[vertex++], heights, normals, width, beginX + i, beginZ + j);
+				}
+			}
+
+			for (int j = 0; j < sizeZ; j++)
+			{
+				for (int i = 0; i < sizeX; i++)
+				{
+					const int* order = ((beginX + i + beginZ + j) % 2 == 0) ? s_evenQuad : s_oddQuad;
+
+					for (int v = 0; v < 6; v++)
+					{
+						int local = (stride * (j + (order[v] >> 1))) + i + (order[v] & 1);
+						mesh.indices[index++] = (uint16_t)local;
+					}
+				}
+			}
+		}
+	}
+
+	return true;
+}
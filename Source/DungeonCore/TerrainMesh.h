@@ -0,0 +1,65 @@
+#pragma once
+
+// CPU half of the terrain renderer: vertex normals and the triangle list built
+// from a height grid. Kept free of DirectX so meshes can be produced off the
+// render thread and checked headless.
+
+#include <stdint.h>
+#include <vector>
+
+// Same layout as Terrain::VertexType (position, texture, normal)
+struct TerrainVertex
+{
+	float position[3];
+	float texture[2];
+	float normal[3];
+};
+
+struct TerrainMeshData
+{
+	std::vector<TerrainVertex>	vertices;
+	std::vector<uint32_t>		indices;
+};
+
+// Square block of quads drawn with DrawIndexed(indexCount, firstIndex, baseVertex)
+struct TerrainMeshChunk
+{
+	uint32_t	baseVertex;
+	uint32_t	vertexCount;
+	uint32_t	firstIndex;
+	uint32_t	indexCount;
+};
+
+// One vertex per grid point, split into chunks small enough for 16-bit indices.
+// Only grid points on a chunk seam are stored twice
+struct IndexedTerrainMesh
+{
+	std::vector<TerrainVertex>		vertices;
+	std::vector<uint16_t>			indices;
+	std::vector<TerrainMeshChunk>	chunks;
+};
+
+// Largest chunk side (in quads) whose (side + 1)^2 vertices fit a 16-bit index
+#define TERRAIN_MAX_CHUNK_QUADS 255
+#define TERRAIN_DEFAULT_CHUNK_QUADS 128
+
+enum TerrainNormalMode
+{
+	TERRAIN_NORMALS_CENTRAL = 0,		// Height central differences, one-sided on the map border
+	TERRAIN_NORMALS_FACE_AVERAGED		// Average of the touching quad normals, the original lighting
+};
+
+// Vertex normals, three floats per cell, in one streaming pass over the rows
+bool CalculateTerrainNormals(const float* heights, int width, int height, std::vector<float>& normals, TerrainNormalMode mode = TERRAIN_NORMALS_CENTRAL);
+
+// Same normal for the single vertex (i, j), reads heights within one cell of it
+void CalculateTerrainNormal(const float* heights, int width, int height, int i, int j, float* normal, TerrainNormalMode mode = TERRAIN_NORMALS_CENTRAL);
+void BuildTerrainVertex(const float* heights, int width, int height, int i, int j, TerrainVertex& vertex, TerrainNormalMode mode = TERRAIN_NORMALS_CENTRAL);
+
+// Six vertices per quad with the alternating diagonal the terrain has always used,
+// texture tiled 5 times across the map. Reference for the indexed builder
+bool BuildTerrainMesh(const float* heights, int width, int height, TerrainMeshData& mesh, TerrainNormalMode mode = TERRAIN_NORMALS_CENTRAL);
+
+// Same triangles as BuildTerrainMesh with shared vertices, chunks of (chunkQuads) x (chunkQuads) quads
+bool BuildIndexedTerrainMesh(const float* heights, int width, int height, IndexedTerrainMesh& mesh, int chunkQuads = TERRAIN_DEFAULT_CHUNK_QUADS,
+	TerrainNormalMode mode = TERRAIN_NORMALS_CENTRAL);
@@ -0,0 +1,408 @@
+#include "TerrainRegenerator.h"
+
+#include <string.h>
+
+
+RecordingMeshBufferDevice::RecordingMeshBufferDevice()
+{
+	m_created = 0;
+	m_released = 0;
+	m_updates = 0;
+	m_updatedBytes = 0;
+}
+
+RecordingMeshBufferDevice::~RecordingMeshBufferDevice()
+{
+	for (size_t i = 0; i < m_live.size(); i++)
+	{
+		delete m_live[i];
+	}
+}
+
+MeshBufferHandle RecordingMeshBufferDevice::CreateVertexBuffer(const void* data, size_t bytes)
+{
+	return Record(data, bytes);
+}
+
+MeshBufferHandle RecordingMeshBufferDevice::CreateIndexBuffer(const void* data, size_t bytes)
+{
+	return Record(data, bytes);
+}
+
+MeshBufferHandle RecordingMeshBufferDevice::Record(const void* data, size_t bytes)
+{
+	std::vector<unsigned char>* buffer = new std::vector<unsigned char>(bytes);
+	if (bytes > 0)
+	{
+		memcpy(buffer->data(), data, bytes);
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_live.push_back(buffer);
+	m_created++;
+
+	return buffer;
+}
+
+bool RecordingMeshBufferDevice::UpdateBuffer(MeshBufferHandle buffer, size_t offset, const void* data, size_t bytes)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	for (size_t i = 0; i < m_live.size(); i++)
+	{
+		if (m_live[i] == buffer)
+		{
+			if (offset + bytes > m_live[i]->size())
+			{
+				return false;
+			}
+
+			memcpy(m_live[i]->data() + offset, data, bytes);
+			m_updates++;
+			m_updatedBytes += bytes;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void RecordingMeshBufferDevice::ReleaseBuffer(MeshBufferHandle buffer)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	for (size_t i = 0; i < m_live.size(); i++)
+	{
+		if (m_live[i] == buffer)
+		{
+			delete m_live[i];
+			m_live.erase(m_live.begin() + i);
+			m_released++;
+			return;
+		}
+	}
+}
+
+int RecordingMeshBufferDevice::GetCreatedCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_created;
+}
+
+int RecordingMeshBufferDevice::GetReleasedCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_released;
+}
+
+int RecordingMeshBufferDevice::GetUpdateCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_updates;
+}
+
+size_t RecordingMeshBufferDevice::GetUpdatedBytes() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_updatedBytes;
+}
+
+int RecordingMeshBufferDevice::GetLiveCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return (int)m_live.size();
+}
+
+size_t RecordingMeshBufferDevice::GetLiveBytes() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	size_t bytes = 0;
+	for (size_t i = 0; i < m_live.size(); i++)
+	{
+		bytes += m_live[i]->size();
+	}
+	return bytes;
+}
+
+const std::vector<unsigned char>* RecordingMeshBufferDevice::GetContents(MeshBufferHandle buffer) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	for (size_t i = 0; i < m_live.size(); i++)
+	{
+		if (m_live[i] == buffer)
+		{
+			return m_live[i];
+		}
+	}
+	return nullptr;
+}
+
+TerrainRegenerator::TerrainRegenerator()
+{
+	m_device = nullptr;
+	m_normalMode = TERRAIN_NORMALS_CENTRAL;
+	m_vertexFormat = TERRAIN_VERTEX_FLOAT;
+	MakeTerrainQuantization(m_quantization);
+	m_bakeWallField = false;
+	m_busy = false;
+	m_ready = false;
+	m_succeeded = false;
+
+	m_buffers.vertexBuffer = nullptr;
+	m_buffers.indexBuffer = nullptr;
+	m_buffers.vertexCount = 0;
+	m_buffers.indexCount = 0;
+	m_buffers.vertexStride = 0;
+}
+
+TerrainRegenerator::~TerrainRegenerator()
+{
+	Join();
+	ReleaseBuffers(m_buffers);
+}
+
+void TerrainRegenerator::SetDevice(MeshBufferDevice* device)
+{
+	Join();
+	m_device = device;
+}
+
+void TerrainRegenerator::SetNormalMode(TerrainNormalMode mode)
+{
+	Join();
+	m_normalMode = mode;
+}
+
+TerrainNormalMode TerrainRegenerator::GetNormalMode() const
+{
+	return m_normalMode;
+}
+
+void TerrainRegenerator::SetVertexFormat(TerrainVertexFormat format)
+{
+	Join();
+	m_vertexFormat = format;
+}
+
+TerrainVertexFormat TerrainRegenerator::GetVertexFormat() const
+{
+	return m_vertexFormat;
+}
+
+void TerrainRegenerator::SetBakeWallField(bool bake)
+{
+	Join();
+	m_bakeWallField = bake;
+}
+
+bool TerrainRegenerator::GetBakeWallField() const
+{
+	return m_bakeWallField;
+}
+
+bool TerrainRegenerator::Request(const DungeonMap& map, int startX, int startZ)
+{
+	if (m_busy)
+	{
+		return false;
+	}
+
+	// A finished result nobody swapped in is superseded
+	Join();
+	m_ready = false;
+	ReleaseBuffers(m_buffers);
+
+	m_map = map;
+	m_busy = true;
+	m_thread = std::thread(&TerrainRegenerator::Run, this, startX, startZ);
+
+	return true;
+}
+
+bool TerrainRegenerator::IsBusy() const
+{
+	return m_busy;
+}
+
+void TerrainRegenerator::Wait()
+{
+	Join();
+}
+
+void TerrainRegenerator::Discard()
+{
+	Join();
+	m_ready = false;
+	ReleaseBuffers(m_buffers);
+	m_field.Clear();
+}
+
+void TerrainRegenerator::Join()
+{
+	if (m_thread.joinable())
+	{
+		m_thread.join();
+	}
+}
+
+void TerrainRegenerator::Run(int startX, int startZ)
+{
+	m_succeeded = m_map.PCGDungeonMap(startX, startZ);
+
+	if (m_succeeded)
+	{
+		m_succeeded = m_map.PlaceCollectibles(m_collectibles);
+	}
+
+	if (m_succeeded)
+	{
+		m_succeeded = BuildIndexedTerrainMesh(m_map.GetHeights(), m_map.GetWidth(), m_map.GetHeight(), m_mesh, TERRAIN_DEFAULT_CHUNK_QUADS, m_normalMode);
+	}
+
+	if (m_succeeded && m_device)
+	{
+		m_succeeded = CreateBuffers(m_mesh, m_buffers);
+	}
+
+	// The whole-map transform is the slowest part of an edit, so it is baked here rather than on the frame
+	m_field.Clear();
+	if (m_succeeded && m_bakeWallField)
+	{
+		m_succeeded = m_field.Build(m_map.GetHeights(), m_map.GetWidth(), m_map.GetHeight());
+	}
+
+	m_ready = true;
+	m_busy = false;
+}
+
+bool TerrainRegenerator::Swap(DungeonMap& map, std::vector<DungeonPoint>& collectibles, TerrainBuffers& buffers, IndexedTerrainMesh& mesh,
+	WallDistanceField* field)
+{
+	if (!m_ready)
+	{
+		return false;
+	}
+
+	Join();
+	m_ready = false;
+
+	// A map resized since the request cannot take these heights, so the mesh would not match them either
+	if (!m_succeeded || map.GetWidth() != m_map.GetWidth() || map.GetHeight() != m_map.GetHeight())
+	{
+		ReleaseBuffers(m_buffers);
+		m_field.Clear();
+		return false;
+	}
+
+	ReleaseBuffers(buffers);
+	buffers = m_buffers;
+	m_buffers.vertexBuffer = nullptr;
+	m_buffers.indexBuffer = nullptr;
+	m_buffers.vertexCount = 0;
+	m_buffers.indexCount = 0;
+	m_buffers.vertexStride = 0;
+	m_buffers.chunks.clear();
+
+	map.SwapHeights(m_map);
+	collectibles.swap(m_collectibles);
+	mesh.vertices.swap(m_mesh.vertices);
+	mesh.indices.swap(m_mesh.indices);
+	mesh.chunks.swap(m_mesh.chunks);
+
+	if (field)
+	{
+		field->Swap(m_field);
+		m_field.Clear();
+	}
+
+	return true;
+}
+
+bool TerrainRegenerator::CreateBuffers(const IndexedTerrainMesh& mesh, TerrainBuffers& buffers)
+{
+	if (!m_device)
+	{
+		return false;
+	}
+
+	buffers.vertexCount = (int)mesh.vertices.size();
+	buffers.indexCount = (int)mesh.indices.size();
+	buffers.chunks = mesh.chunks;
+
+	if (m_vertexFormat == TERRAIN_VERTEX_QUANTIZED)
+	{
+		// Runs on the job thread, so the encoded copy is local rather than shared scratch
+		std::vector<QuantizedVertex> quantized(mesh.vertices.size());
+		QuantizeVertices(mesh.vertices.data(), mesh.vertices.size(), m_quantization, quantized.data());
+
+		buffers.vertexStride = sizeof(QuantizedVertex);
+		buffers.vertexBuffer = m_device->CreateVertexBuffer(quantized.data(), quantized.size() * sizeof(QuantizedVertex));
+	}
+	else
+	{
+		buffers.vertexStride = sizeof(TerrainVertex);
+		buffers.vertexBuffer = m_device->CreateVertexBuffer(mesh.vertices.data(), mesh.vertices.size() * sizeof(TerrainVertex));
+	}
+	buffers.indexBuffer = m_device->CreateIndexBuffer(mesh.indices.data(), mesh.indices.size() * sizeof(uint16_t));
+
+	if (!buffers.vertexBuffer || !buffers.indexBuffer)
+	{
+		ReleaseBuffers(buffers);
+		return false;
+	}
+
+	return true;
+}
+
+bool TerrainRegenerator::UpdateVertices(const IndexedTerrainMesh& mesh, const std::vector<TerrainVertexRange>& ranges, TerrainBuffers& buffers)
+{
+	if (!m_device || !buffers.vertexBuffer)
+	{
+		return false;
+	}
+
+	bool result = true;
+	for (size_t r = 0; r < ranges.size(); r++)
+	{
+		const TerrainVertexRange& range = ranges[r];
+
+		if (buffers.vertexStride == sizeof(QuantizedVertex))
+		{
+			m_quantizedRange.resize(range.vertexCount);
+			QuantizeVertices(&mesh.vertices[range.firstVertex], range.vertexCount, m_quantization, m_quantizedRange.data());
+			result &= m_device->UpdateBuffer(buffers.vertexBuffer, range.firstVertex * sizeof(QuantizedVertex),
+				m_quantizedRange.data(), range.vertexCount * sizeof(QuantizedVertex));
+		}
+		else
+		{
+			result &= m_device->UpdateBuffer(buffers.vertexBuffer, range.firstVertex * sizeof(TerrainVertex),
+				&mesh.vertices[range.firstVertex], range.vertexCount * sizeof(TerrainVertex));
+		}
+	}
+
+	return result;
+}
+
+void TerrainRegenerator::ReleaseBuffers(TerrainBuffers& buffers)
+{
+	if (m_device)
+	{
+		if (buffers.vertexBuffer)
+		{
+			m_device->ReleaseBuffer(buffers.vertexBuffer);
+		}
+		if (buffers.indexBuffer)
+		{
+			m_device->ReleaseBuffer(buffers.indexBuffer);
+		}
+	}
+
+	buffers.vertexBuffer = nullptr;
+	buffers.indexBuffer = nullptr;
+	buffers.vertexCount = 0;
+	buffers.indexCount = 0;
+	buffers.vertexStride = 0;
+	buffers.chunks.clear();
+}
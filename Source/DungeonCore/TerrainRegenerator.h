@@ -0,0 +1,154 @@
+#pragma once
+
+// Background level regeneration. A job runs the automaton, collectible placement
+// and mesh build on a copy of the map and creates the next pair of GPU buffers,
+// the render thread only swaps them in at a frame boundary.
+
+#include <atomic>
+#include <mutex>
+#include <stddef.h>
+#include <thread>
+#include <vector>
+
+#include "DungeonMap.h"
+#include "QuantizedVertex.h"
+#include "TerrainChunkCache.h"
+#include "TerrainMesh.h"
+#include "WallDistanceField.h"
+
+typedef void* MeshBufferHandle;
+
+// Buffer creation seen by the regenerator. The game wraps ID3D11Device, which is
+// free threaded, so Create* is called from the job thread. Update and Release
+// come from the caller of Swap, which owns the immediate context
+class MeshBufferDevice
+{
+public:
+	virtual ~MeshBufferDevice() {}
+
+	virtual MeshBufferHandle	CreateVertexBuffer(const void* data, size_t bytes) = 0;
+	virtual MeshBufferHandle	CreateIndexBuffer(const void* data, size_t bytes) = 0;
+	virtual bool				UpdateBuffer(MeshBufferHandle buffer, size_t offset, const void* data, size_t bytes) = 0;
+	virtual void				ReleaseBuffer(MeshBufferHandle buffer) = 0;
+};
+
+// Headless stand-in that keeps a copy of every buffer and counts the calls
+class RecordingMeshBufferDevice : public MeshBufferDevice
+{
+public:
+	RecordingMeshBufferDevice();
+	~RecordingMeshBufferDevice();
+
+	MeshBufferHandle	CreateVertexBuffer(const void* data, size_t bytes) override;
+	MeshBufferHandle	CreateIndexBuffer(const void* data, size_t bytes) override;
+	bool				UpdateBuffer(MeshBufferHandle buffer, size_t offset, const void* data, size_t bytes) override;
+	void				ReleaseBuffer(MeshBufferHandle buffer) override;
+
+	int		GetCreatedCount() const;
+	int		GetReleasedCount() const;
+	int		GetUpdateCount() const;
+	size_t	GetUpdatedBytes() const;
+	int		GetLiveCount() const;
+	size_t	GetLiveBytes() const;
+
+	// Bytes of a live buffer, null if it was released or not created here
+	const std::vector<unsigned char>* GetContents(MeshBufferHandle buffer) const;
+
+private:
+	MeshBufferHandle Record(const void* data, size_t bytes);
+
+private:
+	mutable std::mutex							m_mutex;
+	std::vector<std::vector<unsigned char>*>	m_live;
+	int											m_created;
+	int											m_released;
+	int											m_updates;
+	size_t										m_updatedBytes;
+};
+
+// Shared-vertex terrain with 16-bit indices, one DrawIndexed per chunk
+struct TerrainBuffers
+{
+	MeshBufferHandle				vertexBuffer;
+	MeshBufferHandle				indexBuffer;
+	int								vertexCount;
+	int								indexCount;
+	int								vertexStride;
+	std::vector<TerrainMeshChunk>	chunks;
+};
+
+class TerrainRegenerator
+{
+public:
+	TerrainRegenerator();
+	~TerrainRegenerator();
+
+	void SetDevice(MeshBufferDevice* device);
+
+	// Normals for the meshes built by later jobs, waits for a running one
+	void				SetNormalMode(TerrainNormalMode mode);
+	TerrainNormalMode	GetNormalMode() const;
+
+	// Layout of the vertex buffers created from now on, the CPU mesh stays TerrainVertex.
+	// Quantized buffers use MakeTerrainQuantization. Waits for a running job
+	void				SetVertexFormat(TerrainVertexFormat format);
+	TerrainVertexFormat	GetVertexFormat() const;
+
+	// Whether later jobs also bake the wall distance field of their heights. Waits for a running job
+	void	SetBakeWallField(bool bake);
+	bool	GetBakeWallField() const;
+
+	// Starts a job on a copy of (map), generation and collectible parameters included.
+	// False if one is still running
+	bool Request(const DungeonMap& map, int startX, int startZ);
+	bool IsBusy() const;
+
+	// Blocks until the current job has finished, its result stays pending for Swap
+	void Wait();
+
+	// Blocks until the current job has finished and drops its result, buffers included,
+	// so the next Swap has nothing to take. For a resize or a device change
+	void Discard();
+
+	// Call once per frame. If a job has finished its heights, collectibles, buffers and
+	// CPU mesh replace the ones passed in and the old buffers are released. False if nothing was ready,
+	// or if (map) is no longer the size the job generated, in which case its result is dropped.
+	// (field), if given, is exchanged with the job's, which is empty unless it was baked
+	bool Swap(DungeonMap& map, std::vector<DungeonPoint>& collectibles, TerrainBuffers& buffers, IndexedTerrainMesh& mesh,
+		WallDistanceField* field = nullptr);
+
+	// Uploads (mesh) through the device in the current vertex format, false if either buffer could not be created
+	bool CreateBuffers(const IndexedTerrainMesh& mesh, TerrainBuffers& buffers);
+
+	// Uploads the given vertex ranges of (mesh) into (buffers), converted to the format they were created with
+	bool UpdateVertices(const IndexedTerrainMesh& mesh, const std::vector<TerrainVertexRange>& ranges, TerrainBuffers& buffers);
+
+	// Releases a buffer pair created by the device
+	void ReleaseBuffers(TerrainBuffers& buffers);
+
+private:
+	TerrainRegenerator(const TerrainRegenerator&);
+	TerrainRegenerator& operator=(const TerrainRegenerator&);
+
+	void Run(int startX, int startZ);
+	void Join();
+
+private:
+	MeshBufferDevice*			m_device;
+	TerrainNormalMode			m_normalMode;
+	TerrainVertexFormat			m_vertexFormat;
+	VertexQuantization			m_quantization;
+	bool						m_bakeWallField;
+	std::vector<QuantizedVertex> m_quantizedRange;		// Scratch for UpdateVertices
+	std::thread					m_thread;
+	std::atomic<bool>			m_busy;
+	std::atomic<bool>			m_ready;
+
+	// Owned by the job while m_busy is set
+	DungeonMap					m_map;
+	std::vector<DungeonPoint>	m_collectibles;
+	IndexedTerrainMesh			m_mesh;
+	TerrainBuffers				m_buffers;
+	WallDistanceField			m_field;
+	bool						m_succeeded;
+};
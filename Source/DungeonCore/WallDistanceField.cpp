@@ -0,0 +1,356 @@
+#include "WallDistanceField.h"
+#include "DungeonMesher.h"
+
+#include <math.h>
+#include <utility>
+
+
+#define FIELD_INFINITY 1e20
+
+// Distance under which a sweep counts as touching, and the shortest step it takes
+#define FIELD_CONTACT 0.02f
+
+// Bilinear samples of a distance can change up to sqrt(2) times faster than the
+// distance itself, so steps are shortened by its inverse to never cross a wall
+#define FIELD_STEP_SCALE 0.7f
+#define FIELD_MAX_STEPS 64
+
+WallDistanceField::WallDistanceField()
+{
+	m_width = 0;
+	m_height = 0;
+}
+
+bool WallDistanceField::Build(const float* heights, int width, int height)
+{
+	if (!heights || width < 1 || height < 1)
+	{
+		return false;
+	}
+
+	m_width = width + 2;
+	m_height = height + 2;
+
+	int count = m_width * m_height;
+	std::vector<uint8_t> walls(count, 1);
+
+	for (int j = 0; j < height; j++)
+	{
+		for (int i = 0; i < width; i++)
+		{
+			walls[(m_width * (j + 1)) + i + 1] = IsDungeonWall(heights[(width * j) + i]) ? 1 : 0;
+		}
+	}
+
+	int longest = m_width > m_height ? m_width : m_height;
+	m_line.resize(longest);
+	m_result.resize(longest);
+	m_boundaries.resize(longest);
+	m_parabolas.resize(longest);
+
+	Transform(walls, 1, m_field);
+	Transform(walls, 0, m_inside);
+
+	// Centre distances to surface distances, a wall cell being the disc of radius 0.5
+	for (int c = 0; c < count; c++)
+	{
+		m_field[c] = walls[c] ? 0.5f - sqrtf(m_inside[c]) : sqrtf(m_field[c]) - 0.5f;
+	}
+
+	return true;
+}
+
+void WallDistanceField::Clear()
+{
+	m_width = 0;
+	m_height = 0;
+	m_field.clear();
+	m_inside.clear();
+}
+
+void WallDistanceField::Swap(WallDistanceField& other)
+{
+	std::swap(m_width, other.m_width);
+	std::swap(m_height, other.m_height);
+	m_field.swap(other.m_field);
+	m_inside.swap(other.m_inside);
+	m_line.swap(other.m_line);
+	m_result.swap(other.m_result);
+	m_boundaries.swap(other.m_boundaries);
+	m_parabolas.swap(other.m_parabolas);
+}
+
+bool WallDistanceField::IsBuilt() const
+{
+	return !m_field.empty();
+}
+
+// Squared distance to the nearest (feature) cell. Along columns the input is binary, so
+// two sweeps over whole rows count the cells to the nearest feature above and below
+// (the first phase of Meijster's transform), which keeps every pass in memory order.
+// The rows then take the general parabola envelope
+void WallDistanceField::Transform(const std::vector<uint8_t>& features, uint8_t feature, std::vector<float>& distance)
+{
+	distance.resize(m_width * m_height);
+
+	for (int j = 0; j < m_height; j++)
+	{
+		const uint8_t* cells = &features[m_width * j];
+		float* row = &distance[m_width * j];
+		const float* above = j > 0 ? row - m_width : nullptr;
+
+		for (int i = 0; i < m_width; i++)
+		{
+			row[i] = cells[i] == feature ? 0.0f : (above && above[i] < (float)FIELD_INFINITY ? above[i] + 1.0f : (float)FIELD_INFINITY);
+		}
+	}
+
+	for (int j = m_height - 2; j >= 0; j--)
+	{
+		float* row = &distance[m_width * j];
+		const float* below = row + m_width;
+
+		for (int i = 0; i < m_width; i++)
+		{
+			row[i] = below[i] + 1.0f < row[i] ? below[i] + 1.0f : row[i];
+		}
+	}
+
+	for (int j = 0; j < m_height; j++)
+	{
+		float* row = &distance[m_width * j];
+
+		for (int i = 0; i < m_width; i++)
+		{
+			m_line[i] = row[i] < (float)FIELD_INFINITY ? (double)row[i] * row[i] : FIELD_INFINITY;
+		}
+
+		TransformLine(m_width);
+
+		for (int i = 0; i < m_width; i++)
+		{
+			row[i] = (float)m_result[i];
+		}
+	}
+}
+
+// Lower envelope of the parabolas (q - p)^2 + line[p], one per finite sample, then
+// read off at every q. Boundaries are where each parabola starts being the lowest
+void WallDistanceField::TransformLine(int count)
+{
+	int last = -1;
+
+	for (int q = 0; q < count; q++)
+	{
+		if (m_line[q] >= FIELD_INFINITY)
+		{
+			continue;
+		}
+
+		double start = -FIELD_INFINITY;
+		while (last >= 0)
+		{
+			int p = m_parabolas[last];
+			start = ((m_line[q] + ((double)q * q)) - (m_line[p] + ((double)p * p))) / (2.0 * (q - p));
+			if (start > m_boundaries[last])
+			{
+				break;
+			}
+			last--;
+		}
+
+		last++;
+		m_parabolas[last] = q;
+		m_boundaries[last] = last == 0 ? -FIELD_INFINITY : start;
+	}
+
+	if (last < 0)
+	{
+		for (int q = 0; q < count; q++)
+		{
+			m_result[q] = FIELD_INFINITY;
+		}
+		return;
+	}
+
+	int current = 0;
+	for (int q = 0; q < count; q++)
+	{
+		while (current < last && m_boundaries[current + 1] < q)
+		{
+			current++;
+		}
+
+		int p = m_parabolas[current];
+		m_result[q] = ((double)(q - p) * (q - p)) + m_line[p];
+	}
+}
+
+float WallDistanceField::Sample(float x, float z, float& normalX, float& normalZ) const
+{
+	// Cell (i, j)'s centre is at field sample (i + 1, j + 1), off the map clamps to the border
+	float gx = x + 1.0f;
+	float gz = z + 1.0f;
+	gx = gx < 0.0f ? 0.0f : (gx > m_width - 1 ? (float)(m_width - 1) : gx);
+	gz = gz < 0.0f ? 0.0f : (gz > m_height - 1 ? (float)(m_height - 1) : gz);
+
+	int i = (int)gx < m_width - 2 ? (int)gx : m_width - 2;
+	int j = (int)gz < m_height - 2 ? (int)gz : m_height - 2;
+	float fx = gx - i;
+	float fz = gz - j;
+
+	const float* row = &m_field[(m_width * j) + i];
+	float f00 = row[0], f10 = row[1];
+	float f01 = row[m_width], f11 = row[m_width + 1];
+
+	float gradientX = ((1.0f - fz) * (f10 - f00)) + (fz * (f11 - f01));
+	float gradientZ = ((1.0f - fx) * (f01 - f00)) + (fx * (f11 - f10));
+	float length = sqrtf((gradientX * gradientX) + (gradientZ * gradientZ));
+
+	normalX = length > 0.0f ? gradientX / length : 0.0f;
+	normalZ = length > 0.0f ? gradientZ / length : 0.0f;
+
+	return ((1.0f - fz) * (((1.0f - fx) * f00) + (fx * f10))) + (fz * (((1.0f - fx) * f01) + (fx * f11)));
+}
+
+float WallDistanceField::Distance(float x, float z) const
+{
+	float normalX, normalZ;
+	return Sample(x, z, normalX, normalZ);
+}
+
+bool WallDistanceField::Overlaps(float x, float z, float radius) const
+{
+	return Distance(x, z) < radius;
+}
+
+bool WallDistanceField::SweepCircle(float x, float z, float radius, float dx, float dz, WallHit& hit) const
+{
+	hit.time = 2.0f;
+
+	float length = sqrtf((dx * dx) + (dz * dz));
+	if (m_field.empty() || length == 0.0f || !(length < 1e30f))
+	{
+		return false;
+	}
+
+	float t = 0.0f, previous = 0.0f;
+	float normalX, normalZ;
+	float gap = Sample(x, z, normalX, normalZ) - radius;
+
+	for (int step = 0; step < FIELD_MAX_STEPS; step++)
+	{
+		// Touching counts only while moving further in, as for WallGrid
+		bool touching = gap < FIELD_CONTACT && ((dx * normalX) + (dz * normalZ)) < 0.0f;
+		if (touching || step == FIELD_MAX_STEPS - 1)
+		{
+			// A minimum step may have gone slightly in, report the last point outside
+			hit.time = gap < 0.0f && step > 0 ? previous : t;
+			hit.normalX = normalX;
+			hit.normalZ = normalZ;
+			hit.cellX = (int)floorf(x + (dx * t) - (normalX * (radius + 0.5f)) + 0.5f);
+			hit.cellZ = (int)floorf(z + (dz * t) - (normalZ * (radius + 0.5f)) + 0.5f);
+			return true;
+		}
+
+		if (t >= 1.0f)
+		{
+			return false;
+		}
+
+		previous = t;
+		t += (gap > FIELD_CONTACT ? gap : FIELD_CONTACT) * FIELD_STEP_SCALE / length;
+		t = t < 1.0f ? t : 1.0f;
+
+		gap = Sample(x + (dx * t), z + (dz * t), normalX, normalZ) - radius;
+	}
+
+	return false;
+}
+
+WallFieldBaker::WallFieldBaker()
+{
+	m_busy = false;
+	m_ready = false;
+	m_discard = false;
+	m_width = 0;
+	m_height = 0;
+	m_succeeded = false;
+}
+
+WallFieldBaker::~WallFieldBaker()
+{
+	Join();
+}
+
+bool WallFieldBaker::Request(const float* heights, int width, int height)
+{
+	if (m_busy || !heights || width < 1 || height < 1)
+	{
+		return false;
+	}
+
+	// A finished field nobody swapped in is superseded
+	Join();
+	m_ready = false;
+	m_discard = false;
+
+	m_heights.assign(heights, heights + ((size_t)width * height));
+	m_width = width;
+	m_height = height;
+	m_busy = true;
+	m_thread = std::thread(&WallFieldBaker::Run, this);
+
+	return true;
+}
+
+bool WallFieldBaker::IsBusy() const
+{
+	return m_busy;
+}
+
+void WallFieldBaker::Wait()
+{
+	Join();
+}
+
+void WallFieldBaker::Discard()
+{
+	m_discard = m_busy || m_ready;
+}
+
+void WallFieldBaker::Join()
+{
+	if (m_thread.joinable())
+	{
+		m_thread.join();
+	}
+}
+
+void WallFieldBaker::Run()
+{
+	m_succeeded = m_field.Build(m_heights.data(), m_width, m_height);
+
+	m_ready = true;
+	m_busy = false;
+}
+
+bool WallFieldBaker::Swap(WallDistanceField& field)
+{
+	if (!m_ready)
+	{
+		return false;
+	}
+
+	Join();
+	m_ready = false;
+
+	if (!m_succeeded || m_discard)
+	{
+		m_discard = false;
+		return false;
+	}
+
+	field.Swap(m_field);
+	return true;
+}
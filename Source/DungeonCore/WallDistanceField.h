@@ -0,0 +1,97 @@
+#pragma once
+
+// Signed distance to the walls of a dungeon map, sampled at every cell centre:
+// positive on the floor, negative inside walls. Each wall cell counts as the disc
+// inscribed in its square, which matches the square along straight walls and rounds
+// the corners off by up to 0.2 cells. Baked with an exact linear-time Euclidean
+// distance transform (sweeps down the columns, then the Felzenszwalb-Huttenlocher
+// parabola envelope along the rows), once for the walls and once for the floor.
+// A one-cell wall border around the map stands in for everything off it. Lookups
+// are bilinear, so a circle test is one sample however large the circle, and the
+// gradient of the same sample is the contact normal.
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "DungeonMap.h"
+#include "WallGrid.h"
+
+class WallDistanceField
+{
+public:
+	WallDistanceField();
+
+	bool Build(const float* heights, int width, int height);
+	void Clear();
+	bool IsBuilt() const;
+
+	// Exchanges fields with (other), scratch included
+	void Swap(WallDistanceField& other);
+
+	// Cells from (x, z) to the nearest wall surface, negative inside a wall
+	float Distance(float x, float z) const;
+
+	// Distance plus its unit gradient, which points away from the nearest wall
+	float Sample(float x, float z, float& normalX, float& normalZ) const;
+
+	bool Overlaps(float x, float z, float radius) const;
+
+	// Same contract as WallGrid::SweepCircle. Steps along the movement by the distance
+	// to the nearest wall (conservative advancement), so a move costs a few samples
+	// in open space and stays in bounds for any step length
+	bool SweepCircle(float x, float z, float radius, float dx, float dz, WallHit& hit) const;
+
+private:
+	void Transform(const std::vector<uint8_t>& features, uint8_t feature, std::vector<float>& distance);
+	void TransformLine(int count);
+
+private:
+	int					m_width, m_height;	// Including the border
+	std::vector<float>	m_field;
+	std::vector<float>	m_inside;			// Squared distances to the nearest floor cell while building
+
+	// Scratch for the 1D transform
+	std::vector<float>	m_line, m_result, m_boundaries;
+	std::vector<int>	m_parabolas;
+};
+
+// Bakes fields on a job thread from a copy of the heights, so an edit never stalls the
+// frame for a whole-map transform. The caller keeps its current field until Swap hands
+// the new one over
+class WallFieldBaker
+{
+public:
+	WallFieldBaker();
+	~WallFieldBaker();
+
+	// Starts a bake of a copy of (heights), false if one is still running
+	bool Request(const float* heights, int width, int height);
+	bool IsBusy() const;
+	void Wait();
+
+	// Drops the running or finished bake, its heights are out of date. Does not wait
+	void Discard();
+
+	// If a bake has finished, exchanges it with (field). False if nothing was ready
+	bool Swap(WallDistanceField& field);
+
+private:
+	WallFieldBaker(const WallFieldBaker&);
+	WallFieldBaker& operator=(const WallFieldBaker&);
+
+	void Run();
+	void Join();
+
+private:
+	std::thread			m_thread;
+	std::atomic<bool>	m_busy;
+	std::atomic<bool>	m_ready;
+	bool				m_discard;
+
+	// Owned by the job while m_busy is set
+	std::vector<float>	m_heights;
+	int					m_width, m_height;
+	WallDistanceField	m_field;
+	bool				m_succeeded;
+};
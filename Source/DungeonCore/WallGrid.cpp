@@ -0,0 +1,327 @@
+#include "WallGrid.h"
+#include "DungeonMesher.h"
+
+#include <math.h>
+
+
+WallGrid::WallGrid()
+{
+	m_width = 0;
+	m_height = 0;
+}
+
+bool WallGrid::Build(const float* heights, int width, int height)
+{
+	if (!heights || width < 1 || height < 1)
+	{
+		return false;
+	}
+
+	m_width = width;
+	m_height = height;
+	m_walls.resize(width * height);
+
+	DungeonRect all = { 0, 0, width - 1, height - 1 };
+	Update(heights, all);
+	return true;
+}
+
+void WallGrid::Update(const float* heights, const DungeonRect& rect)
+{
+	int x0 = rect.x0 > 0 ? rect.x0 : 0;
+	int z0 = rect.z0 > 0 ? rect.z0 : 0;
+	int x1 = rect.x1 < m_width - 1 ? rect.x1 : m_width - 1;
+	int z1 = rect.z1 < m_height - 1 ? rect.z1 : m_height - 1;
+
+	for (int j = z0; j <= z1; j++)
+	{
+		for (int i = x0; i <= x1; i++)
+		{
+			int index = (m_width * j) + i;
+			m_walls[index] = IsDungeonWall(heights[index]) ? 1 : 0;
+		}
+	}
+}
+
+bool WallGrid::IsWall(int i, int j) const
+{
+	if (i < 0 || j < 0 || i >= m_width || j >= m_height)
+	{
+		return true;
+	}
+	return m_walls[(m_width * j) + i] != 0;
+}
+
+static float Clamp(float value, float low, float high)
+{
+	return value < low ? low : (value > high ? high : value);
+}
+
+bool WallGrid::Overlaps(float x, float z, float radius) const
+{
+	int reach = (int)radius + 1;
+	int ci = (int)floorf(x + 0.5f);
+	int cj = (int)floorf(z + 0.5f);
+
+	for (int j = cj - reach; j <= cj + reach; j++)
+	{
+		for (int i = ci - reach; i <= ci + reach; i++)
+		{
+			if (!IsWall(i, j))
+			{
+				continue;
+			}
+
+			float vx = x - Clamp(x, i - 0.5f, i + 0.5f);
+			float vz = z - Clamp(z, j - 0.5f, j + 0.5f);
+			if ((vx * vx) + (vz * vz) < radius * radius || (vx == 0.0f && vz == 0.0f))
+			{
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+// Circle against the square of cell (i, j), which is the square grown by the radius with
+// rounded corners. Only contacts earlier than hit.time are written
+bool WallGrid::SweepCell(float x, float z, float radius, float dx, float dz, int i, int j, WallHit& hit) const
+{
+	float bx0 = i - 0.5f, bx1 = i + 0.5f;
+	float bz0 = j - 0.5f, bz1 = j + 0.5f;
+	float time, normalX, normalZ;
+
+	float vx = x - Clamp(x, bx0, bx1);
+	float vz = z - Clamp(z, bz0, bz1);
+	float distance2 = (vx * vx) + (vz * vz);
+
+	if (vx == 0.0f && vz == 0.0f)
+	{
+		// Centre inside the square, push out through the nearest side
+		float sides[4] = { x - bx0, bx1 - x, z - bz0, bz1 - z };
+		int nearest = 0;
+		for (int s = 1; s < 4; s++)
+		{
+			nearest = sides[s] < sides[nearest] ? s : nearest;
+		}
+
+		normalX = nearest == 0 ? -1.0f : (nearest == 1 ? 1.0f : 0.0f);
+		normalZ = nearest == 2 ? -1.0f : (nearest == 3 ? 1.0f : 0.0f);
+		time = 0.0f;
+	}
+	else if (distance2 < radius * radius)
+	{
+		float distance = sqrtf(distance2);
+		normalX = vx / distance;
+		normalZ = vz / distance;
+		time = 0.0f;
+	}
+	else
+	{
+		// Slabs of the square grown by the radius, the entering side gives the face normal
+		float enter = -1.0f, exit = 1.0f;
+		normalX = 0.0f;
+		normalZ = 0.0f;
+
+		const float position[2] = { x, z };
+		const float delta[2] = { dx, dz };
+		const float low[2] = { bx0 - radius, bz0 - radius };
+		const float high[2] = { bx1 + radius, bz1 + radius };
+		int axis = -1;
+
+		for (int a = 0; a < 2; a++)
+		{
+			if (delta[a] == 0.0f)
+			{
+				if (position[a] < low[a] || position[a] > high[a])
+				{
+					return false;
+				}
+				continue;
+			}
+
+			float t0 = (low[a] - position[a]) / delta[a];
+			float t1 = (high[a] - position[a]) / delta[a];
+			if (t0 > t1)
+			{
+				float swap = t0;
+				t0 = t1;
+				t1 = swap;
+			}
+
+			if (t0 > enter)
+			{
+				enter = t0;
+				axis = a;
+			}
+			exit = t1 < exit ? t1 : exit;
+		}
+
+		if (enter > exit || enter > 1.0f || exit < 0.0f)
+		{
+			return false;
+		}
+
+		float hx = enter > 0.0f ? x + (dx * enter) : x;
+		float hz = enter > 0.0f ? z + (dz * enter) : z;
+
+		if (enter >= 0.0f && axis == 0 && hz >= bz0 && hz <= bz1)
+		{
+			time = enter;
+			normalX = dx > 0.0f ? -1.0f : 1.0f;
+		}
+		else if (enter >= 0.0f && axis == 1 && hx >= bx0 && hx <= bx1)
+		{
+			time = enter;
+			normalZ = dz > 0.0f ? -1.0f : 1.0f;
+		}
+		else
+		{
+			// Entered the grown square beside a corner, the contact is on the corner's circle
+			if (radius <= 0.0f)
+			{
+				return false;
+			}
+
+			float cx = hx < (float)i ? bx0 : bx1;
+			float cz = hz < (float)j ? bz0 : bz1;
+			float px = x - cx, pz = z - cz;
+
+			float a = (dx * dx) + (dz * dz);
+			float b = (px * dx) + (pz * dz);
+			float c = (px * px) + (pz * pz) - (radius * radius);
+			float discriminant = (b * b) - (a * c);
+			if (discriminant < 0.0f || b >= 0.0f)
+			{
+				return false;
+			}
+
+			time = (-b - sqrtf(discriminant)) / a;
+			if (time < 0.0f || time > 1.0f)
+			{
+				return false;
+			}
+
+			normalX = (px + (dx * time)) / radius;
+			normalZ = (pz + (dz * time)) / radius;
+		}
+	}
+
+	// Touching walls the movement leaves or slides along do not stop it
+	if ((dx * normalX) + (dz * normalZ) >= 0.0f || time >= hit.time)
+	{
+		return false;
+	}
+
+	hit.time = time;
+	hit.normalX = normalX;
+	hit.normalZ = normalZ;
+	hit.cellX = i;
+	hit.cellZ = j;
+	return true;
+}
+
+bool WallGrid::SweepCircle(float x, float z, float radius, float dx, float dz, WallHit& hit) const
+{
+	hit.time = 2.0f;
+
+	if (m_walls.empty() || !(fabsf(x) + fabsf(z) + fabsf(dx) + fabsf(dz) < 1e30f))
+	{
+		return false;
+	}
+
+	// Walls within this many cells of the centre's cell can touch the circle
+	int reach = (int)radius + 1;
+
+	int ci = (int)floorf(x + 0.5f);
+	int cj = (int)floorf(z + 0.5f);
+	int endI = (int)floorf(x + dx + 0.5f);
+	int endJ = (int)floorf(z + dz + 0.5f);
+
+	int stepI = dx > 0.0f ? 1 : (dx < 0.0f ? -1 : 0);
+	int stepJ = dz > 0.0f ? 1 : (dz < 0.0f ? -1 : 0);
+
+	// Movement fractions at which the centre crosses into the next column and row
+	float nextI = stepI != 0 ? ((ci + (0.5f * stepI)) - x) / dx : 2.0f;
+	float nextJ = stepJ != 0 ? ((cj + (0.5f * stepJ)) - z) / dz : 2.0f;
+	float deltaI = stepI != 0 ? 1.0f / fabsf(dx) : 2.0f;
+	float deltaJ = stepJ != 0 ? 1.0f / fabsf(dz) : 2.0f;
+	float entered = 0.0f;
+
+	// Cells come in order of the time the centre reaches them, and a contact at time t
+	// is within reach of the cell the centre is in at t, so stop once past the best one
+	while (entered <= 1.0f && entered <= hit.time)
+	{
+		for (int j = cj - reach; j <= cj + reach; j++)
+		{
+			for (int i = ci - reach; i <= ci + reach; i++)
+			{
+				if (IsWall(i, j))
+				{
+					SweepCell(x, z, radius, dx, dz, i, j, hit);
+				}
+			}
+		}
+
+		if (ci == endI && cj == endJ)
+		{
+			break;
+		}
+
+		if (nextI < nextJ)
+		{
+			entered = nextI;
+			nextI += deltaI;
+			ci += stepI;
+		}
+		else
+		{
+			entered = nextJ;
+			nextJ += deltaJ;
+			cj += stepJ;
+		}
+	}
+
+	return hit.time <= 1.0f;
+}
+
+bool WallGrid::Raycast(float x, float z, float dx, float dz, WallHit& hit) const
+{
+	return SweepCircle(x, z, 0.0f, dx, dz, hit);
+}
+
+bool WallGrid::Slide(float& x, float& z, float radius, float dx, float dz, int iterations) const
+{
+	bool blocked = false;
+
+	for (int contact = 0; contact < iterations; contact++)
+	{
+		WallHit hit;
+		if (!SweepCircle(x, z, radius, dx, dz, hit))
+		{
+			x += dx;
+			z += dz;
+			return !blocked;
+		}
+		blocked = true;
+
+		// Stop just short of the wall, then keep the part of the rest that runs along it
+		x += (dx * hit.time) + (hit.normalX * WALL_SKIN);
+		z += (dz * hit.time) + (hit.normalZ * WALL_SKIN);
+
+		float restX = dx * (1.0f - hit.time);
+		float restZ = dz * (1.0f - hit.time);
+		float into = (restX * hit.normalX) + (restZ * hit.normalZ);
+
+		dx = restX - (hit.normalX * into);
+		dz = restZ - (hit.normalZ * into);
+
+		if (dx == 0.0f && dz == 0.0f)
+		{
+			break;
+		}
+	}
+
+	return false;
+}
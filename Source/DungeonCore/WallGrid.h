@@ -0,0 +1,58 @@
+#pragma once
+
+// Wall occupancy of a dungeon map with swept queries against it. Cell (i, j) is a
+// wall square spanning [i - 0.5, i + 0.5] x [j - 0.5, j + 0.5], the same squares the
+// block mesher draws, and everything off the map counts as wall. A sweep walks the
+// cells under the moving centre in order (a DDA traversal) and tests the wall cells
+// within reach of the radius, so its cost grows with the distance travelled, not the
+// map size, and nothing can pass through a wall however far it moves in one step.
+
+#include <stdint.h>
+#include <vector>
+
+#include "DungeonMap.h"
+
+// Gap kept between a slid circle and the wall it stopped against
+#define WALL_SKIN 0.001f
+
+struct WallHit
+{
+	float	time;				// Fraction of the movement completed before contact, 0 to 1
+	float	normalX, normalZ;	// Unit normal of the wall surface at the contact
+	int		cellX, cellZ;		// Wall cell that was hit
+};
+
+class WallGrid
+{
+public:
+	WallGrid();
+
+	bool Build(const float* heights, int width, int height);
+
+	// Refreshes the cells of (rect) after an edit
+	void Update(const float* heights, const DungeonRect& rect);
+
+	bool IsWall(int i, int j) const;
+	int GetWidth() const	{ return m_width; }
+	int GetHeight() const	{ return m_height; }
+
+	// True if a circle at (x, z) overlaps a wall
+	bool Overlaps(float x, float z, float radius) const;
+
+	// First contact of a circle moved from (x, z) by (dx, dz). Walls it already overlaps
+	// only count while the movement goes further into them, so a circle that starts
+	// inside a wall can still leave it
+	bool SweepCircle(float x, float z, float radius, float dx, float dz, WallHit& hit) const;
+	bool Raycast(float x, float z, float dx, float dz, WallHit& hit) const;
+
+	// Moves the circle by (dx, dz), sliding along every wall it meets, at most
+	// (iterations) contacts. Returns false if the movement was blocked at least once
+	bool Slide(float& x, float& z, float radius, float dx, float dz, int iterations = 3) const;
+
+private:
+	bool SweepCell(float x, float z, float radius, float dx, float dz, int i, int j, WallHit& hit) const;
+
+private:
+	int						m_width, m_height;
+	std::vector<uint8_t>	m_walls;
+};
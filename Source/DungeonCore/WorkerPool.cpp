@@ -0,0 +1,212 @@
+#include "WorkerPool.h"
+
+
+WorkerPool::WorkerPool(int threads)
+{
+	m_task = nullptr;
+	m_busy = 0;
+	m_generation = 0;
+	m_quit = false;
+
+	if (threads <= 0)
+	{
+		threads = HardwareThreads();
+	}
+
+	std::vector<TaskRange> ranges(threads);
+	m_ranges.swap(ranges);
+	for (int i = 0; i < threads; i++)
+	{
+		m_ranges[i].range = 0;
+	}
+
+	// The caller is the first thread
+	for (int i = 1; i < threads; i++)
+	{
+		m_threads.push_back(std::thread(&WorkerPool::WorkerLoop, this, i));
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+	}
+	m_wake.notify_all();
+
+	for (size_t i = 0; i < m_threads.size(); i++)
+	{
+		m_threads[i].join();
+	}
+}
+
+int WorkerPool::GetThreadCount() const
+{
+	return (int)m_threads.size() + 1;
+}
+
+int WorkerPool::HardwareThreads()
+{
+	unsigned int count = std::thread::hardware_concurrency();
+	return count > 0 ? (int)count : 1;
+}
+
+// A few bands per thread so uneven rows still balance
+int WorkerPool::BandCount(int begin, int end, int minRows) const
+{
+	int rows = end - begin;
+	if (rows <= 0)
+	{
+		return 0;
+	}
+
+	int bands = GetThreadCount() * 4;
+	int maxBands = (rows + minRows - 1) / minRows;
+
+	return bands < maxBands ? bands : maxBands;
+}
+
+void WorkerPool::BandRange(int band, int bands, int begin, int end, int& bandBegin, int& bandEnd)
+{
+	int rows = end - begin;
+
+	bandBegin = begin + (int)(((int64_t)rows * band) / bands);
+	bandEnd = begin + (int)(((int64_t)rows * (band + 1)) / bands);
+}
+
+void WorkerPool::ParallelFor(int count, const std::function<void(int)>& task)
+{
+	if (count <= 0)
+	{
+		return;
+	}
+
+	if (m_threads.empty() || count == 1)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			task(i);
+		}
+		return;
+	}
+
+	std::lock_guard<std::mutex> call(m_callMutex);
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_task = &task;
+
+		int threads = GetThreadCount();
+		for (int i = 0; i < threads; i++)
+		{
+			int begin, end;
+			BandRange(i, threads, 0, count, begin, end);
+			m_ranges[i].range = ((uint64_t)begin << 32) | (uint32_t)end;
+		}
+
+		m_busy = (int)m_threads.size();
+		m_generation++;
+	}
+	m_wake.notify_all();
+
+	RunTasks(0);
+
+	// Workers must be finished with (task) before it goes out of scope
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_done.wait(lock, [this] { return m_busy == 0; });
+	m_task = nullptr;
+}
+
+void WorkerPool::RunTasks(int thread)
+{
+	int index;
+	while (PopTask(thread, index) || StealTask(thread, index))
+	{
+		(*m_task)(index);
+	}
+}
+
+bool WorkerPool::PopTask(int thread, int& index)
+{
+	std::atomic<uint64_t>& slot = m_ranges[thread].range;
+	uint64_t range = slot.load();
+
+	for (;;)
+	{
+		uint32_t begin = (uint32_t)(range >> 32);
+		uint32_t end = (uint32_t)range;
+		if (begin >= end)
+		{
+			return false;
+		}
+
+		if (slot.compare_exchange_weak(range, ((uint64_t)(begin + 1) << 32) | end))
+		{
+			index = (int)begin;
+			return true;
+		}
+	}
+}
+
+// Takes the back half of the first run found with work left, runs its first index and
+// keeps the rest as this thread's own. Indices only ever leave a run, so a range value
+// seen once can never come back and fool a compare exchange
+bool WorkerPool::StealTask(int thread, int& index)
+{
+	int threads = (int)m_ranges.size();
+
+	for (int offset = 1; offset < threads; offset++)
+	{
+		std::atomic<uint64_t>& slot = m_ranges[(thread + offset) % threads].range;
+		uint64_t range = slot.load();
+
+		for (;;)
+		{
+			uint32_t begin = (uint32_t)(range >> 32);
+			uint32_t end = (uint32_t)range;
+			if (begin >= end)
+			{
+				break;
+			}
+
+			uint32_t middle = begin + ((end - begin) / 2);
+			if (slot.compare_exchange_weak(range, ((uint64_t)begin << 32) | middle))
+			{
+				index = (int)middle;
+				m_ranges[thread].range = ((uint64_t)(middle + 1) << 32) | end;
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+void WorkerPool::WorkerLoop(int thread)
+{
+	uint64_t seen = 0;
+
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [this, seen] { return m_quit || m_generation != seen; });
+			if (m_quit)
+			{
+				return;
+			}
+			seen = m_generation;
+		}
+
+		RunTasks(thread);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (--m_busy == 0)
+			{
+				m_done.notify_one();
+			}
+		}
+	}
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+// Fixed set of worker threads for splitting grid passes into bands.
+// ParallelFor blocks until every index has run, the calling thread helps out.
+// Calls from different threads (map copies share a pool) run one after another.
+// Each thread starts on its own contiguous run of indices, so neighbouring bands stay
+// on one thread, and a thread that runs out steals the back half of another's run.
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+class WorkerPool
+{
+public:
+	// (threads) includes the calling thread, 0 uses every hardware thread
+	explicit WorkerPool(int threads);
+	~WorkerPool();
+
+	int GetThreadCount() const;
+
+	void ParallelFor(int count, const std::function<void(int)>& task);
+
+	// Splits rows [begin, end) into bands of at least (minRows) for this pool
+	int BandCount(int begin, int end, int minRows) const;
+	static void BandRange(int band, int bands, int begin, int end, int& bandBegin, int& bandEnd);
+
+	static int HardwareThreads();
+
+private:
+	WorkerPool(const WorkerPool&);
+	WorkerPool& operator=(const WorkerPool&);
+
+	void WorkerLoop(int thread);
+	void RunTasks(int thread);
+	bool PopTask(int thread, int& index);
+	bool StealTask(int thread, int& index);
+
+private:
+	std::vector<std::thread>			m_threads;
+	std::mutex							m_callMutex;
+	std::mutex							m_mutex;
+	std::condition_variable				m_wake;
+	std::condition_variable				m_done;
+
+	// Indices [begin, end) left to a thread, packed as begin << 32 | end and padded
+	// to a cache line. The owner takes from the front, thieves from the back
+	struct TaskRange
+	{
+		std::atomic<uint64_t>	range;
+		char					padding[64 - sizeof(std::atomic<uint64_t>)];
+	};
+
+	const std::function<void(int)>*		m_task;
+	std::vector<TaskRange>				m_ranges;
+	int									m_busy;
+	uint64_t							m_generation;
+	bool								m_quit;
+};
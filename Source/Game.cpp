@@ -196,7 +196,8 @@ void Game::Update(DX::StepTimer const& timer)
 	m_Camera01.Update();	//camera updates
     m_MapCamera.Update();
 
-	m_Terrain.Update();		//terrain update.  doesnt do anything at the moment. 
+	m_Terrain.Update();		//terrain update, swaps in regenerated levels and uploads edits
+	m_Terrain.SelectLod(m_Camera01.getPosition());
     m_Physics.Update(d_time);
 
 	m_view = m_Camera01.getCameraMatrix();
@@ -298,6 +299,24 @@ void Game::Render()
     m_deviceResources->Present();
 }
 
+// Draws the terrain with m_world, picking the shader that matches its vertex format
+void Game::RenderTerrain(ID3D11DeviceContext* context, DirectX::SimpleMath::Matrix* view)
+{
+    Shader& shader = m_Terrain.IsQuantized() ? m_QuantizedShaderPair : m_BasicShaderPair;
+
+    shader.EnableShader(context);
+    shader.SetShaderParameters(context, &m_world, view, &m_projection, &m_Light, m_texture1.Get());
+
+    if (m_Terrain.IsQuantized())
+    {
+        float origin[3], scale[3];
+        m_Terrain.GetPositionDequantization(origin, scale);
+        shader.SetPositionDequantization(context, origin, scale);
+    }
+
+    m_Terrain.Render(context);
+}
+
 // Render Setting to separate texture for mini-map effect
 void Game::RenderToTexture()
 {
@@ -318,9 +337,7 @@ void Game::RenderToTexture()
     m_world = m_world * newScale * newPosition3;
 
     //setup and draw cube
-    m_BasicShaderPair.EnableShader(context);
-    m_BasicShaderPair.SetShaderParameters(context, &m_world, &m_mapView, &m_projection, &m_Light, m_texture1.Get());
-    m_Terrain.Render(context);
+    RenderTerrain(context, &m_mapView);
 
     // Render Player icon
     m_world = SimpleMath::Matrix::Identity; //set world back to identity
@@ -334,9 +351,9 @@ void Game::RenderToTexture()
 
 
     // Render Collectibles
-    for (int i = 0; i < COLLECTIBLE_COUNT; i++)
+    for (int i = 0; i < m_Terrain.GetPlacedCollectibles(); i++)
     {
-        Vector3 currRender = m_Terrain.getCollectibles()[i];
+        Vector3 currRender = m_Terrain.GetCollectible(i);
 
         m_world = SimpleMath::Matrix::Identity; //set world back to identity
         SimpleMath::Matrix collPosition = SimpleMath::Matrix::CreateTranslation(currRender);
@@ -371,15 +388,13 @@ void Game::RenderSceneToTexture()
     m_world = m_world * newScale * newPosition3;
 
     //setup and draw cube
-    m_BasicShaderPair.EnableShader(context);
-    m_BasicShaderPair.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, m_texture1.Get());
-    m_Terrain.Render(context);
+    RenderTerrain(context, &m_view);
 
 
     // Render Collectibles
-    for (int i = 0; i < COLLECTIBLE_COUNT; i++)
+    for (int i = 0; i < m_Terrain.GetPlacedCollectibles(); i++)
     {
-        Vector3 currRender = m_Terrain.getCollectibles()[i];
+        Vector3 currRender = m_Terrain.GetCollectible(i);
 
         m_world = SimpleMath::Matrix::Identity; //set world back to identity
         SimpleMath::Matrix collPosition = SimpleMath::Matrix::CreateTranslation(currRender);
@@ -393,49 +408,65 @@ void Game::RenderSceneToTexture()
         m_BasicModel3.Render(context);
     }
 
-    //prepare transform for physics object. 
-    m_world = SimpleMath::Matrix::Identity; //set world back to identity
-    SimpleMath::Matrix physicsPosition = SimpleMath::Matrix::CreateTranslation(m_Physics.GetActivePosition());
+    //prepare transforms for physics objects, balls roll and boxes slide
+    for (int body = 0; body < m_Physics.GetBodyCount(); body++)
+    {
+        Vector3 velocity = m_Physics.GetVelocity(body);
 
+        m_world = SimpleMath::Matrix::Identity; //set world back to identity
+        SimpleMath::Matrix physicsPosition = SimpleMath::Matrix::CreateTranslation(m_Physics.GetRenderPosition(body));
 
-    // Get perpendicular axis
-    Vector3 rotationAxis;
-    if (m_Physics.GetActiveVelocity().z == 0)
-    {
-        rotationAxis.x = 0;
-    }
-    else
-    {
-        rotationAxis.x = m_Physics.GetActiveVelocity().z / m_Physics.GetActiveVelocity().z;
-    }
+        if (m_Physics.IsBox(body))
+        {
+            // Box model is 1x1x1
+            m_world *= Matrix::CreateScale(m_Physics.GetRadius(body) * 2.0f);
+            m_world *= physicsPosition;
+
+            m_BasicShaderPair.EnableShader(context);
+            m_BasicShaderPair.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, m_texture3.Get());
+            m_BasicModel3.Render(context);
+            continue;
+        }
 
-    if (m_Physics.GetActiveVelocity().x == 0)
-    {
-        rotationAxis.z = 0;
-    }
-    else
-    {
-        rotationAxis.z = -m_Physics.GetActiveVelocity().x / m_Physics.GetActiveVelocity().x;
-    }
-    rotationAxis.y = 0;
+        // Get perpendicular axis
+        Vector3 rotationAxis;
+        if (velocity.z == 0)
+        {
+            rotationAxis.x = 0;
+        }
+        else
+        {
+            rotationAxis.x = velocity.z / velocity.z;
+        }
 
-    // Using Quaternions for storing and using rotation tracking
-    SimpleMath::Quaternion physicsRotation = m_Physics.GetActiveRotation();
-    if (rotationAxis != Vector3().Zero)
-    {
-        SimpleMath::Quaternion temp = SimpleMath::Quaternion::CreateFromAxisAngle(rotationAxis, (float)m_timer.GetElapsedSeconds() * m_Physics.GetActiveVelocity().Length());
-        temp.Normalize();
-        physicsRotation *= temp;
-        m_Physics.SetActiveRotation(physicsRotation);
-    }
+        if (velocity.x == 0)
+        {
+            rotationAxis.z = 0;
+        }
+        else
+        {
+            rotationAxis.z = -velocity.x / velocity.x;
+        }
+        rotationAxis.y = 0;
 
-    m_world *= Matrix::CreateFromQuaternion(physicsRotation);
-    m_world *= physicsPosition;
-    
-    //setup and draw ball
-    m_BasicShaderPair.EnableShader(context);
-    m_BasicShaderPair.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, m_texture3.Get());
-    m_BasicModel.Render(context);
+        // Using Quaternions for storing and using rotation tracking
+        SimpleMath::Quaternion physicsRotation = m_Physics.GetRotation(body);
+        if (rotationAxis != Vector3().Zero)
+        {
+            SimpleMath::Quaternion temp = SimpleMath::Quaternion::CreateFromAxisAngle(rotationAxis, (float)m_timer.GetElapsedSeconds() * velocity.Length());
+            temp.Normalize();
+            physicsRotation *= temp;
+            m_Physics.SetRotation(body, physicsRotation);
+        }
+
+        m_world *= Matrix::CreateFromQuaternion(physicsRotation);
+        m_world *= physicsPosition;
+
+        //setup and draw ball
+        m_BasicShaderPair.EnableShader(context);
+        m_BasicShaderPair.SetShaderParameters(context, &m_world, &m_view, &m_projection, &m_Light, m_texture3.Get());
+        m_BasicModel.Render(context);
+    }
 
 }
 
@@ -606,20 +637,22 @@ void Game::CreateDeviceDependentResources()
     m_font = std::make_unique<SpriteFont>(device, L"SegoeUI_18.spritefont");
 	m_batch = std::make_unique<PrimitiveBatch<VertexPositionColor>>(context);
 
-	//setup our terrain
+	//load and set up our Vertex and Pixel Shaders, the terrain's vertex format depends on them
+	m_BasicShaderPair.InitStandard(device, L"light_vs.cso", L"light_ps.cso");
+	bool quantizedShader = m_QuantizedShaderPair.InitQuantized(device, L"light_quantized_vs.cso", L"light_ps.cso");
+
+	//setup our terrain, 16 byte vertices instead of 32 unless their shader failed to load
+	m_Terrain.SetVertexFormat(quantizedShader ? TERRAIN_VERTEX_QUANTIZED : TERRAIN_VERTEX_FLOAT);
 	m_Terrain.Initialize(device, 128, 128);
 
     //setup physics engine
-    m_Physics.Initialize(m_Terrain);
+    m_Physics.Initialize(m_Terrain.GetPhysicsLevel());
 
 	//setup our test model
 	m_BasicModel.InitializeSphere(device);
 	m_BasicModel2.InitializeModel(device,"drone.obj");
 	m_BasicModel3.InitializeBox(device, 1.0f, 1.0f, 1.0f);	//box includes dimensions
 
-	//load and set up our Vertex and Pixel Shaders
-	m_BasicShaderPair.InitStandard(device, L"light_vs.cso", L"light_ps.cso");
-
 	//load Textures
 	CreateDDSTextureFromFile(device, L"stone.dds",		    nullptr,	m_texture1.ReleaseAndGetAddressOf());
 	CreateDDSTextureFromFile(device, L"EvilDrone_Diff.dds", nullptr,	m_texture2.ReleaseAndGetAddressOf());
@@ -668,20 +701,42 @@ void Game::SetupGUI()
         ImGui::InputFloat("PCGSeedChance", m_Terrain.GetPCGSeedChance());
         ImGui::InputInt("PCGIterations", m_Terrain.GetPCGIterations());
         ImGui::InputInt("PCGThreshold", m_Terrain.GetPCGThreshold());
+        ImGui::Combo("PCGMode", m_Terrain.GetPCGMode(), "In Place\0Double Buffered\0Bitboard\0");
+        ImGui::Combo("Normals", m_Terrain.GetNormalMode(), "Central Difference\0Face Averaged\0");
+        ImGui::Checkbox("Connect regions", m_Terrain.GetConnectRegions());
+        ImGui::InputInt("Collectibles", m_Terrain.GetCollectibleCount());
+        ImGui::InputFloat("Collectible spacing", m_Terrain.GetCollectibleSpacing());
         if (ImGui::Button("Generate", ImVec2(80, 60)))
         {
             m_Terrain.GenerateHeightMap(m_deviceResources->GetD3DDevice(), m_Camera01.getPosition());
         }
+        if (m_Terrain.IsRegenerating())
+        {
+            ImGui::Text("Generating...");
+        }
+        ImGui::Text("Regions: %d, corridor cells: %d", m_Terrain.GetRegionCount(), m_Terrain.GetCarvedCells());
+        ImGui::Checkbox("Terrain LOD", m_Terrain.GetLodEnabled());
+        ImGui::Checkbox("Block walls", m_Terrain.GetBlockWalls());
+        ImGui::Checkbox("Distance field walls", m_Terrain.GetDistanceFieldWalls());
+        ImGui::Text("Terrain triangles: %d", m_Terrain.GetDrawnTriangles());
 
         ImGui::SliderFloat("Gravity", m_Physics.GravityGUI(), 0.0f, 1.0f);
         ImGui::SliderFloat("Friction", m_Physics.FrictionGUI(), 0.0f, 1.0f);
         ImGui::SliderFloat("Elasticty", m_Physics.ElasticityGUI(), 0.0f, 1.0f);
+        ImGui::Checkbox("Sleeping bodies", m_Physics.SleepingGUI());
         ImGui::InputFloat("KickStrength", m_Physics.KickStrengthGUI());
         ImGui::InputFloat("Spawned Ball Mass", m_Physics.BallMassGUI());
         if (ImGui::Button("Spawn Ball", ImVec2(80, 60)))
         {
             m_Physics.SpawnBall(m_Camera01.getPosition() + m_Camera01.getForward() * Vector3(3, 0, 3), 30);
         }
+        ImGui::SameLine();
+        if (ImGui::Button("Spawn Box", ImVec2(80, 60)))
+        {
+            m_Physics.SpawnBox(m_Camera01.getPosition() + m_Camera01.getForward() * Vector3(3, 0, 3), 30, 0.5f);
+        }
+        ImGui::Text("Bodies: %d, touching pairs: %d", m_Physics.GetBodyCount(), m_Physics.GetContacts());
+        ImGui::Text("Awake: %d, sleeping: %d", m_Physics.GetAwakeCount(), m_Physics.GetSleepingCount());
 	ImGui::End();
 }
 
@@ -63,6 +63,7 @@ private:
     void CreateDeviceDependentResources();
     void CreateWindowSizeDependentResources();
 	void SetupGUI();
+    void RenderTerrain(ID3D11DeviceContext* context, DirectX::SimpleMath::Matrix* view);
     void RenderToTexture();
     void RenderSceneToTexture();
     void PostProcessingBloom();
@@ -109,6 +110,7 @@ private:
 
 	//Shaders
 	Shader																	m_BasicShaderPair;
+	Shader																	m_QuantizedShaderPair;
 
 	//Scene. 
 	Terrain																	m_Terrain;
@@ -1,28 +1,12 @@
 #pragma once
 
-#include "Terrain.h"
+#include "DungeonCore/PhysicsInputLog.h"
+#include "DungeonCore/PhysicsWorld.h"
 
-// Define global parameters for physics engine
-#define AIR_FRICTION	 0.02f
-#define FLOOR_FRICTION	 0.5f
-#define GRAVITY			 9.8f
-#define KICK_RANGE		 5.0f
-
-// Ball and Block Physics
+// Ball and Block Physics, every body lives in the headless PhysicsWorld. The world runs
+// fixed steps, and every player input goes through a log that can replay the session
 class Physics
 {
-private:
-	struct PhysicsObject
-	{
-		DirectX::SimpleMath::Vector3	 position;
-		DirectX::SimpleMath::Vector3	 velocity;
-		DirectX::SimpleMath::Vector3	 acceleration;
-		DirectX::SimpleMath::Quaternion  orientation;
-
-		float radius;
-		float mass;
-		int modelID;
-	};
 public:
 	// ImGUI accessor functions
 	float*		GravityGUI();
@@ -30,51 +14,54 @@ public:
 	float*		ElasticityGUI();
 	float*		BallMassGUI();
 	float*		KickStrengthGUI();
+	bool*		SleepingGUI();
+
+	// Keeps a view of the level's walls, which must outlive the physics
+	void		Initialize(const PhysicsLevel&);
 
-	void		Initialize(Terrain);
+	// Frame time in, as many fixed steps as it covers
 	bool		Update(float);
-	
-	// Detect collisions at position +- radius for all axes
-	
-	// Detect Horizontal collisions with walls
-	// (target, new position, out string specifying the collision axis)
-	bool		FacesCollisionXZ(PhysicsObject, DirectX::SimpleMath::Vector3, char**);
-
-	// Detect Horizontal collisions with Floor
-	// (target, new position)
-	bool		FacesCollisionY(PhysicsObject, DirectX::SimpleMath::Vector3);
-
-	// Other collision detection
-	DirectX::SimpleMath::Vector3	CollideWithBall(DirectX::SimpleMath::Vector3, DirectX::SimpleMath::Vector3, DirectX::SimpleMath::Vector3);
-	bool							CalculateCollision(PhysicsObject, DirectX::SimpleMath::Vector3*, DirectX::SimpleMath::Vector3*, DirectX::SimpleMath::Vector3*);
-	bool							FloorBounce(PhysicsObject, DirectX::SimpleMath::Vector3*, DirectX::SimpleMath::Vector3*);
-	bool							WallBounce(PhysicsObject, const char*, DirectX::SimpleMath::Vector3*, DirectX::SimpleMath::Vector3*);
 
-	DirectX::SimpleMath::Vector3		ApplyForceOn(PhysicsObject, DirectX::SimpleMath::Vector3, float);
+	// Camera against every body, pushes the first one it walks into and stops the camera
+	DirectX::SimpleMath::Vector3	CollideWithBall(DirectX::SimpleMath::Vector3, DirectX::SimpleMath::Vector3, DirectX::SimpleMath::Vector3);
 
 	// Apply force if an object is nearby
 	// Vector3 playerPosition, Vector3 playerDirection
 	void								ApplyForceOnObjectInRange(DirectX::SimpleMath::Vector3, DirectX::SimpleMath::Vector3);
-	DirectX::SimpleMath::Vector3		ApplyFriction(PhysicsObject, DirectX::SimpleMath::Vector3, DirectX::SimpleMath::Vector3*, float);
 
-	//Spawn physics objects ( Location, Mass, Radius )
+	//Spawn physics objects ( Location, Mass, Radius ), each adds a body
 	bool		SpawnBall(DirectX::SimpleMath::Vector3, float);
 	bool		SpawnBox(DirectX::SimpleMath::Vector3, float, float);
 
 
 	// Rendering Getters
-	DirectX::SimpleMath::Vector3	 GetActivePosition();
-	DirectX::SimpleMath::Vector3	 GetActiveVelocity();
-	DirectX::SimpleMath::Quaternion  GetActiveRotation();
-	void							 SetActiveRotation(DirectX::SimpleMath::Quaternion);
+	int								 GetBodyCount() const;
+	int								 GetContacts() const;
+	int								 GetAwakeCount() const;
+	int								 GetSleepingCount() const;
+	bool							 IsBox(int) const;
+	float							 GetRadius(int) const;
+	DirectX::SimpleMath::Vector3	 GetPosition(int) const;
+	DirectX::SimpleMath::Vector3	 GetRenderPosition(int) const;
+	DirectX::SimpleMath::Vector3	 GetVelocity(int) const;
+	DirectX::SimpleMath::Quaternion  GetRotation(int) const;
+	void							 SetRotation(int, DirectX::SimpleMath::Quaternion);
+
+	// Inputs since Initialize, stamped with the step they landed on
+	const PhysicsInputLog&			 GetInputLog() const;
 
 
 private:
 
-	//Global modifiers to allow GUI to modify physics
-	float		m_friction;
-	float		m_gravity;
-	float		m_elastic;
+	// Gravity, friction, elasticity and every body
+	PhysicsWorld	m_world;
+	PhysicsInputLog	m_inputs;
+
+	// Worker threads for big steps, small worlds step on the game thread anyway
+	std::shared_ptr<WorkerPool>	m_pool;
+
+	// Gravity, friction, elasticity and sleeping as the GUI edits them, logged into the world on Update
+	PhysicsParameters	m_parameters;
 
 	// Modifiers to allow player control over next ball spawned
 	float		m_mass;
@@ -85,13 +72,7 @@ private:
 	// Force camera applies to ball
 	float		m_pushStrength;
 
-	// Future functionality for multiple objects at once
-	//PhysicsObject* m_actveObjects;
-
-	PhysicsObject	m_activeObject;
-
-	// Needs to know the level
-	Terrain			m_level;
+	// Walls of the level, not owned
+	PhysicsLevel	m_level;
 
 };
-
@@ -4,6 +4,7 @@
 
 Shader::Shader()
 {
+	m_quantizationBuffer = NULL;
 }
 
 
@@ -11,7 +12,56 @@ Shader::~Shader()
 {
 }
 
+// Create the vertex input layout description.
+// This setup needs to match the VertexType stucture in the MeshClass and in the shader.
+static const D3D11_INPUT_ELEMENT_DESC s_standardLayout[] = {
+	{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
+	{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 }
+};
+
+// Matches QuantizedVertex: 16-bit grid position, half float texture coordinates, octahedral normal
+static const D3D11_INPUT_ELEMENT_DESC s_quantizedLayout[] = {
+	{ "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
+	{ "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 }
+};
+
 bool Shader::InitStandard(ID3D11Device * device, WCHAR * vsFilename, WCHAR * psFilename)
+{
+	return InitWithLayout(device, vsFilename, psFilename, s_standardLayout, sizeof(s_standardLayout) / sizeof(s_standardLayout[0]));
+}
+
+bool Shader::InitQuantized(ID3D11Device * device, WCHAR * vsFilename, WCHAR * psFilename)
+{
+	D3D11_BUFFER_DESC	quantizationBufferDesc;
+
+	// ReadData throws on a missing file. The caller falls back to float vertices instead
+	try
+	{
+		if (!InitWithLayout(device, vsFilename, psFilename, s_quantizedLayout, sizeof(s_quantizedLayout) / sizeof(s_quantizedLayout[0])))
+		{
+			return false;
+		}
+	}
+	catch (const std::exception&)
+	{
+		return false;
+	}
+
+	// Setup the description of the position decode constant buffer that is in the vertex shader.
+	quantizationBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+	quantizationBufferDesc.ByteWidth = sizeof(QuantizationBufferType);
+	quantizationBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	quantizationBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	quantizationBufferDesc.MiscFlags = 0;
+	quantizationBufferDesc.StructureByteStride = 0;
+
+	HRESULT result = device->CreateBuffer(&quantizationBufferDesc, NULL, &m_quantizationBuffer);
+	return result == S_OK;
+}
+
+bool Shader::InitWithLayout(ID3D11Device * device, WCHAR * vsFilename, WCHAR * psFilename, const D3D11_INPUT_ELEMENT_DESC * layout, unsigned int numElements)
 {
 	D3D11_BUFFER_DESC	matrixBufferDesc;
 	D3D11_SAMPLER_DESC	samplerDesc;
@@ -26,20 +76,13 @@ bool Shader::InitStandard(ID3D11Device * device, WCHAR * vsFilename, WCHAR * psF
 		return false;
 	}
 
-	// Create the vertex input layout description.
-	// This setup needs to match the VertexType stucture in the MeshClass and in the shader.
-	D3D11_INPUT_ELEMENT_DESC polygonLayout[] = {
-		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
-		{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 }
-	};
-
-	// Get a count of the elements in the layout.
-	unsigned int numElements;
-	numElements = sizeof(polygonLayout) / sizeof(polygonLayout[0]);
-
 	// Create the vertex input layout.
-	device->CreateInputLayout(polygonLayout, numElements, vertexShaderBuffer.data(), vertexShaderBuffer.size(), &m_layout);
+	result = device->CreateInputLayout(layout, numElements, vertexShaderBuffer.data(), vertexShaderBuffer.size(), &m_layout);
+	if (result != S_OK)
+	{
+		//if the shader's inputs do not match the layout.
+		return false;
+	}
 	
 
 	//LOAD SHADER:	PIXEL
@@ -131,6 +174,26 @@ bool Shader::SetShaderParameters(ID3D11DeviceContext * context, DirectX::SimpleM
 	return false;
 }
 
+bool Shader::SetPositionDequantization(ID3D11DeviceContext * context, const float * origin, const float * scale)
+{
+	D3D11_MAPPED_SUBRESOURCE mappedResource;
+	QuantizationBufferType* quantizationPtr;
+
+	if (!m_quantizationBuffer)
+	{
+		return false;
+	}
+
+	context->Map(m_quantizationBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
+	quantizationPtr = (QuantizationBufferType*)mappedResource.pData;
+	quantizationPtr->positionOrigin = DirectX::SimpleMath::Vector4(origin[0], origin[1], origin[2], 0.0f);
+	quantizationPtr->positionScale = DirectX::SimpleMath::Vector4(scale[0], scale[1], scale[2], 0.0f);
+	context->Unmap(m_quantizationBuffer, 0);
+	context->VSSetConstantBuffers(1, 1, &m_quantizationBuffer);	//b1, after the matrix buffer
+
+	return true;
+}
+
 void Shader::EnableShader(ID3D11DeviceContext * context)
 {
 	context->IASetInputLayout(m_layout);							//set the input layout for the shader to match out geometry
@@ -14,10 +14,23 @@ public:
 	//we could extend this to load in only a vertex shader, only a pixel shader etc.  or specialised init for Geometry or domain shader. 
 	//All the methods here simply create new versions corresponding to your needs
 	bool InitStandard(ID3D11Device * device, WCHAR * vsFilename, WCHAR * psFilename);		//Loads the Vert / pixel Shader pair
+	bool InitQuantized(ID3D11Device * device, WCHAR * vsFilename, WCHAR * psFilename);		//Same, for 16 byte QuantizedVertex input
 	bool SetShaderParameters(ID3D11DeviceContext * context, DirectX::SimpleMath::Matrix  *world, DirectX::SimpleMath::Matrix  *view, DirectX::SimpleMath::Matrix  *projection, Light *sceneLight1, ID3D11ShaderResourceView* texture1);
 	void EnableShader(ID3D11DeviceContext * context);
 
+	//quantized shaders only, position = origin + unorm position * scale (see GetUnormDequantization)
+	bool SetPositionDequantization(ID3D11DeviceContext * context, const float * origin, const float * scale);
+
 private:
+	bool InitWithLayout(ID3D11Device * device, WCHAR * vsFilename, WCHAR * psFilename, const D3D11_INPUT_ELEMENT_DESC * layout, unsigned int numElements);
+
+	//buffer for the quantized vertex position decode
+	struct QuantizationBufferType
+	{
+		DirectX::SimpleMath::Vector4 positionOrigin;
+		DirectX::SimpleMath::Vector4 positionScale;
+	};
+
 	//standard matrix buffer supplied to all shaders
 	struct MatrixBufferType
 	{
@@ -49,5 +62,6 @@ private:
 	ID3D11Buffer*															m_matrixBuffer;
 	ID3D11SamplerState*														m_sampleState;
 	ID3D11Buffer*															m_lightBuffer;
+	ID3D11Buffer*															m_quantizationBuffer;
 };
 
@@ -2,9 +2,102 @@
 #include "Terrain.h"
 
 
+// ID3D11Device is free threaded, so the regeneration job creates the next level's buffers itself
+class D3DMeshBufferDevice : public MeshBufferDevice
+{
+public:
+	explicit D3DMeshBufferDevice(ID3D11Device* device) : m_device(device) {}
+
+	MeshBufferHandle CreateVertexBuffer(const void* data, size_t bytes) override
+	{
+		return CreateBuffer(data, bytes, D3D11_BIND_VERTEX_BUFFER);
+	}
+
+	MeshBufferHandle CreateIndexBuffer(const void* data, size_t bytes) override
+	{
+		return CreateBuffer(data, bytes, D3D11_BIND_INDEX_BUFFER);
+	}
+
+	// Only called from the render thread, which owns the immediate context
+	bool UpdateBuffer(MeshBufferHandle buffer, size_t offset, const void* data, size_t bytes) override
+	{
+		ID3D11DeviceContext* context = nullptr;
+		D3D11_BOX box;
+
+		box.left = (UINT)offset;
+		box.right = (UINT)(offset + bytes);
+		box.top = 0;
+		box.bottom = 1;
+		box.front = 0;
+		box.back = 1;
+
+		m_device->GetImmediateContext(&context);
+		context->UpdateSubresource(static_cast<ID3D11Buffer*>(buffer), 0, &box, data, 0, 0);
+		context->Release();
+
+		return true;
+	}
+
+	void ReleaseBuffer(MeshBufferHandle buffer) override
+	{
+		static_cast<ID3D11Buffer*>(buffer)->Release();
+	}
+
+private:
+	MeshBufferHandle CreateBuffer(const void* data, size_t bytes, UINT bindFlags)
+	{
+		D3D11_BUFFER_DESC bufferDesc;
+		D3D11_SUBRESOURCE_DATA bufferData;
+		ID3D11Buffer* buffer = nullptr;
+
+		bufferDesc.Usage = D3D11_USAGE_DEFAULT;
+		bufferDesc.ByteWidth = (UINT)bytes;
+		bufferDesc.BindFlags = bindFlags;
+		bufferDesc.CPUAccessFlags = 0;
+		bufferDesc.MiscFlags = 0;
+		bufferDesc.StructureByteStride = 0;
+
+		bufferData.pSysMem = data;
+		bufferData.SysMemPitch = 0;
+		bufferData.SysMemSlicePitch = 0;
+
+		if (FAILED(m_device->CreateBuffer(&bufferDesc, &bufferData, &buffer)))
+		{
+			return nullptr;
+		}
+
+		return buffer;
+	}
+
+	ID3D11Device* m_device;
+};
+
+
 Terrain::Terrain()
 {
 	m_terrainGeneratedToggle = false;
+
+	m_buffers.vertexBuffer = nullptr;
+	m_buffers.indexBuffer = nullptr;
+	m_buffers.vertexCount = 0;
+	m_buffers.indexCount = 0;
+	m_buffers.vertexStride = 0;
+
+	m_normalMode = TERRAIN_NORMALS_CENTRAL;
+
+	m_lodEnabled = true;
+	m_drawnTriangles = 0;
+
+	m_blockBuffers.vertexBuffer = nullptr;
+	m_blockBuffers.indexBuffer = nullptr;
+	m_blockBuffers.vertexCount = 0;
+	m_blockBuffers.indexCount = 0;
+	m_blockBuffers.vertexStride = 0;
+	m_blockWalls = false;
+	m_blocksDirty = true;
+
+	m_distanceWalls = false;
+	m_wallFieldDirty = true;
 }
 
 
@@ -14,8 +107,6 @@ Terrain::~Terrain()
 
 bool Terrain::Initialize(ID3D11Device* device, int terrainWidth, int terrainHeight)
 {
-	int index;
-	float height = 0.0;
 	bool result;
 
 	// Save the dimensions of the terrain.
@@ -26,43 +117,38 @@ bool Terrain::Initialize(ID3D11Device* device, int terrainWidth, int terrainHeig
 	m_amplitude = 3.0;
 	m_wavelength = 1;
 
-	//Initialize PCG parameters
-	m_threshold = 5;
-	m_seedChance = 0.4;
-	m_iterations = 5;
-
-	//Init Collectibels
-	
-	m_collectibles = new DirectX::SimpleMath::Vector3[COLLECTIBLE_COUNT];
-
-	// Create the structure to hold the terrain data.
-	m_heightMap = new HeightMapType[m_terrainWidth * m_terrainHeight];
-	if (!m_heightMap)
+	//Initialize PCG core, parameters default to threshold 5, seed chance 0.4, 5 iterations
+	result = m_dungeon.Initialize(m_terrainWidth, m_terrainHeight);
+	if (!result)
 	{
 		return false;
 	}
 
-	//this is how we calculate the texture coordinates first calculate the step size there will be between vertices. 
-	float textureCoordinatesStep = 5.0f / m_terrainWidth;  //tile 5 times across the terrain. 
-	// Initialise the data in the height map (flat).
-	
-	for (int j = 0; j<m_terrainHeight; j++)
+	// Any job still building a level for the old size or device is finished and dropped
+	m_regenerator.Discard();
+	m_regenerator.ReleaseBuffers(m_buffers);
+	m_regenerator.ReleaseBuffers(m_blockBuffers);
+	m_fieldBaker.Discard();
+	m_wallField.Clear();
+	m_wallFieldDirty = true;
+	m_lod.SetDevice(nullptr);
+	m_drawItems.clear();
+	m_meshDevice.reset(new D3DMeshBufferDevice(device));
+	m_regenerator.SetDevice(m_meshDevice.get());
+	m_lod.SetDevice(m_meshDevice.get());
+
+	result = m_walls.Build(m_dungeon.GetHeights(), m_terrainWidth, m_terrainHeight);
+	if (!result)
 	{
-		for (int i = 0; i<m_terrainWidth; i++)
-		{
-			index = (m_terrainHeight * j) + i;
-
-			m_heightMap[index].x = (float)i;
-			m_heightMap[index].y = (float)height;
-			m_heightMap[index].z = (float)j;
-
-			//and use this step to calculate the texture coordinates for this point on the terrain.
-			m_heightMap[index].u = (float)i * textureCoordinatesStep;
-			m_heightMap[index].v = (float)j * textureCoordinatesStep;
+		return false;
+	}
 
-		}
+	// Buckets twice the pickup leeway wide, so a pickup check visits at most 2x2 of them
+	result = m_collectibles.Initialize(m_terrainWidth, m_terrainHeight, COLLECTIBLE_LEEWAY * 2.0f);
+	if (!result)
+	{
+		return false;
 	}
-	
 
 	// Randomly Initialize
 	/*result = RandomHeightMap();
@@ -92,14 +178,6 @@ bool Terrain::Initialize(ID3D11Device* device, int terrainWidth, int terrainHeig
 		return false;
 	}
 
-	//even though we are generating a flat terrain, we still need to normalise it. 
-	// Calculate the normals for the terrain data.
-	result = CalculateNormals();
-	if (!result)
-	{
-		return false;
-	}
-
 	// Initialize the vertex and index buffer that hold the geometry for the terrain.
 	result = InitializeBuffers(device);
 	if (!result)
@@ -113,461 +191,146 @@ bool Terrain::Initialize(ID3D11Device* device, int terrainWidth, int terrainHeig
 
 void Terrain::Render(ID3D11DeviceContext * deviceContext)
 {
-	// Put the vertex and index buffers on the graphics pipeline to prepare them for drawing.
-	RenderBuffers(deviceContext);
-	deviceContext->DrawIndexed(m_indexCount, 0, 0);
-
-	return;
-}
-
-bool Terrain::CalculateNormals()
-{
-	int i, j, index1, index2, index3, index, count;
-	float vertex1[3], vertex2[3], vertex3[3], vector1[3], vector2[3], sum[3], length;
-	DirectX::SimpleMath::Vector3* normals;
-	
-
-	// Create a temporary array to hold the un-normalized normal vectors.
-	normals = new DirectX::SimpleMath::Vector3[(m_terrainHeight - 1) * (m_terrainWidth - 1)];
-	if (!normals)
+	if (DrawsBlocks())
 	{
-		return false;
+		unsigned int stride = sizeof(TerrainVertex);
+		unsigned int offset = 0;
+		ID3D11Buffer* vertexBuffer = static_cast<ID3D11Buffer*>(m_blockBuffers.vertexBuffer);
+
+		deviceContext->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
+		deviceContext->IASetIndexBuffer(static_cast<ID3D11Buffer*>(m_blockBuffers.indexBuffer), DXGI_FORMAT_R32_UINT, 0);
+		deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+		deviceContext->DrawIndexed(m_blockBuffers.indexCount, 0, 0);
+		return;
 	}
 
-	// Go through all the faces in the mesh and calculate their normals.
-	for (j = 0; j<(m_terrainHeight - 1); j++)
+	// Put the vertex and index buffers on the graphics pipeline to prepare them for drawing.
+	RenderBuffers(deviceContext);
+
+	// Each LOD item brings its own chunk-local index list
+	if (m_lodEnabled && !m_drawItems.empty())
 	{
-		for (i = 0; i<(m_terrainWidth - 1); i++)
+		for (size_t i = 0; i < m_drawItems.size(); i++)
 		{
-			index1 = (j * m_terrainHeight) + i;
-			index2 = (j * m_terrainHeight) + (i + 1);
-			index3 = ((j + 1) * m_terrainHeight) + i;
-
-			// Get three vertices from the face.
-			vertex1[0] = m_heightMap[index1].x;
-			vertex1[1] = m_heightMap[index1].y;
-			vertex1[2] = m_heightMap[index1].z;
-
-			vertex2[0] = m_heightMap[index2].x;
-			vertex2[1] = m_heightMap[index2].y;
-			vertex2[2] = m_heightMap[index2].z;
-
-			vertex3[0] = m_heightMap[index3].x;
-			vertex3[1] = m_heightMap[index3].y;
-			vertex3[2] = m_heightMap[index3].z;
-
-			// Calculate the two vectors for this face.
-			vector1[0] = vertex1[0] - vertex3[0];
-			vector1[1] = vertex1[1] - vertex3[1];
-			vector1[2] = vertex1[2] - vertex3[2];
-			vector2[0] = vertex3[0] - vertex2[0];
-			vector2[1] = vertex3[1] - vertex2[1];
-			vector2[2] = vertex3[2] - vertex2[2];
-
-			index = (j * (m_terrainHeight - 1)) + i;
-
-			// Calculate the cross product of those two vectors to get the un-normalized value for this face normal.
-			normals[index].x = (vector1[1] * vector2[2]) - (vector1[2] * vector2[1]);
-			normals[index].y = (vector1[2] * vector2[0]) - (vector1[0] * vector2[2]);
-			normals[index].z = (vector1[0] * vector2[1]) - (vector1[1] * vector2[0]);
+			const TerrainDrawItem& item = m_drawItems[i];
+			deviceContext->IASetIndexBuffer(static_cast<ID3D11Buffer*>(item.indexBuffer), DXGI_FORMAT_R16_UINT, 0);
+			deviceContext->DrawIndexed(item.indexCount, 0, item.baseVertex);
 		}
+		return;
 	}
 
-	// Now go through all the vertices and take an average of each face normal 	
-	// that the vertex touches to get the averaged normal for that vertex.
-	for (j = 0; j<m_terrainHeight; j++)
+	// 16-bit indices are local to each chunk
+	for (size_t i = 0; i < m_buffers.chunks.size(); i++)
 	{
-		for (i = 0; i<m_terrainWidth; i++)
-		{
-			// Initialize the sum.
-			sum[0] = 0.0f;
-			sum[1] = 0.0f;
-			sum[2] = 0.0f;
-
-			// Initialize the count.
-			count = 0;
-
-			// Bottom left face.
-			if (((i - 1) >= 0) && ((j - 1) >= 0))
-			{
-				index = ((j - 1) * (m_terrainHeight - 1)) + (i - 1);
-
-				sum[0] += normals[index].x;
-				sum[1] += normals[index].y;
-				sum[2] += normals[index].z;
-				count++;
-			}
-
-			// Bottom right face.
-			if ((i < (m_terrainWidth - 1)) && ((j - 1) >= 0))
-			{
-				index = ((j - 1) * (m_terrainHeight - 1)) + i;
-
-				sum[0] += normals[index].x;
-				sum[1] += normals[index].y;
-				sum[2] += normals[index].z;
-				count++;
-			}
-
-			// Upper left face.
-			if (((i - 1) >= 0) && (j < (m_terrainHeight - 1)))
-			{
-				index = (j * (m_terrainHeight - 1)) + (i - 1);
-
-				sum[0] += normals[index].x;
-				sum[1] += normals[index].y;
-				sum[2] += normals[index].z;
-				count++;
-			}
-
-			// Upper right face.
-			if ((i < (m_terrainWidth - 1)) && (j < (m_terrainHeight - 1)))
-			{
-				index = (j * (m_terrainHeight - 1)) + i;
-
-				sum[0] += normals[index].x;
-				sum[1] += normals[index].y;
-				sum[2] += normals[index].z;
-				count++;
-			}
-
-			// Take the average of the faces touching this vertex.
-			sum[0] = (sum[0] / (float)count);
-			sum[1] = (sum[1] / (float)count);
-			sum[2] = (sum[2] / (float)count);
-
-			// Calculate the length of this normal.
-			length = sqrt((sum[0] * sum[0]) + (sum[1] * sum[1]) + (sum[2] * sum[2]));
-
-			// Get an index to the vertex location in the height map array.
-			index = (j * m_terrainHeight) + i;
-
-			// Normalize the final shared normal for this vertex and store it in the height map array.
-			m_heightMap[index].nx = (sum[0] / length);
-			m_heightMap[index].ny = (sum[1] / length);
-			m_heightMap[index].nz = (sum[2] / length);
-		}
+		const TerrainMeshChunk& chunk = m_buffers.chunks[i];
+		deviceContext->DrawIndexed(chunk.indexCount, chunk.firstIndex, chunk.baseVertex);
 	}
 
-	// Release the temporary normals.
-	delete[] normals;
-	normals = 0;
-
-	return true;
+	return;
 }
 
 void Terrain::Shutdown()
 {
-	// Release the index buffer.
-	if (m_indexBuffer)
-	{
-		m_indexBuffer->Release();
-		m_indexBuffer = 0;
-	}
-
-	// Release the vertex buffer.
-	if (m_vertexBuffer)
-	{
-		m_vertexBuffer->Release();
-		m_vertexBuffer = 0;
-	}
+	// Release the vertex and index buffers.
+	m_regenerator.Wait();
+	m_regenerator.ReleaseBuffers(m_buffers);
+	m_regenerator.ReleaseBuffers(m_blockBuffers);
+	m_lod.SetDevice(nullptr);
+	m_drawItems.clear();
 
 	return;
 }
 
+// Builds the mesh (normals included) from the current heights and replaces the buffers synchronously
 bool Terrain::InitializeBuffers(ID3D11Device * device )
 {
-	VertexType* vertices;
-	unsigned long* indices;
-	D3D11_BUFFER_DESC vertexBufferDesc, indexBufferDesc;
-	D3D11_SUBRESOURCE_DATA vertexData, indexData;
-	HRESULT result;
-	int index, i, j;
-	int index1, index2, index3, index4; //geometric indices. 
-
-	// Calculate the number of vertices in the terrain mesh.
-	m_vertexCount = (m_terrainWidth - 1) * (m_terrainHeight - 1) * 6;
-
-	// Set the index count to the same as the vertex count.
-	m_indexCount = m_vertexCount;
-
-	// Create the vertex array.
-	vertices = new VertexType[m_vertexCount];
-	if (!vertices)
+	TerrainBuffers buffers;
+
+	m_chunks.SetNormalMode((TerrainNormalMode)m_normalMode);
+	if (!m_chunks.Build(m_dungeon.GetHeights(), m_terrainWidth, m_terrainHeight))
 	{
 		return false;
 	}
 
-	// Create the index array.
-	indices = new unsigned long[m_indexCount];
-	if (!indices)
+	if (!m_regenerator.CreateBuffers(m_chunks.GetMesh(), buffers))
 	{
 		return false;
 	}
 
-	// Initialize the index to the vertex buffer.
-	index = 0;
+	// Previous buffers used to leak here
+	m_regenerator.ReleaseBuffers(m_buffers);
+	m_buffers = buffers;
+	m_lod.Reset(m_chunks.GetMesh(), m_terrainWidth, m_terrainHeight);
+	m_drawItems.clear();
+	m_blocksDirty = true;
+
+	return true;
+}
 
-	for (j = 0; j<(m_terrainHeight - 1); j++)
+// Patches the vertex buffer with the chunks touched since the last frame
+bool Terrain::UpdateBuffers()
+{
+	if (!m_chunks.HasDirty())
 	{
-		for (i = 0; i<(m_terrainWidth - 1); i++)
-		{
-			index1 = (m_terrainHeight * j) + i;          // Bottom left.
-			index2 = (m_terrainHeight * j) + (i + 1);      // Bottom right.
-			index3 = (m_terrainHeight * (j + 1)) + i;      // Upper left.
-			index4 = (m_terrainHeight * (j + 1)) + (i + 1);  // Upper right.
-
-			if (i % 2 == 1)
-			{
-				if (j % 2 == 1)
-				{
-					// Upper left.
-					vertices[index].position = DirectX::SimpleMath::Vector3(m_heightMap[index3].x, m_heightMap[index3].y, m_heightMap[index3].z);
-					vertices[index].normal = DirectX::SimpleMath::Vector3(m_heightMap[index3].nx, m_heightMap[index3].ny, m_heightMap[index3].nz);
-					vertices[index].texture = DirectX::SimpleMath::Vector2(m_heightMap[index3].u, m_heightMap[index3].v);
-					indices[index] = index;
-					index++;
-
-					// Upper right.
-					vertices[index].position = DirectX::SimpleMath::Vector3(m_heightMap[index4].x, m_heightMap[index4].y, m_heightMap[index4].z);
-					vertices[index].normal = DirectX::SimpleMath::Vector3(m_heightMap[index4].nx, m_heightMap[index4].ny, m_heightMap[index4].nz);
-					vertices[index].texture = DirectX::SimpleMath::Vector2(m_heightMap[index4].u, m_heightMap[index4].v);
-					indices[index] = index;
-					index++;
-
-					// Bottom left.
-					vertices[index].position = DirectX::SimpleMath::Vector3(m_heightMap[index1].x, m_heightMap[index1].y, m_heightMap[index1].z);
-					vertices[index].normal = DirectX::SimpleMath::Vector3(m_heightMap[index1].nx, m_heightMap[index1].ny, m_heightMap[index1].nz);
-					vertices[index].texture = DirectX::SimpleMath::Vector2(m_heightMap[index1].u, m_heightMap[index1].v);
-					indices[index] = index;
-					index++;
-
-					// Bottom left.
-					vertices[index].position = DirectX::SimpleMath::Vector3(m_heightMap[index1].x, m_heightMap[index1].y, m_heightMap[index1].z);
-					vertices[index].normal = DirectX::SimpleMath::Vector3(m_heightMap[index1].nx, m_heightMap[index1].ny, m_heightMap[index1].nz);
-					vertices[index].texture = DirectX::SimpleMath::Vector2(m_heightMap[index1].u, m_heightMap[index1].v);
-					indices[index] = index;
-					index++;
-
-					// Upper right.
-					vertices[index].position = DirectX::SimpleMath::Vector3(m_heightMap[index4].x, m_heightMap[index4].y, m_heightMap[index4].z);
-					vertices[index].normal = DirectX::SimpleMath::Vector3(m_heightMap[index4].nx, m_heightMap[index4].ny, m_heightMap[index4].nz);
-					vertices[index].texture = DirectX::SimpleMath::Vector2(m_heightMap[index4].u, m_heightMap[index4].v);
-					indices[index] = index;
-					index++;
-
-					// Bottom right.
-					vertices[index].position = DirectX::SimpleMath::Vector3(m_heightMap[index2].x, m_heightMap[index2].y, m_heightMap[index2].z);
-					vertices[index].normal = DirectX::SimpleMath::Vector3(m_heightMap[index2].nx, m_heightMap[index2].ny, m_heightMap[index2].nz);
-					vertices[index].texture = DirectX::SimpleMath::Vector2(m_heightMap[index2].u, m_heightMap[index2].v);
-					indices[index] = index;
-					index++;
-				}
-				else
-				{
-					// Upper left.
-					vertices[index].position = DirectX::SimpleMath::Vector3(m_heightMap[index3].x, m_heightMap[index3].y, m_heightMap[index3].z);
-					vertices[index].normal = DirectX::SimpleMath::Vector3(m_heightMap[index3].nx, m_heightMap[index3].ny, m_heightMap[index3].nz);
-					vertices[index].texture = DirectX::SimpleMath::Vector2(m_heightMap[index3].u, m_heightMap[index3].v);
-					indices[index] = index;
-					index++;
-
-					// Bottom right.
-					vertices[index].position = DirectX::SimpleMath::Vector3(m_heightMap[index2].x, m_heightMap[index2].y, m_heightMap[index2].z);
-					vertices[index].normal = DirectX::SimpleMath::Vector3(m_heightMap[index2].nx, m_heightMap[index2].ny, m_heightMap[index2].nz);
-					vertices[index].texture = DirectX::SimpleMath::Vector2(m_heightMap[index2].u, m_heightMap[index2].v);
-					indices[index] = index;
-					index++;
-
-					// Bottom left.
-					vertices[index].position = DirectX::SimpleMath::Vector3(m_heightMap[index1].x, m_heightMap[index1].y, m_heightMap[index1].z);
-					vertices[index].normal = DirectX::SimpleMath::Vector3(m_heightMap[index1].nx, m_heightMap[index1].ny, m_heightMap[index1].nz);
-					vertices[index].texture = DirectX::SimpleMath::Vector2(m_heightMap[index1].u, m_heightMap[index1].v);
-					indices[index] = index;
-					index++;
-
-					// Upper left.
-					vertices[index].position = DirectX::SimpleMath::Vector3(m_heightMap[index3].x, m_heightMap[index3].y, m_heightMap[index3].z);
-					vertices[index].normal = DirectX::SimpleMath::Vector3(m_heightMap[index3].nx, m_heightMap[index3].ny, m_heightMap[index3].nz);
-					vertices[index].texture = DirectX::SimpleMath::Vector2(m_heightMap[index3].u, m_heightMap[index3].v);
-					indices[index] = index;
-					index++;
-
-					// Upper right.
-					vertices[index].position = DirectX::SimpleMath::Vector3(m_heightMap[index4].x, m_heightMap[index4].y, m_heightMap[index4].z);
-					vertices[index].normal = DirectX::SimpleMath::Vector3(m_heightMap[index4].nx, m_heightMap[index4].ny, m_heightMap[index4].nz);
-					vertices[index].texture = DirectX::SimpleMath::Vector2(m_heightMap[index4].u, m_heightMap[index4].v);
-					indices[index] = index;
-					index++;
-
-					// Bottom right.
-					vertices[index].position = DirectX::SimpleMath::Vector3(m_heightMap[index2].x, m_heightMap[index2].y, m_heightMap[index2].z);
-					vertices[index].normal = DirectX::SimpleMath::Vector3(m_heightMap[index2].nx, m_heightMap[index2].ny, m_heightMap[index2].nz);
-					vertices[index].texture = DirectX::SimpleMath::Vector2(m_heightMap[index2].u, m_heightMap[index2].v);
-					indices[index] = index;
-					index++;
-				}
-			}
-			else
-			{
-				if (j % 2 == 1)
-				{
-					// Upper left.
-					vertices[index].position = DirectX::SimpleMath::Vector3(m_heightMap[index3].x, m_heightMap[index3].y, m_heightMap[index3].z);
-					vertices[index].normal = DirectX::SimpleMath::Vector3(m_heightMap[index3].nx, m_heightMap[index3].ny, m_heightMap[index3].nz);
-					vertices[index].texture = DirectX::SimpleMath::Vector2(m_heightMap[index3].u, m_heightMap[index3].v);
-					indices[index] = index;
-					index++;
-
-					// Bottom right.
-					vertices[index].position = DirectX::SimpleMath::Vector3(m_heightMap[index2].x, m_heightMap[index2].y, m_heightMap[index2].z);
-					vertices[index].normal = DirectX::SimpleMath::Vector3(m_heightMap[index2].nx, m_heightMap[index2].ny, m_heightMap[index2].nz);
-					vertices[index].texture = DirectX::SimpleMath::Vector2(m_heightMap[index2].u, m_heightMap[index2].v);
-					indices[index] = index;
-					index++;
-
-					// Bottom left.
-					vertices[index].position = DirectX::SimpleMath::Vector3(m_heightMap[index1].x, m_heightMap[index1].y, m_heightMap[index1].z);
-					vertices[index].normal = DirectX::SimpleMath::Vector3(m_heightMap[index1].nx, m_heightMap[index1].ny, m_heightMap[index1].nz);
-					vertices[index].texture = DirectX::SimpleMath::Vector2(m_heightMap[index1].u, m_heightMap[index1].v);
-					indices[index] = index;
-					index++;
-
-					// Upper left.
-					vertices[index].position = DirectX::SimpleMath::Vector3(m_heightMap[index3].x, m_heightMap[index3].y, m_heightMap[index3].z);
-					vertices[index].normal = DirectX::SimpleMath::Vector3(m_heightMap[index3].nx, m_heightMap[index3].ny, m_heightMap[index3].nz);
-					vertices[index].texture = DirectX::SimpleMath::Vector2(m_heightMap[index3].u, m_heightMap[index3].v);
-					indices[index] = index;
-					index++;
-
-					// Upper right.
-					vertices[index].position = DirectX::SimpleMath::Vector3(m_heightMap[index4].x, m_heightMap[index4].y, m_heightMap[index4].z);
-					vertices[index].normal = DirectX::SimpleMath::Vector3(m_heightMap[index4].nx, m_heightMap[index4].ny, m_heightMap[index4].nz);
-					vertices[index].texture = DirectX::SimpleMath::Vector2(m_heightMap[index4].u, m_heightMap[index4].v);
-					indices[index] = index;
-					index++;
-
-					// Bottom right.
-					vertices[index].position = DirectX::SimpleMath::Vector3(m_heightMap[index2].x, m_heightMap[index2].y, m_heightMap[index2].z);
-					vertices[index].normal = DirectX::SimpleMath::Vector3(m_heightMap[index2].nx, m_heightMap[index2].ny, m_heightMap[index2].nz);
-					vertices[index].texture = DirectX::SimpleMath::Vector2(m_heightMap[index2].u, m_heightMap[index2].v);
-					indices[index] = index;
-					index++;
-				}
-				else
-				{
-					// Upper left.
-					vertices[index].position = DirectX::SimpleMath::Vector3(m_heightMap[index3].x, m_heightMap[index3].y, m_heightMap[index3].z);
-					vertices[index].normal = DirectX::SimpleMath::Vector3(m_heightMap[index3].nx, m_heightMap[index3].ny, m_heightMap[index3].nz);
-					vertices[index].texture = DirectX::SimpleMath::Vector2(m_heightMap[index3].u, m_heightMap[index3].v);
-					indices[index] = index;
-					index++;
-
-					// Upper right.
-					vertices[index].position = DirectX::SimpleMath::Vector3(m_heightMap[index4].x, m_heightMap[index4].y, m_heightMap[index4].z);
-					vertices[index].normal = DirectX::SimpleMath::Vector3(m_heightMap[index4].nx, m_heightMap[index4].ny, m_heightMap[index4].nz);
-					vertices[index].texture = DirectX::SimpleMath::Vector2(m_heightMap[index4].u, m_heightMap[index4].v);
-					indices[index] = index;
-					index++;
-
-					// Bottom left.
-					vertices[index].position = DirectX::SimpleMath::Vector3(m_heightMap[index1].x, m_heightMap[index1].y, m_heightMap[index1].z);
-					vertices[index].normal = DirectX::SimpleMath::Vector3(m_heightMap[index1].nx, m_heightMap[index1].ny, m_heightMap[index1].nz);
-					vertices[index].texture = DirectX::SimpleMath::Vector2(m_heightMap[index1].u, m_heightMap[index1].v);
-					indices[index] = index;
-					index++;
-
-					// Bottom left.
-					vertices[index].position = DirectX::SimpleMath::Vector3(m_heightMap[index1].x, m_heightMap[index1].y, m_heightMap[index1].z);
-					vertices[index].normal = DirectX::SimpleMath::Vector3(m_heightMap[index1].nx, m_heightMap[index1].ny, m_heightMap[index1].nz);
-					vertices[index].texture = DirectX::SimpleMath::Vector2(m_heightMap[index1].u, m_heightMap[index1].v);
-					indices[index] = index;
-					index++;
-
-					// Upper right.
-					vertices[index].position = DirectX::SimpleMath::Vector3(m_heightMap[index4].x, m_heightMap[index4].y, m_heightMap[index4].z);
-					vertices[index].normal = DirectX::SimpleMath::Vector3(m_heightMap[index4].nx, m_heightMap[index4].ny, m_heightMap[index4].nz);
-					vertices[index].texture = DirectX::SimpleMath::Vector2(m_heightMap[index4].u, m_heightMap[index4].v);
-					indices[index] = index;
-					index++;
-
-					// Bottom right.
-					vertices[index].position = DirectX::SimpleMath::Vector3(m_heightMap[index2].x, m_heightMap[index2].y, m_heightMap[index2].z);
-					vertices[index].normal = DirectX::SimpleMath::Vector3(m_heightMap[index2].nx, m_heightMap[index2].ny, m_heightMap[index2].nz);
-					vertices[index].texture = DirectX::SimpleMath::Vector2(m_heightMap[index2].u, m_heightMap[index2].v);
-					indices[index] = index;
-					index++;
-				}
-				
-			}
-			
-		}
+		return true;
 	}
 
-	// Set up the description of the static vertex buffer.
-	vertexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	vertexBufferDesc.ByteWidth = sizeof(VertexType) * m_vertexCount;
-	vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	vertexBufferDesc.CPUAccessFlags = 0;
-	vertexBufferDesc.MiscFlags = 0;
-	vertexBufferDesc.StructureByteStride = 0;
-
-	// Give the subresource structure a pointer to the vertex data.
-	vertexData.pSysMem = vertices;
-	vertexData.SysMemPitch = 0;
-	vertexData.SysMemSlicePitch = 0;
-
-	// Now create the vertex buffer.
-	result = device->CreateBuffer(&vertexBufferDesc, &vertexData, &m_vertexBuffer);
-	if (FAILED(result))
+	m_dirtyRanges.clear();
+	m_chunks.Update(m_dungeon.GetHeights(), m_dirtyRanges);
+
+	return m_regenerator.UpdateVertices(m_chunks.GetMesh(), m_dirtyRanges, m_buffers);
+}
+
+// Greedy meshing is linear in the map size, so the block mesh is simply rebuilt
+bool Terrain::UpdateBlockBuffers()
+{
+	TerrainMeshData mesh;
+	TerrainBuffers buffers;
+
+	if (!BuildDungeonBlockMesh(m_dungeon.GetHeights(), m_terrainWidth, m_terrainHeight, mesh))
 	{
 		return false;
 	}
 
-	// Set up the description of the static index buffer.
-	indexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	indexBufferDesc.ByteWidth = sizeof(unsigned long) * m_indexCount;
-	indexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	indexBufferDesc.CPUAccessFlags = 0;
-	indexBufferDesc.MiscFlags = 0;
-	indexBufferDesc.StructureByteStride = 0;
-
-	// Give the subresource structure a pointer to the index data.
-	indexData.pSysMem = indices;
-	indexData.SysMemPitch = 0;
-	indexData.SysMemSlicePitch = 0;
-
-	// Create the index buffer.
-	result = device->CreateBuffer(&indexBufferDesc, &indexData, &m_indexBuffer);
-	if (FAILED(result))
+	buffers.vertexBuffer = m_meshDevice->CreateVertexBuffer(mesh.vertices.data(), mesh.vertices.size() * sizeof(TerrainVertex));
+	buffers.indexBuffer = m_meshDevice->CreateIndexBuffer(mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t));
+	buffers.vertexCount = (int)mesh.vertices.size();
+	buffers.indexCount = (int)mesh.indices.size();
+	buffers.vertexStride = sizeof(TerrainVertex);
+
+	if (!buffers.vertexBuffer || !buffers.indexBuffer)
 	{
+		m_regenerator.ReleaseBuffers(buffers);
 		return false;
 	}
 
-	// Release the arrays now that the vertex and index buffers have been created and loaded.
-	delete[] vertices;
-	vertices = 0;
-
-	delete[] indices;
-	indices = 0;
+	m_regenerator.ReleaseBuffers(m_blockBuffers);
+	m_blockBuffers = buffers;
+	m_blocksDirty = false;
 
 	return true;
 }
 
+bool Terrain::DrawsBlocks() const
+{
+	return m_blockWalls && m_blockBuffers.vertexBuffer != nullptr;
+}
+
 void Terrain::RenderBuffers(ID3D11DeviceContext * deviceContext)
 {
 	unsigned int stride;
 	unsigned int offset;
+	ID3D11Buffer* vertexBuffer = static_cast<ID3D11Buffer*>(m_buffers.vertexBuffer);
 
-	// Set vertex buffer stride and offset.
-	stride = sizeof(VertexType);
+	// Set vertex buffer stride and offset, VertexType or QuantizedVertex depending on the format.
+	stride = (unsigned int)m_buffers.vertexStride;
 	offset = 0;
 
 	// Set the vertex buffer to active in the input assembler so it can be rendered.
-	deviceContext->IASetVertexBuffers(0, 1, &m_vertexBuffer, &stride, &offset);
+	deviceContext->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
 
 	// Set the index buffer to active in the input assembler so it can be rendered.
-	deviceContext->IASetIndexBuffer(m_indexBuffer, DXGI_FORMAT_R32_UINT, 0);
+	deviceContext->IASetIndexBuffer(static_cast<ID3D11Buffer*>(m_buffers.indexBuffer), DXGI_FORMAT_R16_UINT, 0);
 
 	// Set the type of primitive that should be rendered from this vertex buffer, in this case triangles.
 	deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
@@ -603,36 +366,40 @@ bool Terrain::GenerateHeightMap(ID3D11Device* device, DirectX::SimpleMath::Vecto
 
 	*/
 
-	result = PCGDungeonMap(playerStart);
-	if (!result)
+	// A running job keeps the mode it started with, Request below refuses anyway
+	if (!m_regenerator.IsBusy())
 	{
-		return false;
+		m_regenerator.SetNormalMode((TerrainNormalMode)m_normalMode);
+		m_regenerator.SetBakeWallField(m_distanceWalls);
 	}
 
-	result = PlaceCollectibles();
-	if (!result)
-	{
-		return false;
-	}
+	// New seed every generation so repeated clicks give different dungeons. A refused
+	// request keeps the old one, so each dungeon depends only on how many were made
+	unsigned int* seed = m_dungeon.GetPCGSeed();
+	unsigned int previousSeed = *seed;
+	*seed = (unsigned int)RandomBits(previousSeed, 0, 0, RANDOM_PASS_RESEED);
 
-	result = CalculateNormals();
+	// Automaton, collectibles, mesh and buffer creation all run on the job
+	result = m_regenerator.Request(m_dungeon, (int)playerStart.x, (int)playerStart.z);
 	if (!result)
 	{
-		return false;
+		*seed = previousSeed;
 	}
 
-	result = InitializeBuffers(device);
-	if (!result)
-	{
-		return false;
-	}
+	return result;
+}
+
+bool Terrain::IsRegenerating() const
+{
+	return m_regenerator.IsBusy();
 }
 
 bool Terrain::RandomHeightMap()
 {
-	bool result;
 	int index;
 	float height = 0.0;
+	float* heights = m_dungeon.GetHeights();
+	unsigned int seed = *m_dungeon.GetPCGSeed();
 
 	for (int j = 0; j < m_terrainHeight; j++)
 	{
@@ -640,26 +407,26 @@ bool Terrain::RandomHeightMap()
 		{
 			index = (m_terrainHeight * j) + i;
 
-			height = (float) (rand() % 200);
+			height = (float)RandomRange(seed, i, j, RANDOM_PASS_HEIGHTS, 200);
 			height = (height - 100.f) / 100.f;
 			height *= m_amplitude;
 			height *= m_perlNoise.noise((float)i / m_terrainWidth, (float)j / m_terrainHeight, 0);
 			//height *= m_perlNoise.noise(0.5, 0.1, 0.8);
 
-			m_heightMap[index].x = (float)i;
-			m_heightMap[index].y = height;
-			m_heightMap[index].z = (float)j;
+			heights[index] = height;
 		}
 	}
 
+	m_dungeon.MarkAllDirty();
+	SyncHeightMap();
 	return true;
 }
 
 bool Terrain::NoiseHeightMap()
 {
-	bool result;
 	int index;
 	float height = 100.0;
+	float* heights = m_dungeon.GetHeights();
 
 	for (int j = 0; j < m_terrainHeight; j++)
 	{
@@ -667,345 +434,140 @@ bool Terrain::NoiseHeightMap()
 		{
 			index = (m_terrainHeight * j) + i;
 
-
-			m_heightMap[index].x = (float)i;
-			m_heightMap[index].y = m_perlNoise.noise((float)i / m_terrainWidth , 0, (float)j / m_terrainHeight) * height;
-			m_heightMap[index].z = (float)j;
+			heights[index] = m_perlNoise.noise((float)i / m_terrainWidth , 0, (float)j / m_terrainHeight) * height;
 		}
 	}
 
+	m_dungeon.MarkAllDirty();
+	SyncHeightMap();
 	return true;
 }
 
 // Function to take Dungeon Map and imprint it onto the terrain
 bool Terrain::GenerateDungeonHeightMap()
 {
-	int index;
-	float height = 100.0;
-
-	for (int j = 0; j < m_terrainHeight; j++)
-	{
-		for (int i = 0; i < m_terrainWidth; i++)
-		{
-			index = (m_terrainHeight * j) + i;
+	bool result = m_dungeon.GenerateDungeonHeightMap();
 
-
-			m_heightMap[index].x = (float)i;
-
-			if (i == 0 || j == 0)
-			{
-				m_heightMap[index].y = height;
-			}
-			else if (i == m_terrainWidth-1 || j == m_terrainHeight-1)
-			{
-				m_heightMap[index].y = height;
-			}
-			else
-			{
-				m_heightMap[index].y = -1.0;
-			}
-
-			//m_heightMap[index].y = m_perlNoise.noise((float)i / m_terrainWidth, 0, (float)j / m_terrainHeight) * height;
-			m_heightMap[index].z = (float)j;
-		}
-	}
-
-	return true;
+	SyncHeightMap();
+	return result;
 }
 
 
 // Using Cellular Automata, Construct a cave map by expanding traversable zones from a seed
 bool Terrain::PCGDungeonMap(DirectX::SimpleMath::Vector3 playerStart)
 {
-	int index;
-	int valid_neighbors;
+	bool result = m_dungeon.PCGDungeonMap((int)playerStart.x, (int)playerStart.z);
 
-	// Seeding Map
-	for (int j = 0; j < m_terrainHeight; j++)
-	{
-		for (int i = 0; i < m_terrainWidth; i++)
-		{
-			index = (m_terrainHeight * j) + i;
-
-
-			m_heightMap[index].x = (float)i;
-			m_heightMap[index].z = (float)j;
+	SyncHeightMap();
+	return result;
+}
 
-			
+// Flag the mesh tiles, walls and blocks over the heights changed since the last sync
+void Terrain::SyncHeightMap()
+{
+	DungeonRect rect;
+	const float* heights = m_dungeon.GetHeights();
 
-			// Walls enforced on edge of map
-			if (i == 0 || j == 0)
-			{
-				m_heightMap[index].y = WALL_HEIGHT;
-			}
-			else if (i == m_terrainWidth - 1 || j == m_terrainHeight - 1)
-			{
-				m_heightMap[index].y = WALL_HEIGHT;
-			}
-			else
-			{
-				float random = (float)rand() / RAND_MAX;
-				if (random <= m_seedChance)
-				{
-					m_heightMap[index].y = FLOOR_HEIGHT;
-				}
-				else
-				{
-					m_heightMap[index].y = WALL_HEIGHT;
-				}
-			}
-		}
+	if (!m_dungeon.TakeDirtyRect(rect))
+	{
+		return;
 	}
 
-	// Always Seed Camera Location as an empty area
-	int temp = ((int)playerStart.z * m_terrainHeight + (int)playerStart.x);
-	m_heightMap[temp].y = FLOOR_HEIGHT;
+	m_chunks.MarkDirty(rect.x0, rect.z0, rect.x1, rect.z1);
+	m_walls.Update(heights, rect);
+	m_blocksDirty = true;
+	m_wallFieldDirty = true;
+}
 
-	// Cellular Automata
-	for (int iter = 0; iter < m_iterations; iter++)
+bool Terrain::PlaceCollectibles()
+{
+	if (!m_dungeon.PlaceCollectibles(m_placedCollectibles))
 	{
-		for (int j = 1; j < m_terrainHeight-1; j++)
-		{
-			for (int i = 1; i < m_terrainWidth-1; i++)
-			{
-				index = (m_terrainHeight * j) + i;
-
-
-				m_heightMap[index].x = (float)i;
-				m_heightMap[index].z = (float)j;
-
-				valid_neighbors = 0;
-
-				if (j > 1)
-				{
-					// Top Left
-					if (i > 1)
-					{
-						if (m_heightMap[(m_terrainHeight * (j - 1)) + (i - 1)].y < 0)
-							valid_neighbors++;
-					}
-
-					//Top Right
-					if (i < (m_terrainWidth - 2))
-					{
-						if (m_heightMap[(m_terrainHeight * (j - 1)) + (i + 1)].y < 0)
-							valid_neighbors++;
-					}
-
-					//Top Middle
-					if (m_heightMap[(m_terrainHeight * (j - 1)) + (i)].y < 0)
-						valid_neighbors++;
-
-				}
-
-				if (j < (m_terrainHeight - 2))
-				{
-					// Bottom Left
-					if (i > 1)
-					{
-						if (m_heightMap[(m_terrainHeight * (j + 1)) + (i - 1)].y < 0)
-							valid_neighbors++;
-					}
-
-					// Bottom Right
-					if (i < (m_terrainWidth - 2))
-					{
-						if (m_heightMap[(m_terrainHeight * (j + 1)) + (i + 1)].y < 0)
-							valid_neighbors++;
-					}
-
-					// Bottom Middle
-					if (m_heightMap[(m_terrainHeight * (j + 1)) + (i)].y < 0)
-						valid_neighbors++;
-
-				}
-
-				// Inline Left
-				if (i > 1)
-				{
-					if (m_heightMap[(m_terrainHeight * (j)) + (i - 1)].y < 0)
-						valid_neighbors++;
-				}
-
-				// Inline Right
-				if (i < (m_terrainWidth - 2))
-				{
-					if (m_heightMap[(m_terrainHeight * (j)) + (i + 1)].y < 0)
-						valid_neighbors++;
-				}
-
-
-				// If threshold of neighbors reached
-				if(valid_neighbors >= m_threshold)
-					m_heightMap[index].y = FLOOR_HEIGHT;
-			}
-		}
+		return false;
 	}
 
+	SyncCollectibles();
 	return true;
 }
 
-bool Terrain::PlaceCollectibles()
+void Terrain::SyncCollectibles()
 {
-	int placed = 0;
+	m_collectibles.Assign(m_placedCollectibles);
+}
 
-	while (placed < COLLECTIBLE_COUNT)
-	{
-		int index = rand() % (m_terrainHeight * m_terrainWidth);
+DirectX::SimpleMath::Vector3 Terrain::GetCollectible(int index) const
+{
+	const DungeonPoint& point = m_collectibles.GetPoint(index);
+	return DirectX::SimpleMath::Vector3(point.x, point.y, point.z);
+}
 
-		if (m_heightMap[index].y == FLOOR_HEIGHT)
-		{
-			m_collectibles[placed] = DirectX::SimpleMath::Vector3(m_heightMap[index].x, m_heightMap[index].y, m_heightMap[index].z);
-			placed++;
-		}
-	}
+int Terrain::GetPlacedCollectibles() const
+{
+	return m_collectibles.GetCount();
+}
 
-	return true;
+int* Terrain::GetCollectibleCount()
+{
+	return m_dungeon.GetCollectibleCount();
 }
 
-DirectX::SimpleMath::Vector3* Terrain::getCollectibles()
+float* Terrain::GetCollectibleSpacing()
 {
-	return m_collectibles;
+	return m_dungeon.GetCollectibleSpacing();
 }
 
 // Check collision of collectible with player cam
 bool Terrain::CollideWithCollectible(DirectX::SimpleMath::Vector3 other)
 {
-	for (int i = 0; i < COLLECTIBLE_COUNT; i++)
+	// Provide a small leeway to allow impercise movement
+	int found = m_collectibles.FindNear(other.x, other.z, COLLECTIBLE_LEEWAY);
+	if (found < 0)
 	{
-		// Provide a small leeway to allow impercise movement
-		if (other.x <= m_collectibles[i].x + COLLECTIBLE_LEEWAY && other.x >= m_collectibles[i].x - COLLECTIBLE_LEEWAY)
-		{
-			if (other.z <= m_collectibles[i].z + COLLECTIBLE_LEEWAY && other.z >= m_collectibles[i].z - COLLECTIBLE_LEEWAY)
-			{
-				m_collectibles[i].x = m_terrainWidth + 10;
-				return true;
-			}
-			
-		}
+		return false;
 	}
-	return false;
+
+	m_collectibles.Remove(found);
+	return true;
 }
 
-// Check if location collides with the wall
+// Swept, so a fast move cannot skip over a wall, and blocked moves keep their motion along it
 DirectX::SimpleMath::Vector3 Terrain::CollideWithWall(DirectX::SimpleMath::Vector3 other, DirectX::SimpleMath::Vector3 lastPos)
 {
-	int index = ((int)other.z * m_terrainHeight + (int)other.x);
+	float x = lastPos.x;
+	float z = lastPos.z;
 
-	if (other.x < 0 || other.z < 0)
-		return lastPos;
+	m_walls.Slide(x, z, PLAYER_RADIUS, other.x - lastPos.x, other.z - lastPos.z);
 
-	if (other.x > m_terrainWidth || other.z > m_terrainHeight)
-		return lastPos;
+	return DirectX::SimpleMath::Vector3(x, other.y, z);
+}
 
-	if (m_heightMap[index].y == WALL_HEIGHT)
-		return lastPos;
+const WallGrid& Terrain::GetWalls() const
+{
+	return m_walls;
+}
 
-	return CollideWithNeighborhood(other, lastPos);
+bool* Terrain::GetDistanceFieldWalls()
+{
+	return &m_distanceWalls;
 }
 
-DirectX::SimpleMath::Vector3 Terrain::CollideWithNeighborhood(DirectX::SimpleMath::Vector3 other, DirectX::SimpleMath::Vector3 lastPos)
+const WallDistanceField& Terrain::GetWallField() const
 {
-	int index = (((int)other.z + 1) * m_terrainHeight + (int)other.x);
-	if (m_heightMap[index].y == WALL_HEIGHT)
-		return lastPos;
-	
-	index = (((int)other.z - 1) * m_terrainHeight + (int)other.x);
-	if (m_heightMap[index].y == WALL_HEIGHT)
-		return lastPos;
-	
-	index = ((int)other.z  * m_terrainHeight + ((int)other.x + 1));
-	if (m_heightMap[index].y == WALL_HEIGHT)
-		return lastPos;
-	
-	index = ((int)other.z * m_terrainHeight + ((int)other.x - 1));
-	if (m_heightMap[index].y == WALL_HEIGHT)
-		return lastPos;
+	return m_wallField;
+}
 
-	return other;
+PhysicsLevel Terrain::GetPhysicsLevel() const
+{
+	PhysicsLevel level = { &m_walls, &m_wallField };
+	return level;
 }
 
 bool Terrain::SmoothHeight()
 {
-	bool result;
-	int index;
-	float heightSum;
-	int averageCount;
+	bool result = m_dungeon.SmoothHeight();
 
-	for (int j = 0; j < m_terrainHeight; j++)
-	{
-		for (int i = 0; i < m_terrainWidth; i++)
-		{
-			heightSum = 0.f;
-			averageCount = 0;
-			index = (m_terrainHeight * j) + i;
-
-			if (j > 0)
-			{
-				// Top Left
-				if (i > 0)
-				{
-					averageCount++;
-					heightSum += m_heightMap[(m_terrainHeight * (j - 1)) + (i - 1)].y;
-				}
-
-				//Top Right
-				if(i < (m_terrainWidth - 1))
-				{
-					averageCount++;
-					heightSum += m_heightMap[(m_terrainHeight * (j - 1)) + (i + 1)].y;
-				}
-				
-				//Top Middle
-				averageCount++;
-				heightSum += m_heightMap[(m_terrainHeight * (j - 1)) + (i)].y;
-
-			}
-
-			if (j < (m_terrainHeight - 1))
-			{
-				// Bottom Left
-				if (i > 0)
-				{
-					averageCount++;
-					heightSum += m_heightMap[(m_terrainHeight * (j + 1)) + (i - 1)].y;
-				}
-
-				// Bottom Right
-				if (i < (m_terrainWidth - 1))
-				{
-					averageCount++;
-					heightSum += m_heightMap[(m_terrainHeight * (j + 1)) + (i + 1)].y;
-				}
-
-				// Bottom Middle
-				averageCount++;
-				heightSum += m_heightMap[(m_terrainHeight * (j + 1)) + (i)].y;
-
-			}
-
-			// Inline Left
-			if (i > 0)
-			{
-				averageCount++;
-				heightSum += m_heightMap[(m_terrainHeight * (j)) + (i - 1)].y;
-			}
-
-			// Inline Right
-			if (i < (m_terrainWidth - 1))
-			{
-				averageCount++;
-				heightSum += m_heightMap[(m_terrainHeight * (j)) + (i + 1)].y;
-			}
-
-			// Ours
-			averageCount++;
-			heightSum += m_heightMap[index].y;
-			
-			m_heightMap[index].y = heightSum / averageCount;
-		}
-	}
-	return true;
+	SyncHeightMap();
+	return result;
 }
 
 bool Terrain::RandomParticleDeposition()
@@ -1016,114 +578,97 @@ bool Terrain::RandomParticleDeposition()
 
 bool Terrain::ParticleDepositionAtPoint(int index)
 {
-	int landingSite = index;
-	int i, j;
+	bool result = m_dungeon.ParticleDepositionAtPoint(index, m_amplitude * 0.5f);
 
-	int nextSite = landingSite;
-
-	float tempHeight;
-	float particleHeight = m_amplitude * 0.5;
+	SyncHeightMap();
+	return result;
+}
 
-	bool onFlatSurface = false;
+// Called once per frame before rendering, picks up a finished regeneration
+bool Terrain::Update()
+{
+	IndexedTerrainMesh mesh;
 
-	while (!onFlatSurface)
+	if (m_regenerator.Swap(m_dungeon, m_placedCollectibles, m_buffers, mesh, &m_wallField))
 	{
-		onFlatSurface = true;
-		i = nextSite % m_terrainHeight;
-		j = (nextSite) / m_terrainHeight;
-		tempHeight = m_heightMap[nextSite].y + particleHeight;
+		SyncHeightMap();
+		SyncCollectibles();
 
-		if (j > 0)
+		// A field baked by the job matches the new heights, one still baking for the old ones is not wanted
+		if (m_wallField.IsBuilt())
 		{
-			// Top Left
-			if (i > 0)
-			{
-				if (m_heightMap[(m_terrainHeight * (j - 1)) + (i - 1)].y < m_heightMap[nextSite].y)
-				{
-					onFlatSurface = false;
-					nextSite = (m_terrainHeight * (j - 1)) + (i - 1);
-				}
-			}
-
-			//Top Right
-			if (i < (m_terrainWidth - 1))
-			{
-				if (m_heightMap[(m_terrainHeight * (j - 1)) + (i + 1)].y < m_heightMap[nextSite].y)
-				{
-					onFlatSurface = false;
-					nextSite = (m_terrainHeight * (j - 1)) + (i + 1);
-				}
-			}
-
-			//Top Middle
-			if (m_heightMap[(m_terrainHeight * (j - 1)) + (i)].y < m_heightMap[nextSite].y)
-			{
-				onFlatSurface = false;
-				nextSite = (m_terrainHeight * (j - 1)) + (i);
-			}
-
+			m_fieldBaker.Discard();
+			m_wallFieldDirty = false;
 		}
 
-		if (j < (m_terrainHeight - 1))
-		{
-			// Bottom Left
-			if (i > 0)
-			{
-				if (m_heightMap[(m_terrainHeight * (j + 1)) + (i - 1)].y < m_heightMap[nextSite].y)
-				{
-					onFlatSurface = false;
-					nextSite = (m_terrainHeight * (j + 1)) + (i - 1);
-				}
-			}
-
-			// Bottom Right
-			if (i < (m_terrainWidth - 1))
-			{
-				if (m_heightMap[(m_terrainHeight * (j + 1)) + (i + 1)].y < m_heightMap[nextSite].y)
-				{
-					onFlatSurface = false;
-					nextSite = (m_terrainHeight * (j + 1)) + (i + 1);
-				}
-			}
-
-			// Bottom Middle
-			if (m_heightMap[(m_terrainHeight * (j + 1)) + (i)].y < m_heightMap[nextSite].y)
-			{
-				onFlatSurface = false;
-				nextSite = (m_terrainHeight * (j + 1)) + (i);
-			}
+		// The job built the mesh for exactly these heights, nothing to patch
+		m_chunks.SetNormalMode(m_regenerator.GetNormalMode());
+		m_chunks.Adopt(mesh, m_terrainWidth, m_terrainHeight);
+		m_lod.Reset(m_chunks.GetMesh(), m_terrainWidth, m_terrainHeight);
+		m_drawItems.clear();
+	}
 
-		}
+	UpdateBuffers();
 
-		// Inline Left
-		if (i > 0)
-		{
-			if (m_heightMap[(m_terrainHeight * (j)) + (i - 1)].y < m_heightMap[nextSite].y)
-			{
-				onFlatSurface = false;
-				nextSite = (m_terrainHeight * (j)) + (i - 1);
-			}
-		}
-		  
+	if (m_blockWalls && m_blocksDirty)
+	{
+		UpdateBlockBuffers();
+	}
 
-		// Inline Right
-		if (i < (m_terrainWidth - 1))
+	// The transform is global, so any edit rebakes the whole field, on the baker's thread.
+	// Until it is done the old field stays in use, or the wall grid if there is none yet
+	if (m_distanceWalls)
+	{
+		m_fieldBaker.Swap(m_wallField);
+
+		if ((m_wallFieldDirty || !m_wallField.IsBuilt()) && !m_fieldBaker.IsBusy())
 		{
-			if (m_heightMap[(m_terrainHeight * (j)) + (i + 1)].y < m_heightMap[nextSite].y)
-			{
-				onFlatSurface = false;
-				nextSite = (m_terrainHeight * (j)) + (i + 1);
-			}
+			m_wallFieldDirty = !m_fieldBaker.Request(m_dungeon.GetHeights(), m_terrainWidth, m_terrainHeight);
 		}
 	}
+	else if (m_wallField.IsBuilt() || m_fieldBaker.IsBusy())
+	{
+		m_fieldBaker.Discard();
+		m_wallField.Clear();
+		m_wallFieldDirty = true;
+	}
 
-	m_heightMap[nextSite].y += particleHeight;
-	return true;
+	return true; 
 }
 
-bool Terrain::Update()
+int Terrain::SelectLod(DirectX::SimpleMath::Vector3 position)
 {
-	return true; 
+	if (DrawsBlocks())
+	{
+		m_drawnTriangles = m_blockBuffers.indexCount / 3;
+		return m_drawnTriangles;
+	}
+
+	if (!m_lodEnabled)
+	{
+		m_drawnTriangles = m_buffers.indexCount / 3;
+		return m_drawnTriangles;
+	}
+
+	float camera[3] = { position.x, position.y, position.z };
+	m_drawnTriangles = m_lod.Select(camera, m_drawItems);
+
+	return m_drawnTriangles;
+}
+
+bool* Terrain::GetLodEnabled()
+{
+	return &m_lodEnabled;
+}
+
+int Terrain::GetDrawnTriangles() const
+{
+	return m_drawnTriangles;
+}
+
+bool* Terrain::GetBlockWalls()
+{
+	return &m_blockWalls;
 }
 
 float* Terrain::GetWavelength()
@@ -1138,16 +683,59 @@ float* Terrain::GetAmplitude()
 
 int* Terrain::GetPCGIterations()
 {
-	return &m_iterations;
+	return m_dungeon.GetPCGIterations();
 }
 
 int* Terrain::GetPCGThreshold()
 {
-	return &m_threshold;
+	return m_dungeon.GetPCGThreshold();
 }
 
 float* Terrain::GetPCGSeedChance()
 {
-	return &m_seedChance;
+	return m_dungeon.GetPCGSeedChance();
+}
+
+int* Terrain::GetPCGMode()
+{
+	return m_dungeon.GetPCGMode();
+}
+
+int* Terrain::GetNormalMode()
+{
+	return &m_normalMode;
+}
+
+bool* Terrain::GetConnectRegions()
+{
+	return m_dungeon.GetConnectRegions();
+}
+
+int Terrain::GetRegionCount() const
+{
+	return m_dungeon.GetRegions().GetRegionCount();
+}
+
+int Terrain::GetCarvedCells() const
+{
+	return m_dungeon.GetCarvedCells();
+}
+
+void Terrain::SetVertexFormat(TerrainVertexFormat format)
+{
+	m_regenerator.SetVertexFormat(format);
+}
+
+bool Terrain::IsQuantized() const
+{
+	// Block buffers are always float
+	return !DrawsBlocks() && m_buffers.vertexStride == sizeof(QuantizedVertex);
+}
+
+void Terrain::GetPositionDequantization(float* origin, float* scale) const
+{
+	VertexQuantization quantization;
+	MakeTerrainQuantization(quantization);
+	GetUnormDequantization(quantization, origin, scale);
 }
 
@@ -1,8 +1,15 @@
 #pragma once
-#define WALL_HEIGHT 100.0f
-#define FLOOR_HEIGHT -1.0f
-#define COLLECTIBLE_COUNT 10
+#include "DungeonCore/CollectibleGrid.h"
+#include "DungeonCore/DungeonMap.h"
+#include "DungeonCore/DungeonMesher.h"
+#include "DungeonCore/PhysicsWorld.h"
+#include "DungeonCore/TerrainLod.h"
+#include "DungeonCore/TerrainRegenerator.h"
+#include "DungeonCore/WallDistanceField.h"
+#include "DungeonCore/WallGrid.h"
+
 #define COLLECTIBLE_LEEWAY 2.0f
+#define PLAYER_RADIUS 0.5f
 
 using namespace DirectX;
 
@@ -15,19 +22,22 @@ private:
 		DirectX::SimpleMath::Vector2 texture;
 		DirectX::SimpleMath::Vector3 normal;
 	};
-	struct HeightMapType
-	{
-		float x, y, z;
-		float nx, ny, nz;
-		float u, v;
-	};
 public:
 	Terrain();
 	~Terrain();
 
 	bool Initialize(ID3D11Device*, int terrainWidth, int terrainHeight);
+
+	// Vertex layout of the terrain buffers, set before Initialize. Quantized terrain
+	// is drawn with a Shader from InitQuantized fed GetPositionDequantization
+	void SetVertexFormat(TerrainVertexFormat format);
+	bool IsQuantized() const;
+	void GetPositionDequantization(float* origin, float* scale) const;
 	void Render(ID3D11DeviceContext*);
+
+	// Queues a new dungeon on the background job, Update swaps it in once it is ready
 	bool GenerateHeightMap(ID3D11Device*, DirectX::SimpleMath::Vector3);
+	bool IsRegenerating() const;
 	bool RandomHeightMap();
 	bool NoiseHeightMap();
 	bool SmoothHeight();
@@ -35,50 +45,114 @@ public:
 	bool ParticleDepositionAtPoint(int index);
 	bool Update();
 
+	// Picks this frame's chunk levels for a camera at (position), Render draws them
+	int SelectLod(DirectX::SimpleMath::Vector3 position);
+	bool* GetLodEnabled();
+	int GetDrawnTriangles() const;
+
+	// Draws the greedy block mesh (flat floors, vertical walls) instead of the heightfield
+	bool* GetBlockWalls();
+
 	float* GetWavelength();
 	float* GetAmplitude();
 
 	int* GetPCGIterations();
 	int* GetPCGThreshold();
 	float* GetPCGSeedChance();
+	int* GetPCGMode();
+	int* GetNormalMode();
+	bool* GetConnectRegions();
+
+	// Floor regions and corridor cells of the current dungeon
+	int GetRegionCount() const;
+	int GetCarvedCells() const;
 
 	bool GenerateDungeonHeightMap();
 	bool PCGDungeonMap(DirectX::SimpleMath::Vector3);
 
 
 	bool PlaceCollectibles();
-	DirectX::SimpleMath::Vector3* getCollectibles();
+	DirectX::SimpleMath::Vector3 GetCollectible(int index) const;
+
+	// Collectibles left in the current level, can start below the requested count on a small or crowded map
+	int GetPlacedCollectibles() const;
+
+	// Count and minimum spacing (in cells) for the next placement
+	int* GetCollectibleCount();
+	float* GetCollectibleSpacing();
 
 
 	bool CollideWithCollectible(DirectX::SimpleMath::Vector3);
+
+	// Moves the player from lastPos toward the new position, sliding along any wall in between
 	DirectX::SimpleMath::Vector3 CollideWithWall(DirectX::SimpleMath::Vector3, DirectX::SimpleMath::Vector3);
-	DirectX::SimpleMath::Vector3 CollideWithNeighborhood(DirectX::SimpleMath::Vector3, DirectX::SimpleMath::Vector3);
+
+	// Wall occupancy for swept queries, follows every height edit
+	const WallGrid& GetWalls() const;
+
+	// Distance field of the walls, baked while enabled whenever the heights change and empty otherwise
+	bool* GetDistanceFieldWalls();
+	const WallDistanceField& GetWallField() const;
+
+	// Both of the above for Physics, valid for the life of this Terrain
+	PhysicsLevel GetPhysicsLevel() const;
 
 private:
-	bool CalculateNormals();
+	// The collision, mesh and job state below describe one dungeon, a copy would desync from it
+	Terrain(const Terrain&);
+	Terrain& operator=(const Terrain&);
+
+	void SyncHeightMap();
+	void SyncCollectibles();
 	void Shutdown();
 	void ShutdownBuffers();
 	bool InitializeBuffers(ID3D11Device*);
+	bool UpdateBuffers();
 	void RenderBuffers(ID3D11DeviceContext*);
+	bool UpdateBlockBuffers();
+	bool DrawsBlocks() const;
 	
 
 private:
 	bool m_terrainGeneratedToggle;
 	int m_terrainWidth, m_terrainHeight;
-	ID3D11Buffer * m_vertexBuffer, *m_indexBuffer;
-	int m_vertexCount, m_indexCount;
+	TerrainBuffers m_buffers;
 	float m_frequency, m_amplitude, m_wavelength;
-	HeightMapType* m_heightMap;
+	WallGrid m_walls;
+	WallDistanceField m_wallField;
+	WallFieldBaker m_fieldBaker;	// Rebakes after edits, the old field serves meanwhile
+	bool m_distanceWalls;
+	bool m_wallFieldDirty;
 	ClassicNoise m_perlNoise;
 
-	//Collectibles
-	DirectX::SimpleMath::Vector3* m_collectibles;
+	//Collectibles, bucketed by cell so a pickup check only looks near the player
+	CollectibleGrid m_collectibles;
+	std::vector<DungeonPoint> m_placedCollectibles;
+
+	// Headless generation core, owns the heights and PCG parameters
+	DungeonMap m_dungeon;
+
+	// Background regeneration. The device is replaced on Initialize and outlives the regenerator's buffers
+	std::unique_ptr<MeshBufferDevice> m_meshDevice;
+	TerrainRegenerator m_regenerator;
+
+	// CPU copy of the mesh, edits re-upload only the dirty tiles
+	TerrainChunkCache m_chunks;
+	std::vector<TerrainVertexRange> m_dirtyRanges;
+
+	// Geomipmapped draw list, rebuilt every frame from the camera position
+	TerrainLod m_lod;
+	std::vector<TerrainDrawItem> m_drawItems;
+	bool m_lodEnabled;
+	int m_drawnTriangles;
+
+	// Block mesh of the current heights, rebuilt while enabled whenever the heights change
+	TerrainBuffers m_blockBuffers;
+	bool m_blockWalls;
+	bool m_blocksDirty;
 
-	// PCG Dungeon Parameters
-	int m_iterations;
-	int m_threshold;
-	int m_neightborhood;
-	float m_seedChance;
+	// TerrainNormalMode for the next generation, central differences unless the GUI picks face averaged
+	int m_normalMode;
 
 
 	//arrays for our generated objects Made by directX
@@ -0,0 +1,74 @@
+// Light vertex shader for QuantizedVertex input
+// Decodes the 16-bit position and octahedral normal, then matches light_vs
+
+cbuffer MatrixBuffer : register(b0)
+{
+    matrix worldMatrix;
+    matrix viewMatrix;
+    matrix projectionMatrix;
+};
+
+// position = positionOrigin + unorm position * positionScale
+cbuffer QuantizationBuffer : register(b1)
+{
+    float4 positionOrigin;
+    float4 positionScale;
+};
+
+struct InputType
+{
+    float4 position : POSITION;
+    float2 tex : TEXCOORD0;
+    float2 normal : NORMAL;
+};
+
+struct OutputType
+{
+    float4 position : SV_POSITION;
+    float2 tex : TEXCOORD0;
+    float3 normal : NORMAL;
+	float3 position3D : TEXCOORD2;
+};
+
+// Same unfold as DecodeOctahedral in NormalEncoding.h
+float3 DecodeOctahedral(float2 encoded)
+{
+    float3 normal = float3(encoded.x, 1.0f - abs(encoded.x) - abs(encoded.y), encoded.y);
+
+    if (normal.y < 0.0f)
+    {
+        float2 folded = (1.0f - abs(encoded.yx)) * (encoded >= 0.0f ? 1.0f : -1.0f);
+        normal.x = folded.x;
+        normal.z = folded.y;
+    }
+
+    return normalize(normal);
+}
+
+OutputType main(InputType input)
+{
+    OutputType output;
+    float4 position;
+
+    position.xyz = positionOrigin.xyz + (input.position.xyz * positionScale.xyz);
+    position.w = 1.0f;
+
+    // Calculate the position of the vertex against the world, view, and projection matrices.
+    output.position = mul(position, worldMatrix);
+    output.position = mul(output.position, viewMatrix);
+    output.position = mul(output.position, projectionMatrix);
+    
+    // Store the texture coordinates for the pixel shader.
+    output.tex = input.tex;
+
+	 // Calculate the normal vector against the world matrix only.
+    output.normal = mul(DecodeOctahedral(input.normal), (float3x3)worldMatrix);
+	
+    // Normalize the normal vector.
+    output.normal = normalize(output.normal);
+
+	// world position of vertex (for point light)
+	output.position3D = (float3)mul(position, worldMatrix);
+
+    return output;
+}